@@ -218,6 +218,8 @@ LacewingFunction          void  lw_sha1_hex                 (char * output, cons
   LacewingFunction           long  lw_filter_get_local_port     (lw_filter *);
   LacewingFunction           void  lw_filter_set_reuse          (lw_filter *);
   LacewingFunction        lw_bool  lw_filter_is_reuse_set       (lw_filter *);
+  LacewingFunction           void  lw_filter_set_reuse_port     (lw_filter *, lw_bool);
+  LacewingFunction        lw_bool  lw_filter_is_reuse_port_set  (lw_filter *);
 
 /* Error */
 
@@ -281,6 +283,7 @@ LacewingFunction          void  lw_sha1_hex                 (char * output, cons
   LacewingFunction          lw_bool  lw_server_cert_loaded              (lw_server *);
   LacewingFunction           lw_i64  lw_server_bytes_sent               (lw_server *);
   LacewingFunction           lw_i64  lw_server_bytes_received           (lw_server *);
+  LacewingFunction           lw_i64  lw_server_sends_queued             (lw_server *);
   LacewingFunction             void  lw_server_disable_nagling          (lw_server *);
   LacewingFunction          lw_addr* lw_server_client_address           (lw_server_client *);
   LacewingFunction             void  lw_server_client_send              (lw_server_client *, const char * data, long size);
@@ -749,6 +752,12 @@ struct Filter
 
     LacewingFunction void Reuse(bool Enabled);
     LacewingFunction bool Reuse() const;
+
+    /* Allows several sockets to listen on the same port, with the kernel
+       spreading incoming connections between them (SO_REUSEPORT) */
+
+    LacewingFunction void ReusePort(bool Enabled);
+    LacewingFunction bool ReusePort() const;
 };
 
 struct Client
@@ -808,6 +817,11 @@ struct Server
 
     LacewingFunction lw_i64 BytesSent();
     LacewingFunction lw_i64 BytesReceived();
+
+    /* Sends that couldn't be written straight away and were queued.  Safe to
+       call from any thread. */
+
+    LacewingFunction lw_i64 SendsQueued();
     
     LacewingFunction void DisableNagling ();
 
@@ -821,6 +835,11 @@ struct Server
         LacewingFunction void SendFile      (const char * Filename, lw_i64 Offset = 0, lw_i64 Size = -1);
         LacewingFunction void SendWritable  (char * Data, int Size = -1);
 
+        /* Sends Count buffers with a single write where possible, only copying
+           whatever can't be sent immediately */
+
+        LacewingFunction void Send (const char ** Buffers, const int * Sizes, int Count);
+
         LacewingFunction bool CheapBuffering ();
         LacewingFunction void StartBuffering ();
         LacewingFunction void Flush ();
@@ -867,6 +886,11 @@ struct UDP
 
     LacewingFunction void Send(Lacewing::Address &Address, const char * Data, int Size = -1);
 
+    /* Sends the same datagram to Count addresses, batching the sends where the
+       platform allows it (sendmmsg) */
+
+    LacewingFunction void Send(Lacewing::Address ** Addresses, int Count, const char * Data, int Size = -1);
+
     typedef void (LacewingHandler * HandlerReceive)          (Lacewing::UDP &UDP, Lacewing::Address &From, char * Data, int Size);
     typedef void (LacewingHandler * HandlerError)            (Lacewing::UDP &UDP, Lacewing::Error &);
     
@@ -1233,6 +1257,55 @@ struct RelayServer
     LacewingFunction void SetWelcomeMessage(const char * Message);
     LacewingFunction void SetChannelListing(bool Enabled);
 
+    /* Spreads the client connections over Count threads, each with its own
+       listening socket on the same port (SO_REUSEPORT).  The handlers are still
+       called on the pump the server was created with.  Must be called before
+       Host(), and Socket is unused afterwards.  No effect on Windows.
+
+       Only the socket I/O and framing move to the shards.  Every channel,
+       peer and routing decision still runs on that one pump, so the relay
+       thread is the ceiling however many shards there are, and more shards
+       than spare cores only add context switches. */
+
+    LacewingFunction void SetShardCount(int Count);
+
+    /* Counters since the server was created, cheap enough to leave on.
+       MessagesIn is by message type (0 Request, 1-3 Binary, 4-6 Object,
+       7 UDPHello, 8 ChannelMaster, 9 Ping) and MessageSizes[N] counts the
+       incoming messages of up to (16 << N) bytes, the last one counting the
+       rest.  TCPSendsQueued counts the sends that found the socket busy and
+       had to be queued, which points at slow readers.  InboxMessages,
+       ShardWrites and Wakeups (pump wakeups to drain a shard mailbox, on the
+       relay thread and the shards) are only used in sharded mode. */
+
+    struct Metrics
+    {
+        int Clients, Channels, Shards;
+
+        lw_i64 Connects, Disconnects;
+
+        lw_i64 MessagesIn [10];
+        lw_i64 BlastedIn;
+        lw_i64 MessageSizes [16];
+        lw_i64 MessageBytesIn;
+
+        lw_i64 TCPBytesIn, TCPFramesOut, TCPBytesOut, TCPSendsQueued;
+        lw_i64 UDPDatagramsIn, UDPBytesIn, UDPDatagramsOut, UDPBytesOut;
+
+        lw_i64 InboxMessages, ShardWrites, Wakeups;
+    };
+
+    LacewingFunction void GetMetrics (Metrics &);
+
+    /* Responds to a request with the metrics in the Prometheus text format,
+       along with the client count of each channel */
+
+    LacewingFunction void WriteMetrics (Lacewing::Webserver::Request &Request);
+
+    /* Calls onMetrics with a snapshot every Milliseconds (0 to stop) */
+
+    LacewingFunction void MetricsInterval (int Milliseconds);
+
     struct Client;
 
     struct Channel
@@ -1327,6 +1400,9 @@ struct RelayServer
     typedef bool (LacewingHandler * HandlerSetName)
         (Lacewing::RelayServer &Server, Lacewing::RelayServer::Client &Client, const char * Name);
 
+    typedef void (LacewingHandler * HandlerMetrics)
+        (Lacewing::RelayServer &Server, Lacewing::RelayServer::Metrics &Metrics);
+
     LacewingFunction void onConnect        (HandlerConnect);
     LacewingFunction void onDisconnect     (HandlerDisconnect);
     LacewingFunction void onError          (HandlerError);
@@ -1336,6 +1412,7 @@ struct RelayServer
     LacewingFunction void onJoinChannel    (HandlerJoinChannel);
     LacewingFunction void onLeaveChannel   (HandlerLeaveChannel);
     LacewingFunction void onSetName        (HandlerSetName);
+    LacewingFunction void onMetrics        (HandlerMetrics);
 };
 
 struct FlashPolicy
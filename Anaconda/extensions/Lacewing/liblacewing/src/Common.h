@@ -424,13 +424,13 @@ inline void LacewingSyncIncrement(volatile long * Target)
     #endif
 }
 
-inline void LacewingSyncDecrement(volatile long * Target)
+inline long LacewingSyncDecrement(volatile long * Target)
 {
     #ifdef __GNUC__
-        __sync_sub_and_fetch(Target, 1);
+        return __sync_sub_and_fetch(Target, 1);
     #else
         #ifdef LacewingWindows
-            InterlockedDecrement(Target);
+            return InterlockedDecrement(Target);
         #else
             #error "Don't know how to implement LacewingSyncDecrement on this platform"
         #endif
@@ -471,6 +471,44 @@ inline void LacewingSyncExchange(volatile long * Target, long NewValue)
     #endif
 }
 
+/* For counters that only one thread writes to but any thread may read.  The
+   write isn't a locked operation, but neither the read nor the write can tear
+   on a 32-bit target. */
+
+inline void LacewingCounterAdd(volatile lw_i64 * Target, lw_i64 Value)
+{
+    #ifdef __GNUC__
+        __atomic_store_n(Target, __atomic_load_n(Target, __ATOMIC_RELAXED) + Value, __ATOMIC_RELAXED);
+    #else
+        #ifdef LacewingWindows
+            #ifdef _WIN64
+                *Target += Value;
+            #else
+                InterlockedExchangeAdd64(Target, Value);
+            #endif
+        #else
+            #error "Don't know how to implement LacewingCounterAdd on this platform"
+        #endif
+    #endif
+}
+
+inline lw_i64 LacewingCounterRead(volatile lw_i64 * Target)
+{
+    #ifdef __GNUC__
+        return __atomic_load_n(Target, __ATOMIC_RELAXED);
+    #else
+        #ifdef LacewingWindows
+            #ifdef _WIN64
+                return *Target;
+            #else
+                return InterlockedCompareExchange64(Target, 0, 0);
+            #endif
+        #else
+            #error "Don't know how to implement LacewingCounterRead on this platform"
+        #endif
+    #endif
+}
+
 inline int Read24Bit (const char * b)
 {
     return 65536 * b[0] + 256 * b[1] + b[2];
@@ -37,6 +37,7 @@ struct FilterInternal
         LocalPort = 0;
 
         Reuse = false;
+        ReusePort = false;
     }
 
     int LocalIP;
@@ -45,6 +46,7 @@ struct FilterInternal
     Lacewing::Address RemoteAddress;
     
     bool Reuse;
+    bool ReusePort;
 };
 
 Lacewing::Filter::Filter()
@@ -61,6 +63,8 @@ Lacewing::Filter::Filter(const Filter &_Filter)
     Remote        (_Filter.Remote());
     LocalIP       (_Filter.LocalIP());
     LocalPort     (_Filter.LocalPort());
+    Reuse         (_Filter.Reuse());
+    ReusePort     (_Filter.ReusePort());
 }
 
 Lacewing::Filter::~Filter()
@@ -112,6 +116,16 @@ bool Lacewing::Filter::Reuse() const
     return ((FilterInternal *) InternalTag)->Reuse;
 }
 
+void Lacewing::Filter::ReusePort(bool Enabled)
+{
+    ((FilterInternal *) InternalTag)->ReusePort = Enabled;
+}
+
+bool Lacewing::Filter::ReusePort() const
+{
+    return ((FilterInternal *) InternalTag)->ReusePort;
+}
+
 void Lacewing::Filter::Local (const char * Name)
 {
     Lacewing::Address Address(Name, 0, true);
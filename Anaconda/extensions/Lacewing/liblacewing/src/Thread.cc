@@ -117,8 +117,12 @@ void Lacewing::Thread::Start (void * Parameter)
         Internal.Thread = (HANDLE) _beginthreadex(0, 0,
                 (unsigned (__stdcall *) (void *)) ThreadWrapper, &Internal, 0, 0);
     #else
-        Internal.Started = pthread_create
-            (&Internal.Thread, 0, (void * (*) (void *)) ThreadWrapper, &Internal);
+        /* Set before creating the thread, which clears it again when it exits */
+
+        Internal.Started = true;
+
+        if (pthread_create (&Internal.Thread, 0, (void * (*) (void *)) ThreadWrapper, &Internal))
+            Internal.Started = false;
     #endif
 }
 
@@ -59,6 +59,12 @@ void lw_filter_set_reuse (lw_filter * filter, lw_bool reuse)
 lw_bool lw_filter_is_reuse_set (lw_filter * filter)
     { return ((Lacewing::Filter *) filter)->Reuse();
     }
+void lw_filter_set_reuse_port (lw_filter * filter, lw_bool reuse)
+    { ((Lacewing::Filter *) filter)->ReusePort(reuse != 0);
+    }
+lw_bool lw_filter_is_reuse_port_set (lw_filter * filter)
+    { return ((Lacewing::Filter *) filter)->ReusePort();
+    }
 void lw_filter_set_local (lw_filter * filter, const char * name)
     { ((Lacewing::Filter *) filter)->Local(name);
     }
@@ -71,6 +71,9 @@ lw_i64 lw_server_bytes_sent (lw_server * server)
 lw_i64 lw_server_bytes_received (lw_server * server)
     { return ((Lacewing::Server *) server)->BytesReceived();
     }
+lw_i64 lw_server_sends_queued (lw_server * server)
+    { return ((Lacewing::Server *) server)->SendsQueued();
+    }
 void lw_server_disable_nagling (lw_server * server)
     { ((Lacewing::Server *) server)->DisableNagling();
     }
@@ -30,6 +30,40 @@
 #ifndef LacewingFrameBuilder
 #define LacewingFrameBuilder
 
+/* An immutable, reference counted copy of a framed message, shared between
+   all of the clients it's being sent to */
+
+struct SharedFrame
+{
+    volatile long Refs;
+
+    int Size;
+    char Data [1];
+
+    static inline SharedFrame * New (const char * Data, int Size)
+    {
+        SharedFrame * Frame = (SharedFrame *) malloc (sizeof (SharedFrame) + Size);
+
+        Frame->Refs = 1;
+        Frame->Size = Size;
+
+        memcpy (Frame->Data, Data, Size);
+
+        return Frame;
+    }
+
+    inline void Ref ()
+    {
+        LacewingSyncIncrement (&Refs);
+    }
+
+    inline void Release ()
+    {
+        if (LacewingSyncDecrement (&Refs) == 0)
+            free (this);
+    }
+};
+
 class FrameBuilder : public MessageBuilder
 {
 protected:
@@ -79,12 +113,22 @@ protected:
     char * ToSend;
     int ToSendSize;
 
+    SharedFrame * Shared;
+
 public:
 
     FrameBuilder(bool IsUDPClient)
     {
         this->IsUDPClient = IsUDPClient;
+
         ToSend = 0;
+        Shared = 0;
+    }
+
+    ~FrameBuilder()
+    {
+        if (Shared)
+            Shared->Release ();
     }
 
     inline void AddHeader(unsigned char Type, unsigned char Variant, bool ForUDP = false, int UDPClientID = -1)
@@ -131,10 +175,47 @@ public:
             FrameReset();
     }
 
+    inline void Send(Lacewing::UDP &UDP, Lacewing::Address ** Addresses, int Count, bool Clear = true)
+    {
+        UDP.Send (Addresses, Count, Buffer, Size);
+ 
+        if(Clear)
+            FrameReset();
+    }
+
+    /* The size of the message once framed for TCP */
+
+    inline int FrameSize()
+    {
+        PrepareForTransmission ();
+        return ToSendSize;
+    }
+
+    /* The framed message as a SharedFrame, made on first use and released by
+       FrameReset, so sending the same frame to many clients copies it once.
+       Recipients take their own reference with Ref(). */
+
+    inline SharedFrame * Share()
+    {
+        if (!Shared)
+        {
+            PrepareForTransmission ();
+            Shared = SharedFrame::New (ToSend, ToSendSize);
+        }
+
+        return Shared;
+    }
+
     inline void FrameReset()
     {
         Reset();
         ToSend = 0;
+
+        if (Shared)
+        {
+            Shared->Release ();
+            Shared = 0;
+        }
     }
 
 };
@@ -0,0 +1,121 @@
+/* vim: set et ts=4 sw=4 ft=cpp:
+ *
+ * Copyright (C) 2011 James McLaughlin.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef LacewingRelayMetrics
+#define LacewingRelayMetrics
+
+/* Counters for RelayServer::GetMetrics.
+
+   Every thread that does work for the relay has its own RelayCounters (the
+   relay pump has one, and so does each shard) and is the only thread that
+   ever writes to it.  The relay thread adds the blocks together for a
+   snapshot, so each value goes through LacewingCounterAdd/Read: no locked
+   instructions, but no torn reads either.  Values from a shard may be a
+   moment behind. */
+
+#define LacewingRelayMessageTypes  10
+#define LacewingRelaySizeBuckets   16
+
+struct RelayCounter
+{
+    volatile lw_i64 Value;
+
+    inline void operator ++ ()
+    {
+        LacewingCounterAdd (&Value, 1);
+    }
+
+    inline void operator += (lw_i64 Amount)
+    {
+        LacewingCounterAdd (&Value, Amount);
+    }
+
+    inline lw_i64 Get ()
+    {
+        return LacewingCounterRead (&Value);
+    }
+};
+
+struct RelayCounters
+{
+    RelayCounter Connects, Disconnects;
+
+    RelayCounter MessagesIn [LacewingRelayMessageTypes];
+    RelayCounter BlastedIn;
+
+    /* Message sizes, where bucket N counts messages of up to (16 << N) bytes
+       and the last bucket counts everything bigger */
+
+    RelayCounter MessageSizes [LacewingRelaySizeBuckets];
+    RelayCounter MessageBytesIn;
+
+    RelayCounter TCPBytesIn, TCPFramesOut, TCPBytesOut;
+    RelayCounter UDPDatagramsIn, UDPBytesIn, UDPDatagramsOut, UDPBytesOut;
+
+    /* Sharded mode only: mailbox messages handled by the relay thread, and
+       the gathered writes made by the shards.  Wakeups counts the times a
+       pump woke up to drain a mailbox, on the relay and on the shards. */
+
+    RelayCounter InboxMessages;
+    RelayCounter ShardWrites;
+    RelayCounter Wakeups;
+
+    RelayCounters ()
+    {
+        memset ((void *) this, 0, sizeof (*this));
+    }
+
+    inline void CountMessage (unsigned char TypeID, int Size, bool Blasted)
+    {
+        if (TypeID < LacewingRelayMessageTypes)
+            ++ MessagesIn [TypeID];
+
+        if (Blasted)
+            ++ BlastedIn;
+
+        int Bucket = 0;
+
+        while (Bucket < LacewingRelaySizeBuckets - 1 && Size > (16 << Bucket))
+            ++ Bucket;
+
+        ++ MessageSizes [Bucket];
+
+        MessageBytesIn += Size;
+    }
+
+    /* Only called on the thread that owns Total */
+
+    inline void AddTo (RelayCounters &Total)
+    {
+        RelayCounter * From = (RelayCounter *) this, * To = (RelayCounter *) &Total;
+
+        for (size_t i = 0; i < sizeof (*this) / sizeof (RelayCounter); ++ i)
+            To [i] += From [i].Get ();
+    }
+};
+
+#endif
@@ -31,6 +31,8 @@
 
 #include "FrameReader.h"
 #include "FrameBuilder.h"
+#include "RelayMetrics.h"
+#include "RelayShard.h"
 #include "IDPool.h"
 
 #include "../webserver/Common.h"
@@ -39,11 +41,14 @@ struct RelayServerInternal;
 
 void ServerMessageHandler (void * Tag, unsigned char Type, char * Message, int Size);
 void ServerTimerTick      (Lacewing::Timer &Timer);
+void MetricsTimerTick     (Lacewing::Timer &Timer);
 
 struct RelayServerInternal
 {
     Lacewing::RelayServer &Server;
+    Lacewing::Pump &Pump;
     Lacewing::Timer Timer;
+    Lacewing::Timer MetricsTimer;
 
     Lacewing::RelayServer::HandlerConnect           HandlerConnect;
     Lacewing::RelayServer::HandlerDisconnect        HandlerDisconnect;
@@ -54,9 +59,10 @@ struct RelayServerInternal
     Lacewing::RelayServer::HandlerJoinChannel       HandlerJoinChannel;
     Lacewing::RelayServer::HandlerLeaveChannel      HandlerLeaveChannel;
     Lacewing::RelayServer::HandlerSetName           HandlerSetName;
+    Lacewing::RelayServer::HandlerMetrics           HandlerMetrics;
 
-    RelayServerInternal(Lacewing::RelayServer &_Server, Lacewing::Pump &Pump)
-            : Server(_Server), Builder(false), Timer(Pump)
+    RelayServerInternal(Lacewing::RelayServer &_Server, Lacewing::Pump &_Pump)
+            : Server(_Server), Pump(_Pump), Builder(false), Timer(_Pump), MetricsTimer(_Pump)
     {
         HandlerConnect          = 0;
         HandlerDisconnect       = 0;
@@ -67,13 +73,59 @@ struct RelayServerInternal
         HandlerJoinChannel      = 0;
         HandlerLeaveChannel     = 0;
         HandlerSetName          = 0;
+        HandlerMetrics          = 0;
 
         WelcomeMessage = Lacewing::Version();
     
         Timer.Tag = this;
         Timer.onTick (ServerTimerTick);
 
+        MetricsTimer.Tag = this;
+        MetricsTimer.onTick (MetricsTimerTick);
+
         ChannelListingEnabled = true;
+
+        ClientTable     = 0;
+        ClientTableSize = 0;
+
+        #ifdef LacewingRelayShards
+
+            Inbox         = 0;
+            Shards        = 0;
+            ShardCount    = 0;
+            ShardsRunning = false;
+            ShardsHosting = false;
+            ShardsPort    = 0;
+
+        #endif
+    }
+
+    ~RelayServerInternal()
+    {
+        free (ClientTable);
+
+        #ifdef LacewingRelayShards
+
+            if (!Shards)
+                return;
+
+            for (int i = 0; i < ShardCount; ++ i)
+            {
+                if (ShardsRunning)
+                {
+                    Shards [i]->Pump.PostEventLoopExit ();
+                    Shards [i]->Thread.Join ();
+                }
+
+                delete Shards [i];
+            }
+
+            delete [] Shards;
+
+            Inbox->Remove (Pump);
+            delete Inbox;
+
+        #endif
     }
 
     IDPool ClientIDs;
@@ -85,12 +137,20 @@ struct RelayServerInternal
     {
         Lacewing::RelayServer::Client Public;
 
-        Lacewing::Server::Client &Socket;
         RelayServerInternal &Server;
+
+        /* Either the socket on the relay's own pump, or the client's
+           connection on a shard (see RelayShard.h) */
+
+        Lacewing::Server::Client * Socket;
+
+        #ifdef LacewingRelayShards
+            ShardClient * Remote;
+        #endif
+
+        List <Client *>::Element * Element;
         
-        Client(Lacewing::Server::Client &_Socket)
-                : Server(*(RelayServerInternal *) Socket.Tag), Socket(_Socket),
-                    UDPAddress(Socket.GetAddress())
+        Client(RelayServerInternal &_Server) : Server(_Server)
         {
             Public.InternalTag    = this;
             Public.Tag            = 0;
@@ -100,6 +160,14 @@ struct RelayServerInternal
 
             ID = Server.ClientIDs.Borrow();
 
+            Socket = 0;
+
+            #ifdef LacewingRelayShards
+                Remote = 0;
+            #endif
+
+            UDPAddress = 0;
+
             Handshook      = false;
             Ponged         = true;
             GotFirstByte   = false;
@@ -108,12 +176,27 @@ struct RelayServerInternal
         ~Client()
         {
             Server.ClientIDs.Return(ID);  
+
+            delete UDPAddress;
         }
 
         FrameReader Reader;
         
         void MessageHandler (unsigned char Type, char * Message, int Size, bool Blasted);
 
+        void Send (FrameBuilder &Builder, bool Clear = true);
+        void Disconnect ();
+
+        Lacewing::Address &GetAddress ()
+        {
+            #ifdef LacewingRelayShards
+                if (Remote)
+                    return Remote->Address;
+            #endif
+
+            return Socket->GetAddress ();
+        }
+
         List <Channel *> Channels;
 
         String Name;
@@ -129,7 +212,7 @@ struct RelayServerInternal
         bool GotFirstByte;
         bool Ponged;
 
-        Lacewing::Address UDPAddress;
+        Lacewing::Address * UDPAddress;
 
     };
 
@@ -168,9 +251,11 @@ struct RelayServerInternal
         
         void RemoveClient(Client &);
         void Close();
+
+        void Blast(FrameBuilder &Builder, Client * Except = 0);
     };
     
-    Backlog<Lacewing::Server::Client, Client>
+    Backlog<RelayServerInternal, Client>
         ClientBacklog;
 
     Backlog<RelayServerInternal, Channel>
@@ -180,20 +265,99 @@ struct RelayServerInternal
 
     String WelcomeMessage;
 
+    List <Client *> Clients;
     List <Channel *> Channels;
 
+    /* Clients indexed by ID, for finding the sender of a UDP datagram.  IDs
+       come from ClientIDs, which always hands out the lowest free one, so the
+       table stays about as big as the peak client count. */
+
+    Client ** ClientTable;
+    int ClientTableSize;
+
     bool ChannelListingEnabled;
 
+    /* Counters for everything done on the relay thread (see RelayMetrics.h) */
+
+    RelayCounters Counters;
+
+    void GetMetrics (Lacewing::RelayServer::Metrics &);
+
+    inline void CountBlast (FrameBuilder &Builder, int Count)
+    {
+        Counters.UDPDatagramsOut += Count;
+        Counters.UDPBytesOut += ((lw_i64) Builder.Size) * Count;
+    }
+
+    #ifdef LacewingRelayShards
+
+        ShardMailbox * Inbox;
+
+        RelayShard ** Shards;
+        int ShardCount;
+
+        bool ShardsRunning, ShardsHosting;
+        int ShardsPort;
+
+        void InboxMessage (ShardMessage &Message);
+
+    #endif
+
+    Client &AddClient (Lacewing::Server::Client * Socket)
+    {
+        Client &Client = ClientBacklog.Borrow (*this);
+
+        Client.Socket  = Socket;
+        Client.Element = Clients.Push (&Client);
+
+        if (Client.ID >= ClientTableSize)
+        {
+            int Size = ClientTableSize ? ClientTableSize * 2 : 64;
+
+            while (Size <= Client.ID)
+                Size *= 2;
+
+            ClientTable = (RelayServerInternal::Client **) realloc
+                (ClientTable, Size * sizeof (RelayServerInternal::Client *));
+
+            memset (ClientTable + ClientTableSize, 0,
+                (Size - ClientTableSize) * sizeof (RelayServerInternal::Client *));
+
+            ClientTableSize = Size;
+        }
+
+        ClientTable [Client.ID] = &Client;
+
+        ++ Counters.Connects;
+
+        return Client;
+    }
+
+    void Disconnected (Client &Client)
+    {
+        for(List <RelayServerInternal::Channel *>::Element * E = Client.Channels.First; E; E = E->Next)
+            (** E)->RemoveClient (Client);
+        
+        if(Client.Handshook && HandlerDisconnect)
+            HandlerDisconnect(Server, Client.Public);
+
+        ClientTable [Client.ID] = 0;
+
+        ++ Counters.Disconnects;
+
+        Clients.Erase (Client.Element);
+        ClientBacklog.Return(Client);
+    }
+
     void TimerTick()
     {
-        Lacewing::Server &Socket = Server.Socket;
         List <RelayServerInternal::Client *> ToDisconnect;
 
         Builder.AddHeader(11, 0); /* Ping */
         
-        for (Lacewing::Server::Client * ClientSocket = Socket.FirstClient (); ClientSocket; ClientSocket = ClientSocket->Next ())
+        for (List <RelayServerInternal::Client *>::Element * E = Clients.First; E; E = E->Next)
         {
-            RelayServerInternal::Client &Client = *(RelayServerInternal::Client *) ClientSocket->Tag;
+            RelayServerInternal::Client &Client = *** E;
             
             if (!Client.Ponged)
             {
@@ -202,13 +366,13 @@ struct RelayServerInternal
             }
 
             Client.Ponged = false;
-            Builder.Send (Client.Socket, false);
+            Client.Send (Builder, false);
         }
 
         Builder.FrameReset();
 
         for(List <RelayServerInternal::Client *>::Element * E = ToDisconnect.First; E; E = E->Next)
-            (** E)->Socket.Disconnect();
+            (** E)->Disconnect();
     }
 };
 
@@ -220,6 +384,117 @@ void ServerTimerTick (Lacewing::Timer &Timer)
 {   ((RelayServerInternal *) Timer.Tag)->TimerTick();
 }
 
+void MetricsTimerTick (Lacewing::Timer &Timer)
+{
+    RelayServerInternal &Internal = *(RelayServerInternal *) Timer.Tag;
+
+    if (!Internal.HandlerMetrics)
+        return;
+
+    Lacewing::RelayServer::Metrics Metrics;
+    Internal.GetMetrics (Metrics);
+
+    Internal.HandlerMetrics (Internal.Server, Metrics);
+}
+
+void RelayServerInternal::Client::Send (FrameBuilder &Builder, bool Clear)
+{
+    ++ Server.Counters.TCPFramesOut;
+    Server.Counters.TCPBytesOut += Builder.FrameSize ();
+
+    #ifdef LacewingRelayShards
+
+        if (Remote)
+        {
+            ShardMessage * Message = ShardMessage::New (ShardMessage::Send, Remote);
+
+            Message->Frame = Builder.Share ();
+            Message->Frame->Ref ();
+
+            Remote->Shard.Outbox.Push (Message);
+
+            if (Clear)
+                Builder.FrameReset ();
+
+            return;
+        }
+
+    #endif
+
+    Builder.Send (*Socket, Clear);
+}
+
+void RelayServerInternal::Client::Disconnect ()
+{
+    #ifdef LacewingRelayShards
+
+        if (Remote)
+        {
+            Remote->Shard.Outbox.Push (ShardMessage::New (ShardMessage::Close, Remote));
+            return;
+        }
+
+    #endif
+
+    Socket->Disconnect ();
+}
+
+#ifdef LacewingRelayShards
+
+void InboxHandler (void * Tag, ShardMessage &Message)
+{   ((RelayServerInternal *) Tag)->InboxMessage (Message);
+}
+
+void RelayServerInternal::InboxMessage (ShardMessage &Message)
+{
+    ShardClient * Remote = Message.Client;
+
+    ++ Counters.InboxMessages;
+
+    switch (Message.Type)
+    {
+        case ShardMessage::Connect:
+        {
+            RelayServerInternal::Client &Client = AddClient (0);
+
+            Client.Remote     = Remote;
+            Client.UDPAddress = new Lacewing::Address (Remote->Address);
+
+            Remote->Tag = &Client;
+            break;
+        }
+
+        case ShardMessage::Receive:
+
+            ((RelayServerInternal::Client *) Remote->Tag)->MessageHandler
+                (Message.MessageType, Message.Data, Message.Size, false);
+
+            break;
+
+        case ShardMessage::Disconnect:
+
+            Disconnected (*(RelayServerInternal::Client *) Remote->Tag);
+
+            Remote->Shard.Outbox.Push (ShardMessage::New (ShardMessage::Release, Remote));
+            break;
+
+        case ShardMessage::Error:
+        {
+            Lacewing::Error Error;
+            Error.Add ("%s", Message.Data);
+
+            if (HandlerError)
+                HandlerError (Server, Error);
+
+            break;
+        }
+    };
+
+    Message.Delete ();
+}
+
+#endif
+
 RelayServerInternal::Channel * RelayServerInternal::Client::ReadChannel(MessageReader &Reader)
 {
     int ChannelID = Reader.Get <unsigned short> ();
@@ -253,29 +528,26 @@ RelayServerInternal::Client * RelayServerInternal::Channel::ReadPeer(MessageRead
 void HandlerConnect(Lacewing::Server &Server, Lacewing::Server::Client &ClientSocket)
 {
     RelayServerInternal &Internal = *(RelayServerInternal *) Server.Tag;
-     
-    ClientSocket.Tag = &Internal;
-    ClientSocket.Tag = &Internal.ClientBacklog.Borrow (ClientSocket);   
+    RelayServerInternal::Client &Client = Internal.AddClient (&ClientSocket);
+
+    Client.UDPAddress = new Lacewing::Address (ClientSocket.GetAddress ());
+
+    ClientSocket.Tag = &Client;
 }
 
 void HandlerDisconnect(Lacewing::Server &Server, Lacewing::Server::Client &ClientSocket)
 {
     RelayServerInternal &Internal = *(RelayServerInternal *) Server.Tag;
-    RelayServerInternal::Client &Client  = *(RelayServerInternal::Client *) ClientSocket.Tag;
 
-    for(List <RelayServerInternal::Channel *>::Element * E = Client.Channels.First; E; E = E->Next)
-        (** E)->RemoveClient (Client);
-    
-    if(Client.Handshook && Internal.HandlerDisconnect)
-        Internal.HandlerDisconnect(Internal.Server, Client.Public);
-
-    Internal.ClientBacklog.Return(Client);
+    Internal.Disconnected (*(RelayServerInternal::Client *) ClientSocket.Tag);
 }
 
 void HandlerReceive(Lacewing::Server &Server, Lacewing::Server::Client &ClientSocket, char * Data, int Size)
 {
     RelayServerInternal &Internal = *(RelayServerInternal *) Server.Tag;
     RelayServerInternal::Client &Client = *(RelayServerInternal::Client *) ClientSocket.Tag;
+
+    Internal.Counters.TCPBytesIn += Size;
     
     if (!Client.GotFirstByte)
     {
@@ -304,6 +576,9 @@ void HandlerUDPReceive(Lacewing::UDP &UDP, Lacewing::Address &Address, char * Da
 {
     RelayServerInternal &Internal = *(RelayServerInternal *) UDP.Tag;
 
+    ++ Internal.Counters.UDPDatagramsIn;
+    Internal.Counters.UDPBytesIn += Size;
+
     if(Size < (sizeof(unsigned short) + 1))
         return;
 
@@ -313,23 +588,16 @@ void HandlerUDPReceive(Lacewing::UDP &UDP, Lacewing::Address &Address, char * Da
     Data += sizeof(unsigned short) + 1;
     Size -= sizeof(unsigned short) + 1;
 
-    Lacewing::Server &Socket = Internal.Server.Socket;
+    if(ID >= Internal.ClientTableSize)
+        return;
 
-    for (Lacewing::Server::Client * ClientSocket = Socket.FirstClient (); ClientSocket; ClientSocket = ClientSocket->Next ())
-    {
-        RelayServerInternal::Client &Client = *(RelayServerInternal::Client *) ClientSocket->Tag;
-        
-        if(Client.ID == ID)
-        {
-            if(Client.Socket.GetAddress().IP() != Address.IP())
-                return;
+    RelayServerInternal::Client * Client = Internal.ClientTable [ID];
 
-            Client.UDPAddress.Port(Address.Port());
-            Client.MessageHandler(Type, Data, Size, true);
+    if((!Client) || Client->GetAddress().IP() != Address.IP())
+        return;
 
-            break;
-        }
-    }
+    Client->UDPAddress->Port(Address.Port());
+    Client->MessageHandler(Type, Data, Size, true);
 }
 
 void HandlerUDPError(Lacewing::UDP &UDP, Lacewing::Error &Error)
@@ -366,6 +634,31 @@ Lacewing::RelayServer::~RelayServer()
     delete ((RelayServerInternal *) InternalTag);
 }
 
+void Lacewing::RelayServer::SetShardCount(int Count)
+{
+    #ifdef LacewingRelayShards
+
+        RelayServerInternal &Internal = *(RelayServerInternal *) InternalTag;
+
+        if (Internal.Shards || Hosting() || Count < 1)
+            return;
+
+        Internal.Inbox = new ShardMailbox;
+
+        Internal.Inbox->Tag     = &Internal;
+        Internal.Inbox->Handler = InboxHandler;
+        Internal.Inbox->Wakeups = &Internal.Counters.Wakeups;
+        Internal.Inbox->Add     (Internal.Pump);
+
+        Internal.Shards     = new RelayShard * [Count];
+        Internal.ShardCount = Count;
+
+        for (int i = 0; i < Count; ++ i)
+            Internal.Shards [i] = new RelayShard (*Internal.Inbox);
+
+    #endif
+}
+
 void Lacewing::RelayServer::Host(int Port)
 {
     Lacewing::Filter Filter;
@@ -381,7 +674,53 @@ void Lacewing::RelayServer::Host(Lacewing::Filter &_Filter)
     if(!Filter.LocalPort())
         Filter.LocalPort(6121);
 
-    Socket.Host (Filter, true);
+    #ifdef LacewingRelayShards
+
+        RelayServerInternal &Internal = *(RelayServerInternal *) InternalTag;
+
+        if (Internal.Shards)
+        {
+            Filter.ReusePort (true);
+
+            if (!Internal.ShardsRunning)
+            {
+                /* The shard threads aren't running yet, so host synchronously
+                   and report any errors before returning */
+
+                for (int i = 0; i < Internal.ShardCount; ++ i)
+                    Internal.Shards [i]->Socket.Host (Filter, true);
+
+                Internal.ShardsHosting = Internal.Shards [0]->Socket.Hosting ();
+
+                for (int i = 0; i < Internal.ShardCount; ++ i)
+                    Internal.Shards [i]->Thread.Start (Internal.Shards [i]);
+
+                Internal.ShardsRunning = true;
+
+                Internal.Inbox->Woken ();
+            }
+            else
+            {
+                int Local [3] = { Filter.LocalIP (), Filter.LocalPort (), Filter.Reuse () ? 1 : 0 };
+
+                for (int i = 0; i < Internal.ShardCount; ++ i)
+                {
+                    Internal.Shards [i]->Outbox.Push (ShardMessage::New
+                        (ShardMessage::Host, 0, (const char *) Local, sizeof (Local)));
+                }
+
+                Internal.ShardsHosting = true;
+            }
+
+            Internal.ShardsPort = Filter.LocalPort ();
+        }
+        else
+            Socket.Host (Filter, true);
+
+    #else
+        Socket.Host (Filter, true);
+    #endif
+
     UDP.Host    (Filter);
 
     ((RelayServerInternal *) InternalTag)->Timer.Start(5000);
@@ -389,6 +728,20 @@ void Lacewing::RelayServer::Host(Lacewing::Filter &_Filter)
 
 void Lacewing::RelayServer::Unhost()
 {
+    #ifdef LacewingRelayShards
+
+        RelayServerInternal &Internal = *(RelayServerInternal *) InternalTag;
+
+        if (Internal.ShardsRunning && Internal.ShardsHosting)
+        {
+            for (int i = 0; i < Internal.ShardCount; ++ i)
+                Internal.Shards [i]->Outbox.Push (ShardMessage::New (ShardMessage::Unhost, 0));
+        }
+
+        Internal.ShardsHosting = false;
+
+    #endif
+
     Socket.Unhost();
     UDP.Unhost();
 
@@ -397,11 +750,21 @@ void Lacewing::RelayServer::Unhost()
 
 bool Lacewing::RelayServer::Hosting()
 {
+    #ifdef LacewingRelayShards
+        if (((RelayServerInternal *) InternalTag)->Shards)
+            return ((RelayServerInternal *) InternalTag)->ShardsHosting;
+    #endif
+
     return Socket.Hosting();
 }
 
 int Lacewing::RelayServer::Port()
 {
+    #ifdef LacewingRelayShards
+        if (((RelayServerInternal *) InternalTag)->Shards)
+            return ((RelayServerInternal *) InternalTag)->ShardsPort;
+    #endif
+
     return Socket.Port();
 }
 
@@ -420,7 +783,7 @@ void RelayServerInternal::Channel::Close()
             E; E = E->Next)
     {
         RelayServerInternal::Client &Client = *** E;
-        Builder.Send(Client.Socket, false);
+        Client.Send (Builder, false);
 
         for(List <RelayServerInternal::Channel *>::Element * E2 = Client.Channels.First;
                 E2; E2 = E2->Next)
@@ -451,6 +814,38 @@ void RelayServerInternal::Channel::Close()
     Server.ChannelBacklog.Return(*this);
 }
 
+void RelayServerInternal::Channel::Blast(FrameBuilder &Builder, RelayServerInternal::Client * Except)
+{
+    /* Send the datagram to every client on the channel, a batch at a time */
+
+    Lacewing::Address * Addresses [64];
+    int Count = 0;
+
+    for(List <RelayServerInternal::Client *>::Element * E = Clients.First;
+            E; E = E->Next)
+    {
+        if(** E == Except)
+            continue;
+
+        Addresses [Count ++] = (** E)->UDPAddress;
+
+        if(Count == sizeof (Addresses) / sizeof (*Addresses))
+        {
+            Server.CountBlast (Builder, Count);
+            Builder.Send(Server.Server.UDP, Addresses, Count, false);
+            Count = 0;
+        }
+    }
+
+    if(Count)
+    {
+        Server.CountBlast (Builder, Count);
+        Builder.Send(Server.Server.UDP, Addresses, Count, false);
+    }
+
+    Builder.FrameReset();
+}
+
 void RelayServerInternal::Channel::RemoveClient(RelayServerInternal::Client &Client)
 {
     for(List <RelayServerInternal::Client *>::Element * E = Clients.First;
@@ -485,7 +880,7 @@ void RelayServerInternal::Channel::RemoveClient(RelayServerInternal::Client &Cli
     for(List <RelayServerInternal::Client *>::Element * E = Clients.First;
             E; E = E->Next)
     {
-        Builder.Send((** E)->Socket, false);
+        (** E)->Send (Builder, false);
     }
 
     Builder.FrameReset();
@@ -517,7 +912,7 @@ bool RelayServerInternal::Client::CheckName (const char * Name)
 
                 Builder.Add ("Name already taken", -1);
 
-                Builder.Send(Socket);
+                Send (Builder);
 
                 return false;
             }
@@ -537,9 +932,11 @@ void RelayServerInternal::Client::MessageHandler(unsigned char Type, char * Mess
     MessageReader Reader (Message, Size);
     FrameBuilder &Builder = Server.Builder;
 
+    Server.Counters.CountMessage (MessageTypeID, Size, Blasted);
+
     if(MessageTypeID != 0 && !Handshook)
     {
-        Socket.Disconnect();
+        Disconnect();
         return;
     }
 
@@ -580,7 +977,7 @@ void RelayServerInternal::Client::MessageHandler(unsigned char Type, char * Mess
                         Builder.Add <unsigned char> (0);  /* Failed */
                         Builder.Add ("Version mismatch", -1);
 
-                        Builder.Send(Socket);
+                        Send (Builder);
 
                         Reader.Failed = true;
                         break;
@@ -593,7 +990,7 @@ void RelayServerInternal::Client::MessageHandler(unsigned char Type, char * Mess
                         Builder.Add <unsigned char> (0);  /* Failed */
                         Builder.Add ("Connection refused by server", -1);
 
-                        Builder.Send(Socket);
+                        Send (Builder);
 
                         Reader.Failed = true;
                         break;
@@ -608,7 +1005,7 @@ void RelayServerInternal::Client::MessageHandler(unsigned char Type, char * Mess
                     Builder.Add <unsigned short> (ID);
                     Builder.Add (Server.WelcomeMessage);
 
-                    Builder.Send(Socket);
+                    Send (Builder);
 
                     break;
                 }
@@ -642,7 +1039,7 @@ void RelayServerInternal::Client::MessageHandler(unsigned char Type, char * Mess
 
                         Builder.Add ("Name refused by server", -1);
 
-                        Builder.Send(Socket);
+                        Send (Builder);
 
                         break;
                     }
@@ -669,7 +1066,7 @@ void RelayServerInternal::Client::MessageHandler(unsigned char Type, char * Mess
                     Builder.Add <unsigned char> (this->Name.Length);
                     Builder.Add (this->Name);
 
-                    Builder.Send(Socket);
+                    Send (Builder);
 
                     for(List <RelayServerInternal::Channel *>::Element * E = Channels.First;
                             E; E = E->Next)
@@ -689,7 +1086,7 @@ void RelayServerInternal::Client::MessageHandler(unsigned char Type, char * Mess
                             if(** E2 == this)
                                 continue;
 
-                            Builder.Send((** E2)->Socket, false);
+                            (** E2)->Send (Builder, false);
                         }
 
                         Builder.FrameReset ();
@@ -750,7 +1147,7 @@ void RelayServerInternal::Client::MessageHandler(unsigned char Type, char * Mess
 
                             Builder.Add ("Name already taken", -1);
 
-                            Builder.Send(Socket);
+                            Send (Builder);
 
                             break;
                         }
@@ -766,7 +1163,7 @@ void RelayServerInternal::Client::MessageHandler(unsigned char Type, char * Mess
 
                             Builder.Add ("Join refused by server", -1);
 
-                            Builder.Send(Socket);
+                            Send (Builder);
                             
                             break;
                         }
@@ -792,7 +1189,7 @@ void RelayServerInternal::Client::MessageHandler(unsigned char Type, char * Mess
                             Builder.Add (Client->Name);
                         }
 
-                        Builder.Send(Socket);
+                        Send (Builder);
 
 
                         Builder.AddHeader (9, 0); /* Peer */
@@ -807,7 +1204,7 @@ void RelayServerInternal::Client::MessageHandler(unsigned char Type, char * Mess
                         for(List <RelayServerInternal::Client *>::Element * E = Channel->Clients.First;
                                 E; E = E->Next)
                         {
-                            Builder.Send((** E)->Socket, false);
+                            (** E)->Send (Builder, false);
                         }
 
                         Builder.FrameReset();
@@ -841,7 +1238,7 @@ void RelayServerInternal::Client::MessageHandler(unsigned char Type, char * Mess
 
                         Builder.Add ("Join refused by server", -1);
 
-                        Builder.Send(Socket);
+                        Send (Builder);
                         
                         Server.ChannelBacklog.Return(*Channel);
                         break;
@@ -862,7 +1259,7 @@ void RelayServerInternal::Client::MessageHandler(unsigned char Type, char * Mess
 
                     Builder.Add <unsigned short> (Channel->ID);
 
-                    Builder.Send(Socket);
+                    Send (Builder);
 
                     break;
                 }
@@ -883,7 +1280,7 @@ void RelayServerInternal::Client::MessageHandler(unsigned char Type, char * Mess
 
                         Builder.Add ("Leave refused by server", -1);
 
-                        Builder.Send(Socket);
+                        Send (Builder);
 
                         break;
                     }
@@ -902,7 +1299,7 @@ void RelayServerInternal::Client::MessageHandler(unsigned char Type, char * Mess
                     Builder.Add <unsigned char>  (1);  /* Success */
                     Builder.Add <unsigned short> (Channel->ID);
 
-                    Builder.Send(Socket);
+                    Send (Builder);
 
                     /* Do this last, because it might delete the channel */
 
@@ -921,7 +1318,7 @@ void RelayServerInternal::Client::MessageHandler(unsigned char Type, char * Mess
                         
                         Builder.Add ("Channel listing is not enabled on this server");
 
-                        Builder.Send (Socket);
+                        Send (Builder);
 
                         break;
                     }
@@ -943,7 +1340,7 @@ void RelayServerInternal::Client::MessageHandler(unsigned char Type, char * Mess
                         Builder.Add (Channel->Name);
                     }
 
-                    Builder.Send(Socket);
+                    Send (Builder);
 
                     break;
 
@@ -1000,15 +1397,18 @@ void RelayServerInternal::Client::MessageHandler(unsigned char Type, char * Mess
             Builder.Add <unsigned short> (ID);
             Builder.Add (Message, Size);
 
+            if(Blasted)
+            {
+                Channel->Blast(Builder, this);
+                break;
+            }
+
             for(List <RelayServerInternal::Client *>::Element * E = Channel->Clients.First; E; E = E->Next)
             {
                 if(** E == this)
                     continue;
 
-                if(Blasted)
-                    Builder.Send(Server.Server.UDP, (** E)->UDPAddress, false);
-                else
-                    Builder.Send((** E)->Socket, false);
+                (** E)->Send (Builder, false);
             }
 
             Builder.FrameReset();
@@ -1050,9 +1450,12 @@ void RelayServerInternal::Client::MessageHandler(unsigned char Type, char * Mess
             Builder.Add (Message, Size);
 
             if(Blasted)
-                Builder.Send(Server.Server.UDP, Peer->UDPAddress);
+            {
+                Server.CountBlast (Builder, 1);
+                Builder.Send(Server.Server.UDP, *Peer->UDPAddress);
+            }
             else
-                Builder.Send(Peer->Socket);
+                Peer->Send (Builder);
 
             break;
         }
@@ -1078,7 +1481,9 @@ void RelayServerInternal::Client::MessageHandler(unsigned char Type, char * Mess
             }
 
             Builder.AddHeader (10, 0); /* UDPWelcome */
-            Builder.Send      (Server.Server.UDP, UDPAddress);
+
+            Server.CountBlast (Builder, 1);
+            Builder.Send      (Server.Server.UDP, *UDPAddress);
 
             break;
             
@@ -1099,7 +1504,7 @@ void RelayServerInternal::Client::MessageHandler(unsigned char Type, char * Mess
 
     if(Reader.Failed)
     {
-        /* Socket.Disconnect(); */
+        /* Disconnect(); */
     }
 }
 
@@ -1113,7 +1518,7 @@ void Lacewing::RelayServer::Client::Send(int Subchannel, const char * Message, i
     Builder.Add <unsigned char> (Subchannel);
     Builder.Add (Message, Size);
 
-    Builder.Send (Internal.Socket);
+    Internal.Send (Builder);
 }
 
 void Lacewing::RelayServer::Client::Blast(int Subchannel, const char * Message, int Size, int Variant)
@@ -1126,7 +1531,8 @@ void Lacewing::RelayServer::Client::Blast(int Subchannel, const char * Message,
     Builder.Add <unsigned char> (Subchannel);
     Builder.Add (Message, Size);
 
-    Builder.Send (Internal.Server.Server.UDP, Internal.UDPAddress);
+    Internal.Server.CountBlast (Builder, 1);
+    Builder.Send (Internal.Server.Server.UDP, *Internal.UDPAddress);
 }
 
 void Lacewing::RelayServer::Channel::Send(int Subchannel, const char * Message, int Size, int Variant)
@@ -1143,7 +1549,7 @@ void Lacewing::RelayServer::Channel::Send(int Subchannel, const char * Message,
     for (List <RelayServerInternal::Client *>::Element *
                 E = Internal.Clients.First; E; E = E->Next)
     {
-        Builder.Send ((** E)->Socket, false);
+        (** E)->Send (Builder, false);
     }
 
     Builder.FrameReset ();
@@ -1160,13 +1566,7 @@ void Lacewing::RelayServer::Channel::Blast(int Subchannel, const char * Message,
     Builder.Add <unsigned short> (Internal.ID);
     Builder.Add (Message, Size);
 
-    for (List <RelayServerInternal::Client *>::Element *
-                E = Internal.Clients.First; E; E = E->Next)
-    {
-        Builder.Send (Internal.Server.Server.UDP, (** E)->UDPAddress, false);
-    }
-
-    Builder.FrameReset ();
+    Internal.Blast (Builder);
 }
 
 int Lacewing::RelayServer::Client::ID()
@@ -1204,6 +1604,201 @@ void Lacewing::RelayServer::SetChannelListing (bool Enabled)
     ((RelayServerInternal *) InternalTag)->ChannelListingEnabled = Enabled;
 }
 
+void RelayServerInternal::GetMetrics (Lacewing::RelayServer::Metrics &Metrics)
+{
+    RelayCounters Total;
+
+    Counters.AddTo (Total);
+
+    Metrics.Shards = 0;
+    Metrics.TCPSendsQueued = Server.Socket.SendsQueued ();
+
+    #ifdef LacewingRelayShards
+
+        for (int i = 0; i < ShardCount; ++ i)
+        {
+            Shards [i]->Counters.AddTo (Total);
+            Metrics.TCPSendsQueued += Shards [i]->Socket.SendsQueued ();
+        }
+
+        Metrics.Shards = ShardCount;
+
+    #endif
+
+    Metrics.Clients  = Clients.Size;
+    Metrics.Channels = Channels.Size;
+
+    Metrics.Connects    = Total.Connects.Get ();
+    Metrics.Disconnects = Total.Disconnects.Get ();
+
+    for (int i = 0; i < LacewingRelayMessageTypes; ++ i)
+        Metrics.MessagesIn [i] = Total.MessagesIn [i].Get ();
+
+    for (int i = 0; i < LacewingRelaySizeBuckets; ++ i)
+        Metrics.MessageSizes [i] = Total.MessageSizes [i].Get ();
+
+    Metrics.BlastedIn      = Total.BlastedIn.Get ();
+    Metrics.MessageBytesIn = Total.MessageBytesIn.Get ();
+
+    Metrics.TCPBytesIn   = Total.TCPBytesIn.Get ();
+    Metrics.TCPFramesOut = Total.TCPFramesOut.Get ();
+    Metrics.TCPBytesOut  = Total.TCPBytesOut.Get ();
+
+    Metrics.UDPDatagramsIn  = Total.UDPDatagramsIn.Get ();
+    Metrics.UDPBytesIn      = Total.UDPBytesIn.Get ();
+    Metrics.UDPDatagramsOut = Total.UDPDatagramsOut.Get ();
+    Metrics.UDPBytesOut     = Total.UDPBytesOut.Get ();
+
+    Metrics.InboxMessages = Total.InboxMessages.Get ();
+    Metrics.ShardWrites   = Total.ShardWrites.Get ();
+    Metrics.Wakeups       = Total.Wakeups.Get ();
+}
+
+void Lacewing::RelayServer::GetMetrics (Lacewing::RelayServer::Metrics &Metrics)
+{
+    ((RelayServerInternal *) InternalTag)->GetMetrics (Metrics);
+}
+
+void Lacewing::RelayServer::MetricsInterval (int Milliseconds)
+{
+    RelayServerInternal &Internal = *(RelayServerInternal *) InternalTag;
+
+    if (Milliseconds > 0)
+        Internal.MetricsTimer.Start (Milliseconds);
+    else
+        Internal.MetricsTimer.Stop ();
+}
+
+static void WriteMetric (Lacewing::Webserver::Request &Request, const char * Name,
+                            const char * Type, const char * Help, lw_i64 Value)
+{
+    Request << "# HELP lacewing_relay_" << Name << " " << Help << "\n"
+            << "# TYPE lacewing_relay_" << Name << " " << Type << "\n"
+            << "lacewing_relay_" << Name << " " << Value << "\n";
+}
+
+static void WriteLabel (Lacewing::Webserver::Request &Request, const char * Value)
+{
+    /* Backslashes, quotes and newlines have to be escaped in label values */
+
+    const char * Start = Value;
+
+    for (; *Value; ++ Value)
+    {
+        const char * Escaped;
+
+        switch (*Value)
+        {
+            case '\\': Escaped = "\\\\"; break;
+            case '"':  Escaped = "\\\""; break;
+            case '\n': Escaped = "\\n";  break;
+
+            default:
+                continue;
+        };
+
+        Request.Send (Start, Value - Start);
+        Request << Escaped;
+
+        Start = Value + 1;
+    }
+
+    Request.Send (Start, Value - Start);
+}
+
+void Lacewing::RelayServer::WriteMetrics (Lacewing::Webserver::Request &Request)
+{
+    RelayServerInternal &Internal = *(RelayServerInternal *) InternalTag;
+
+    Lacewing::RelayServer::Metrics Metrics;
+    Internal.GetMetrics (Metrics);
+
+    Request.Header ("Content-Type", "text/plain; version=0.0.4");
+
+    WriteMetric (Request, "clients", "gauge", "Connected clients", Metrics.Clients);
+    WriteMetric (Request, "channels", "gauge", "Open channels", Metrics.Channels);
+    WriteMetric (Request, "shards", "gauge", "Shard threads (0 if not sharded)", Metrics.Shards);
+
+    WriteMetric (Request, "connects_total", "counter", "Client connections accepted", Metrics.Connects);
+    WriteMetric (Request, "disconnects_total", "counter", "Client disconnections", Metrics.Disconnects);
+
+    {   const char * Types [] =
+        {
+            "request", "binary_server", "binary_channel", "binary_peer", "object_server",
+            "object_channel", "object_peer", "udp_hello", "channel_master", "ping"
+        };
+
+        Request << "# HELP lacewing_relay_messages_in_total Messages received by type\n"
+                << "# TYPE lacewing_relay_messages_in_total counter\n";
+
+        for (int i = 0; i < (int) (sizeof (Types) / sizeof (*Types)); ++ i)
+        {
+            Request << "lacewing_relay_messages_in_total{type=\"" << Types [i] << "\"} "
+                    << Metrics.MessagesIn [i] << "\n";
+        }
+    }
+
+    WriteMetric (Request, "blasted_in_total", "counter", "Messages received over UDP", Metrics.BlastedIn);
+
+    {   Request << "# HELP lacewing_relay_message_size_bytes Size of the messages received\n"
+                << "# TYPE lacewing_relay_message_size_bytes histogram\n";
+
+        lw_i64 Cumulative = 0;
+
+        for (int i = 0; i < (int) (sizeof (Metrics.MessageSizes) / sizeof (*Metrics.MessageSizes)); ++ i)
+        {
+            Cumulative += Metrics.MessageSizes [i];
+
+            Request << "lacewing_relay_message_size_bytes_bucket{le=\"";
+
+            if (i == (sizeof (Metrics.MessageSizes) / sizeof (*Metrics.MessageSizes)) - 1)
+                Request << "+Inf";
+            else
+                Request << (lw_i64) (16 << i);
+
+            Request << "\"} " << Cumulative << "\n";
+        }
+
+        Request << "lacewing_relay_message_size_bytes_sum " << Metrics.MessageBytesIn << "\n"
+                << "lacewing_relay_message_size_bytes_count " << Cumulative << "\n";
+    }
+
+    WriteMetric (Request, "tcp_bytes_in_total", "counter", "Bytes received over TCP", Metrics.TCPBytesIn);
+    WriteMetric (Request, "tcp_frames_out_total", "counter", "Messages sent over TCP", Metrics.TCPFramesOut);
+    WriteMetric (Request, "tcp_bytes_out_total", "counter", "Bytes sent over TCP", Metrics.TCPBytesOut);
+    WriteMetric (Request, "tcp_sends_queued_total", "counter",
+                    "Sends that had to wait for the socket to drain", Metrics.TCPSendsQueued);
+
+    WriteMetric (Request, "udp_datagrams_in_total", "counter", "Datagrams received", Metrics.UDPDatagramsIn);
+    WriteMetric (Request, "udp_bytes_in_total", "counter", "Bytes received over UDP", Metrics.UDPBytesIn);
+    WriteMetric (Request, "udp_datagrams_out_total", "counter", "Datagrams sent", Metrics.UDPDatagramsOut);
+    WriteMetric (Request, "udp_bytes_out_total", "counter", "Bytes sent over UDP", Metrics.UDPBytesOut);
+
+    if (Metrics.Shards)
+    {
+        WriteMetric (Request, "inbox_messages_total", "counter",
+                        "Shard messages handled by the relay thread", Metrics.InboxMessages);
+
+        WriteMetric (Request, "shard_writes_total", "counter",
+                        "Gathered writes made by the shards", Metrics.ShardWrites);
+
+        WriteMetric (Request, "wakeups_total", "counter",
+                        "Pump wakeups to drain a shard mailbox", Metrics.Wakeups);
+    }
+
+    Request << "# HELP lacewing_relay_channel_clients Clients in each channel\n"
+            << "# TYPE lacewing_relay_channel_clients gauge\n";
+
+    for (List <RelayServerInternal::Channel *>::Element * E = Internal.Channels.First; E; E = E->Next)
+    {
+        RelayServerInternal::Channel &Channel = *** E;
+
+        Request << "lacewing_relay_channel_clients{channel=\"";
+        WriteLabel (Request, Channel.Name);
+        Request << "\"} " << (lw_i64) Channel.Clients.Size << "\n";
+    }
+}
+
 Lacewing::RelayServer::Client * Lacewing::RelayServer::Channel::ChannelMaster()
 {
     RelayServerInternal::Client * Client = ((RelayServerInternal::Channel *) InternalTag)->ChannelMaster;
@@ -1218,12 +1813,12 @@ void Lacewing::RelayServer::Channel::Close()
 
 void Lacewing::RelayServer::Client::Disconnect()
 {
-    ((RelayServerInternal::Client *) InternalTag)->Socket.Disconnect();
+    ((RelayServerInternal::Client *) InternalTag)->Disconnect();
 }
 
 Lacewing::Address &Lacewing::RelayServer::Client::GetAddress()
 {
-    return ((RelayServerInternal::Client *) InternalTag)->Socket.GetAddress();
+    return ((RelayServerInternal::Client *) InternalTag)->GetAddress();
 }
 
 const char * Lacewing::RelayServer::Client::Name()
@@ -1256,21 +1851,19 @@ int Lacewing::RelayServer::Client::ChannelCount()
 
 int Lacewing::RelayServer::ClientCount()
 {
-    return Socket.ClientCount ();
+    return ((RelayServerInternal *) InternalTag)->Clients.Size;
 }
 
 Lacewing::RelayServer::Client * Lacewing::RelayServer::FirstClient ()
 {
-    return Socket.FirstClient () ?
-        (Lacewing::RelayServer::Client *) Socket.FirstClient ()->Tag : 0;
+    return ((RelayServerInternal *) InternalTag)->Clients.First ?
+            &(** ((RelayServerInternal *) InternalTag)->Clients.First)->Public : 0;
 }
 
 Lacewing::RelayServer::Client * Lacewing::RelayServer::Client::Next ()
 {
-    Lacewing::Server::Client * NextSocket =
-        ((RelayServerInternal::Client *) InternalTag)->Socket.Next ();
-
-    return NextSocket ? (Lacewing::RelayServer::Client *) NextSocket->Tag : 0;
+    return ((RelayServerInternal::Client *) InternalTag)->Element->Next ?
+        &(** ((RelayServerInternal::Client *) InternalTag)->Element->Next)->Public : 0;
 }
 
 Lacewing::RelayServer::Channel * Lacewing::RelayServer::Channel::Next ()
@@ -1330,4 +1923,5 @@ AutoHandlerFunctions(Lacewing::RelayServer, RelayServerInternal, PeerMessage)
 AutoHandlerFunctions(Lacewing::RelayServer, RelayServerInternal, JoinChannel)
 AutoHandlerFunctions(Lacewing::RelayServer, RelayServerInternal, LeaveChannel)
 AutoHandlerFunctions(Lacewing::RelayServer, RelayServerInternal, SetName)
+AutoHandlerFunctions(Lacewing::RelayServer, RelayServerInternal, Metrics)
 
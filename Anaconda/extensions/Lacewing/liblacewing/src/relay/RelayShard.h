@@ -0,0 +1,577 @@
+/* vim: set et ts=4 sw=4 ft=cpp:
+ *
+ * Copyright (C) 2011 James McLaughlin.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef LacewingRelayShard
+#define LacewingRelayShard
+
+/* Sharded mode for the relay server (see RelayServer::SetShardCount).
+
+   Each shard is an EventPump on its own thread with its own listening socket,
+   all bound to the same port with SO_REUSEPORT so that the kernel spreads the
+   incoming connections between them.  A client stays on the shard that
+   accepted it, which does all of the socket I/O and framing for it.
+
+   The relay logic itself (channels, names, the handlers) still runs on the
+   pump the RelayServer was created with, so the handler API and its threading
+   are unchanged.  The shards and the relay thread talk through mailboxes,
+   which are lock-free MPSC queues woken with a pipe.
+
+   That makes the relay thread a single-thread ceiling: sharding takes the
+   reads, writes and framing off it, but not the routing, and each incoming
+   message is still copied into a mailbox message on the way.  Splitting the
+   channel and peer state between the shards would lift the ceiling, but
+   would also mean calling the handlers from several threads.  The numbers
+   measured with tools/relaybench are in tools/relaybench-results.txt.
+
+   Outgoing messages are SharedFrames, so a message going to a whole channel
+   is framed and copied once.  A shard queues the frames for each client and
+   only writes them once it has emptied its mailbox, with one gathered send
+   per client. */
+
+#ifndef LacewingWindows
+    #define LacewingRelayShards
+#endif
+
+#ifdef LacewingRelayShards
+
+struct RelayShard;
+struct ShardClient;
+
+struct ShardMessage
+{
+    enum
+    {
+        /* Shard -> relay */
+
+        Connect,
+        Receive,
+        Disconnect,
+        Error,
+
+        /* Relay -> shard */
+
+        Send,
+        Close,
+        Release,
+        Host,
+        Unhost
+    };
+
+    ShardMessage * volatile Next;
+
+    int Type;
+    unsigned char MessageType;
+
+    ShardClient * Client;
+    SharedFrame * Frame;
+
+    int Size;
+    char Data [1];
+
+    static inline ShardMessage * New (int Type, ShardClient * Client,
+                    const char * Data = 0, int Size = 0)
+    {
+        ShardMessage * Message = (ShardMessage *) malloc (sizeof (ShardMessage) + Size);
+
+        Message->Type        = Type;
+        Message->MessageType = 0;
+        Message->Client      = Client;
+        Message->Frame       = 0;
+        Message->Size        = Size;
+
+        if (Size > 0)
+            memcpy (Message->Data, Data, Size);
+
+        Message->Data [Size] = 0;
+
+        return Message;
+    }
+
+    inline void Delete ()
+    {
+        free (this);
+    }
+};
+
+struct ShardMailbox
+{
+    /* Vyukov's intrusive MPSC queue.  Any thread may Push, but only the thread
+       running the pump the mailbox was added to may pop. */
+
+    ShardMessage Stub;
+
+    ShardMessage * volatile Head;
+    ShardMessage * Tail;
+
+    int WakeFD_Read, WakeFD_Write;
+    volatile long Waiting;
+
+    void * Tag;
+    void (* Handler) (void * Tag, ShardMessage &Message);
+
+    /* Called once the mailbox has been emptied */
+
+    void (* Drained) (void * Tag);
+
+    /* Counted on every wakeup, if set */
+
+    RelayCounter * Wakeups;
+
+    void * RemoveKey;
+
+    ShardMailbox ()
+    {
+        Stub.Next = 0;
+        Head = Tail = &Stub;
+
+        int WakePipe [2];
+        pipe (WakePipe);
+
+        WakeFD_Read  = WakePipe [0];
+        WakeFD_Write = WakePipe [1];
+
+        fcntl (WakeFD_Read, F_SETFL, fcntl (WakeFD_Read, F_GETFL, 0) | O_NONBLOCK);
+
+        Waiting = 0;
+
+        Tag       = 0;
+        Handler   = 0;
+        Drained   = 0;
+        Wakeups   = 0;
+        RemoveKey = 0;
+    }
+
+    ~ShardMailbox ()
+    {
+        ShardMessage * Message;
+
+        while ((Message = Pop ()))
+        {
+            if (Message->Frame)
+                Message->Frame->Release ();
+
+            Message->Delete ();
+        }
+
+        close (WakeFD_Read);
+        close (WakeFD_Write);
+    }
+
+    static void ReadReady (ShardMailbox &Mailbox)
+    {
+        Mailbox.Woken ();
+    }
+
+    inline void Add (Lacewing::Pump &Pump)
+    {
+        RemoveKey = ((PumpInternal *) Pump.InternalTag)->AddRead
+            (WakeFD_Read, this, (void *) ReadReady);
+    }
+
+    inline void Remove (Lacewing::Pump &Pump)
+    {
+        if (RemoveKey)
+            ((PumpInternal *) Pump.InternalTag)->Remove (RemoveKey);
+
+        RemoveKey = 0;
+    }
+
+    inline void Enqueue (ShardMessage * Message)
+    {
+        Message->Next = 0;
+
+        ShardMessage * Previous;
+
+        for (;;)
+        {
+            Previous = Head;
+
+            if (__sync_bool_compare_and_swap (&Head, Previous, Message))
+                break;
+        }
+
+        Previous->Next = Message;
+    }
+
+    inline void Push (ShardMessage * Message)
+    {
+        Enqueue (Message);
+
+        /* Only the first push since the consumer last woke up writes to the
+           pipe, so a burst of messages costs one wakeup */
+
+        if (LacewingSyncCompareExchange (&Waiting, 1, 0) == 0)
+            write (WakeFD_Write, "", 1);
+    }
+
+    inline ShardMessage * Pop ()
+    {
+        ShardMessage * First = Tail, * Next = First->Next;
+
+        __sync_synchronize ();
+
+        if (First == &Stub)
+        {
+            if (!Next)
+                return 0;
+
+            Tail = First = Next;
+            Next = Next->Next;
+
+            __sync_synchronize ();
+        }
+
+        if (Next)
+        {
+            Tail = Next;
+            return First;
+        }
+
+        if (First != Head)
+        {
+            /* A producer is between swapping the head and linking the
+               message.  It will wake us again once it's done. */
+
+            return 0;
+        }
+
+        Enqueue (&Stub);
+
+        Next = First->Next;
+
+        __sync_synchronize ();
+
+        if (Next)
+        {
+            Tail = Next;
+            return First;
+        }
+
+        return 0;
+    }
+
+    inline void Woken ()
+    {
+        {   char Buffer [64];
+
+            while (read (WakeFD_Read, Buffer, sizeof (Buffer)) > 0)
+                ;
+        }
+
+        LacewingSyncExchange (&Waiting, 0);
+
+        if (Wakeups)
+            ++ *Wakeups;
+
+        ShardMessage * Message;
+
+        while ((Message = Pop ()))
+            Handler (Tag, *Message);
+
+        if (Drained)
+            Drained (Tag);
+    }
+};
+
+struct ShardClient
+{
+    RelayShard &Shard;
+
+    /* Only touched on the shard thread.  Zero once the socket has gone, until
+       the relay thread has released the client. */
+
+    Lacewing::Server::Client * Socket;
+
+    /* Copied on connect, so the relay thread can read it without locking */
+
+    Lacewing::Address Address;
+
+    FrameReader Reader;
+    bool GotFirstByte;
+
+    /* Frames waiting for the end of the mailbox batch, and the client's
+       element in the shard's Dirty list while there are any */
+
+    SharedFrame ** Pending;
+    int PendingCount, PendingAllocated;
+
+    List <ShardClient *>::Element * Dirty;
+
+    /* The relay client, only touched on the relay thread */
+
+    void * Tag;
+
+    ShardClient (RelayShard &_Shard, Lacewing::Server::Client &_Socket)
+        : Shard (_Shard), Socket (&_Socket), Address (_Socket.GetAddress ())
+    {
+        GotFirstByte = false;
+        Tag = 0;
+
+        Pending = 0;
+        PendingCount = PendingAllocated = 0;
+
+        Dirty = 0;
+    }
+
+    ~ShardClient ()
+    {
+        for (int i = 0; i < PendingCount; ++ i)
+            Pending [i]->Release ();
+
+        free (Pending);
+    }
+
+    inline void Queue (SharedFrame * Frame)
+    {
+        if (PendingCount == PendingAllocated)
+        {
+            PendingAllocated = PendingAllocated ? PendingAllocated * 2 : 16;
+
+            Pending = (SharedFrame **) realloc
+                (Pending, PendingAllocated * sizeof (SharedFrame *));
+        }
+
+        Pending [PendingCount ++] = Frame;
+    }
+};
+
+struct RelayShard
+{
+    ShardMailbox &Inbox;
+
+    Lacewing::EventPump Pump;
+    Lacewing::Server Socket;
+    ShardMailbox Outbox;
+
+    Lacewing::Thread Thread;
+
+    List <ShardClient *> Dirty;
+
+    /* Only written on the shard thread (see RelayMetrics.h) */
+
+    RelayCounters Counters;
+
+    RelayShard (ShardMailbox &_Inbox)
+        : Inbox (_Inbox), Socket (Pump), Thread ("RelayShard", (void *) ThreadProc)
+    {
+        Socket.Tag = this;
+
+        Socket.onConnect     (HandlerConnect);
+        Socket.onDisconnect  (HandlerDisconnect);
+        Socket.onReceive     (HandlerReceive);
+        Socket.onError       (HandlerError);
+
+        Socket.DisableNagling ();
+
+        Outbox.Tag     = this;
+        Outbox.Handler = OutboxHandler;
+        Outbox.Drained = FlushAll;
+        Outbox.Wakeups = &Counters.Wakeups;
+        Outbox.Add     (Pump);
+    }
+
+    static int ThreadProc (RelayShard &Shard)
+    {
+        Shard.Pump.StartEventLoop ();
+        return 0;
+    }
+
+    static void HandlerConnect (Lacewing::Server &Server, Lacewing::Server::Client &Socket)
+    {
+        RelayShard &Shard = *(RelayShard *) Server.Tag;
+        ShardClient * Client = new ShardClient (Shard, Socket);
+
+        Client->Reader.Tag            = Client;
+        Client->Reader.MessageHandler = MessageHandler;
+
+        Socket.Tag = Client;
+
+        Shard.Inbox.Push (ShardMessage::New (ShardMessage::Connect, Client));
+    }
+
+    static void HandlerDisconnect (Lacewing::Server &Server, Lacewing::Server::Client &Socket)
+    {
+        RelayShard &Shard = *(RelayShard *) Server.Tag;
+        ShardClient * Client = (ShardClient *) Socket.Tag;
+
+        /* The relay thread may still have messages in flight for this client,
+           so it isn't deleted until the relay sends back a Release */
+
+        Client->Socket = 0;
+
+        Shard.Inbox.Push (ShardMessage::New (ShardMessage::Disconnect, Client));
+    }
+
+    static void HandlerReceive (Lacewing::Server &Server, Lacewing::Server::Client &Socket,
+                                    char * Data, int Size)
+    {
+        ShardClient &Client = *(ShardClient *) Socket.Tag;
+
+        Client.Shard.Counters.TCPBytesIn += Size;
+
+        if (!Client.GotFirstByte)
+        {
+            Client.GotFirstByte = true;
+
+            ++ Data;
+
+            if (!-- Size)
+                return;
+        }
+
+        Client.Reader.Process (Data, Size);
+    }
+
+    static void MessageHandler (void * Tag, unsigned char Type, char * Data, int Size)
+    {
+        ShardClient * Client = (ShardClient *) Tag;
+
+        ShardMessage * Message = ShardMessage::New (ShardMessage::Receive, Client, Data, Size);
+        Message->MessageType = Type;
+
+        Client->Shard.Inbox.Push (Message);
+    }
+
+    static void HandlerError (Lacewing::Server &Server, Lacewing::Error &Error)
+    {
+        RelayShard &Shard = *(RelayShard *) Server.Tag;
+
+        Error.Add ("Socket error");
+
+        const char * Text = Error.ToString ();
+
+        Shard.Inbox.Push (ShardMessage::New (ShardMessage::Error, 0, Text, strlen (Text)));
+    }
+
+    void Flush (ShardClient &Client)
+    {
+        if (Client.Dirty)
+        {
+            Dirty.Erase (Client.Dirty);
+            Client.Dirty = 0;
+        }
+
+        if (Client.Socket && Client.PendingCount)
+        {
+            const char * Buffers [64];
+            int Sizes [64];
+
+            for (int i = 0; i < Client.PendingCount; )
+            {
+                int Count = 0;
+
+                for (; i < Client.PendingCount && Count < 64; ++ i, ++ Count)
+                {
+                    Buffers [Count] = Client.Pending [i]->Data;
+                    Sizes   [Count] = Client.Pending [i]->Size;
+                }
+
+                Client.Socket->Send (Buffers, Sizes, Count);
+
+                ++ Counters.ShardWrites;
+            }
+        }
+
+        for (int i = 0; i < Client.PendingCount; ++ i)
+            Client.Pending [i]->Release ();
+
+        Client.PendingCount = 0;
+    }
+
+    static void FlushAll (void * Tag)
+    {
+        RelayShard &Shard = *(RelayShard *) Tag;
+
+        while (Shard.Dirty.First)
+            Shard.Flush (*** Shard.Dirty.First);
+    }
+
+    static void OutboxHandler (void * Tag, ShardMessage &Message)
+    {
+        RelayShard &Shard = *(RelayShard *) Tag;
+        ShardClient * Client = Message.Client;
+
+        switch (Message.Type)
+        {
+            case ShardMessage::Send:
+
+                if (!Client->Socket)
+                {
+                    Message.Frame->Release ();
+                    break;
+                }
+
+                Client->Queue (Message.Frame);
+
+                if (!Client->Dirty)
+                    Client->Dirty = Shard.Dirty.Push (Client);
+
+                break;
+
+            case ShardMessage::Close:
+
+                Shard.Flush (*Client);
+
+                if (Client->Socket)
+                    Client->Socket->Disconnect ();
+
+                break;
+
+            case ShardMessage::Release:
+
+                Shard.Flush (*Client);
+
+                delete Client;
+                break;
+
+            case ShardMessage::Host:
+            {
+                Lacewing::Filter Filter;
+
+                Filter.LocalIP   (((int *) Message.Data) [0]);
+                Filter.LocalPort (((int *) Message.Data) [1]);
+                Filter.Reuse     (((int *) Message.Data) [2] != 0);
+                Filter.ReusePort (true);
+
+                Shard.Socket.Host (Filter, true);
+                break;
+            }
+
+            case ShardMessage::Unhost:
+
+                Shard.Socket.Unhost ();
+                break;
+        };
+
+        Message.Delete ();
+    }
+};
+
+#endif
+
+#endif
@@ -103,10 +103,15 @@ Lacewing::Error * Lacewing::EventPump::StartEventLoop()
             {
                 epoll_event &EPollEvent = EPollEvents[i];
 
-                Continue = Ready (EPollEvent.data.ptr, (EPollEvent.events & EPOLLIN) != 0
+                /* Don't let a later event in the same batch undo an exit */
+
+                if (!Ready (EPollEvent.data.ptr, (EPollEvent.events & EPOLLIN) != 0
                                         || (EPollEvent.events & EPOLLHUP) != 0 ||
                                         (EPollEvent.events & EPOLLRDHUP) != 0,
-                                        (EPollEvent.events & EPOLLOUT) != 0);
+                                        (EPollEvent.events & EPOLLOUT) != 0))
+                {
+                    Continue = false;
+                }
             }
        
         #endif
@@ -126,8 +131,11 @@ Lacewing::Error * Lacewing::EventPump::StartEventLoop()
                 }
                 else
                 {
-                    Continue = Ready (KEvent.udata, KEvent.filter == EVFILT_READ ||
-                                (KEvent.flags & EV_EOF), KEvent.filter == EVFILT_WRITE);
+                    if (!Ready (KEvent.udata, KEvent.filter == EVFILT_READ ||
+                                (KEvent.flags & EV_EOF), KEvent.filter == EVFILT_WRITE))
+                    {
+                        Continue = false;
+                    }
                 }
             }
             
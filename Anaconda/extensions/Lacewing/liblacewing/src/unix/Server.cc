@@ -172,6 +172,7 @@ struct ServerInternal
         Nagle = true;
 
         BytesReceived = 0;
+        SendsQueued   = 0;
     }
 
     ~ServerInternal()
@@ -190,6 +191,10 @@ struct ServerInternal
 
     lw_i64 BytesReceived;
 
+    /* Written on the pump thread, read from anywhere by SendsQueued() */
+
+    volatile lw_i64 SendsQueued;
+
     /* When multithreading support is added, there will be one ReceiveBuffer per client.
        Until then, we can save RAM by having a single ReceiveBuffer global to the server. */
 
@@ -481,6 +486,16 @@ void Lacewing::Server::Host(Lacewing::Filter &Filter, bool)
         setsockopt(Internal.Socket, SOL_SOCKET, SO_REUSEADDR, (char *) &reuse, sizeof(reuse));
     }
 
+    #ifdef SO_REUSEPORT
+
+        if (Filter.ReusePort ())
+        {
+            int reuse = 1;
+            setsockopt(Internal.Socket, SOL_SOCKET, SO_REUSEPORT, (char *) &reuse, sizeof(reuse));
+        }
+
+    #endif
+
     sockaddr_in Address;
     memset(&Address, 0, sizeof(Address));
     
@@ -495,6 +510,9 @@ void Lacewing::Server::Host(Lacewing::Filter &Filter, bool)
         Error.Add(errno);
         Error.Add("Error binding port");
 
+        close(Internal.Socket);
+        Internal.Socket = -1;
+
         if(Internal.HandlerError)
             Internal.HandlerError(*this, Error);
         
@@ -508,6 +526,9 @@ void Lacewing::Server::Host(Lacewing::Filter &Filter, bool)
         Error.Add(errno);
         Error.Add("Error listening");
 
+        close(Internal.Socket);
+        Internal.Socket = -1;
+
         if(Internal.HandlerError)
             Internal.HandlerError(*this, Error);
         
@@ -559,6 +580,13 @@ lw_i64 Lacewing::Server::BytesReceived()
     return Internal.BytesReceived;
 }
 
+lw_i64 Lacewing::Server::SendsQueued()
+{
+    ServerInternal &Internal = *(ServerInternal *) InternalTag;
+
+    return LacewingCounterRead(&Internal.SendsQueued);
+}
+
 void Lacewing::Server::DisableNagling()
 {
     ServerInternal &Internal = *(ServerInternal *) InternalTag;
@@ -665,6 +693,7 @@ bool ServerClientInternal::Send(QueuedSend * Queued, const char * Buffer, int Si
     
     if((Transfer || QueuedSends.First) && !Queued)
     {
+        LacewingCounterAdd(&Server.SendsQueued, 1);
         QueuedSends.Add(Buffer, Size);
         return false;
     }
@@ -686,7 +715,10 @@ bool ServerClientInternal::Send(QueuedSend * Queued, const char * Buffer, int Si
                 /* Can't send now, queue it for later */
 
                 if(!Queued)
+                {
+                    LacewingCounterAdd(&Server.SendsQueued, 1);
                     QueuedSends.Add(Buffer, Size);
+                }
 
                 return false;
             }
@@ -698,6 +730,7 @@ bool ServerClientInternal::Send(QueuedSend * Queued, const char * Buffer, int Si
 
         if(!Queued)
         {
+            LacewingCounterAdd(&Server.SendsQueued, 1);
             QueuedSends.Add(Buffer + Sent, Size - Sent);
             return false;
         }
@@ -723,7 +756,10 @@ bool ServerClientInternal::Send(QueuedSend * Queued, const char * Buffer, int Si
                     /* More data from the remote is required before we can write. */
                     
                     if(!Queued)
+                    {
+                        LacewingCounterAdd(&Server.SendsQueued, 1);
                         QueuedSends.AddSSLWriteWhenReadable(Buffer, Size);
+                    }
                     
                     return false;
 
@@ -732,7 +768,10 @@ bool ServerClientInternal::Send(QueuedSend * Queued, const char * Buffer, int Si
                     /* The socket isn't ready for writing to right now. */
                     
                     if(!Queued)
+                    {
+                        LacewingCounterAdd(&Server.SendsQueued, 1);
                         QueuedSends.Add(Buffer, Size);
+                    }
                     
                     return false;
 
@@ -754,6 +793,79 @@ void Lacewing::Server::Client::Send(const char * Buffer, int Size)
     ((ServerClientInternal *) InternalTag)->Send(0, Buffer, Size);
 }
 
+void Lacewing::Server::Client::Send(const char ** Buffers, const int * Sizes, int Count)
+{
+    ServerClientInternal &Internal = *(ServerClientInternal *) InternalTag;
+
+    if(Internal.Context || Internal.Transfer || Internal.QueuedSends.First)
+    {
+        /* SSL, or waiting on something already queued */
+
+        for(int i = 0; i < Count; ++ i)
+            Internal.Send(0, Buffers [i], Sizes [i]);
+
+        return;
+    }
+
+    while(Count > 0)
+    {
+        iovec Vectors [64];
+
+        int Batch = Count < 64 ? Count : 64, Total = 0;
+
+        for(int i = 0; i < Batch; ++ i)
+        {
+            Vectors [i].iov_base = (void *) Buffers [i];
+            Vectors [i].iov_len  = Sizes [i];
+
+            Total += Sizes [i];
+        }
+
+        msghdr Message;
+        memset(&Message, 0, sizeof(Message));
+
+        Message.msg_iov    = Vectors;
+        Message.msg_iovlen = Batch;
+
+        int Sent = sendmsg(Internal.Socket, &Message, LacewingNoSignal);
+
+        if(Sent == Total)
+        {
+            Buffers += Batch;
+            Sizes   += Batch;
+            Count   -= Batch;
+
+            continue;
+        }
+
+        if(Sent == -1)
+        {
+            if(errno != EAGAIN)
+                return;
+
+            Sent = 0;
+        }
+
+        /* Queue whatever didn't get sent */
+
+        LacewingCounterAdd(&Internal.Server.SendsQueued, 1);
+
+        for(int i = 0; i < Count; ++ i)
+        {
+            if(Sent >= Sizes [i])
+            {
+                Sent -= Sizes [i];
+                continue;
+            }
+
+            Internal.QueuedSends.Add(Buffers [i] + Sent, Sizes [i] - Sent);
+            Sent = 0;
+        }
+
+        return;
+    }
+}
+
 void Lacewing::Server::Client::SendWritable(char * Buffer, int Size)
 {
     /* This only differs for Windows */
@@ -765,6 +877,7 @@ bool ServerClientInternal::SendFile(bool AllowQueue, const char * Filename, lw_i
 {   
     if(AllowQueue && (QueuedSends.First || Transfer))
     {        
+        LacewingCounterAdd(&Server.SendsQueued, 1);
         QueuedSends.Add(Filename, Offset, Size);
         return false;
     }
@@ -76,6 +76,16 @@ struct TimerInternal
 
 void TimerTick(TimerInternal &Internal)
 {
+    #ifdef LacewingUseTimerFD
+
+        /* The FD is edge triggered, so it won't fire again until the
+           expiration count has been read */
+
+        lw_i64 Expirations;
+        read(Internal.FD, &Expirations, sizeof(Expirations));
+
+    #endif
+
     if(Internal.HandlerTick)
         Internal.HandlerTick(Internal.Timer);
 }
@@ -44,6 +44,17 @@ struct UDPInternal
         HandlerError   = 0;
 
         Socket = -1;
+
+        #ifdef HAVE_RECVMMSG
+            Batch = 0;
+        #endif
+    }
+
+    ~UDPInternal()
+    {
+        #ifdef HAVE_RECVMMSG
+            free (Batch);
+        #endif
     }
 
     Lacewing::UDP::HandlerReceive  HandlerReceive;
@@ -56,8 +67,90 @@ struct UDPInternal
 
     lw_i64 BytesSent;
     lw_i64 BytesReceived;
+
+    #ifdef HAVE_RECVMMSG
+
+        /* Receive buffers for recvmmsg, allocated on the first receive.  Each
+           slot is big enough for any datagram, plus a null terminator. */
+
+        enum
+        {
+            BatchCount = 16,
+            BatchSlotSize = 64 * 1024 + 1
+        };
+
+        struct BatchBuffers
+        {
+            mmsghdr Headers [BatchCount];
+            iovec Vectors [BatchCount];
+            sockaddr_in Addresses [BatchCount];
+
+            char Data [BatchCount] [BatchSlotSize];
+        };
+
+        BatchBuffers * Batch;
+
+    #endif
 };
 
+#ifdef HAVE_RECVMMSG
+
+void UDPSocketCompletion(UDPInternal &Internal, bool)
+{
+    if (!Internal.Batch)
+        Internal.Batch = (UDPInternal::BatchBuffers *) malloc (sizeof (UDPInternal::BatchBuffers));
+
+    UDPInternal::BatchBuffers &Batch = *Internal.Batch;
+
+    for(;;)
+    {
+        for (int i = 0; i < UDPInternal::BatchCount; ++ i)
+        {
+            Batch.Vectors [i].iov_base = Batch.Data [i];
+            Batch.Vectors [i].iov_len  = UDPInternal::BatchSlotSize - 1;
+
+            memset (&Batch.Headers [i], 0, sizeof (mmsghdr));
+
+            Batch.Headers [i].msg_hdr.msg_name    = &Batch.Addresses [i];
+            Batch.Headers [i].msg_hdr.msg_namelen = sizeof (sockaddr_in);
+            Batch.Headers [i].msg_hdr.msg_iov     = &Batch.Vectors [i];
+            Batch.Headers [i].msg_hdr.msg_iovlen  = 1;
+        }
+
+        int Count = recvmmsg (Internal.Socket, Batch.Headers, UDPInternal::BatchCount, 0, 0);
+
+        if (Count <= 0)
+            break;
+
+        for (int i = 0; i < Count; ++ i)
+        {
+            sockaddr_in &From = Batch.Addresses [i];
+
+            if(Internal.RemoteIP && From.sin_addr.s_addr != Internal.RemoteIP)
+                continue;
+
+            int Bytes = Batch.Headers [i].msg_len;
+            char * Buffer = Batch.Data [i];
+
+            Lacewing::Address Address(From.sin_addr.s_addr, ntohs(From.sin_port));
+            Buffer[Bytes] = 0;
+
+            if(Internal.HandlerReceive)
+                Internal.HandlerReceive(Internal.Public, Address, Buffer, Bytes);
+
+            /* The handler may have unhosted */
+
+            if (Internal.Socket == -1)
+                return;
+        }
+
+        if (Count < UDPInternal::BatchCount)
+            break;
+    }
+}
+
+#else
+
 void UDPSocketCompletion(UDPInternal &Internal, bool)
 {
     sockaddr_in From;
@@ -83,6 +176,8 @@ void UDPSocketCompletion(UDPInternal &Internal, bool)
     }
 }
 
+#endif
+
 void Lacewing::UDP::Host(int Port)
 {
     Lacewing::Filter Filter;
@@ -221,6 +316,95 @@ void Lacewing::UDP::Send(Lacewing::Address &Address, const char * Data, int Size
     }
 }
 
+void Lacewing::UDP::Send(Lacewing::Address ** Addresses, int Count, const char * Data, int Size)
+{
+    #ifndef HAVE_SENDMMSG
+
+        for (int i = 0; i < Count; ++ i)
+            Send (*Addresses [i], Data, Size);
+
+    #else
+
+        UDPInternal &Internal = *(UDPInternal *) InternalTag;
+
+        if(Size == -1)
+            Size = strlen(Data);
+
+        const int MaxBatch = 64;
+
+        mmsghdr Headers [MaxBatch];
+        sockaddr_in To [MaxBatch];
+
+        iovec Vector;
+
+        Vector.iov_base = (void *) Data;
+        Vector.iov_len  = Size;
+
+        while (Count > 0)
+        {
+            int Batched = 0;
+
+            for (; Count > 0 && Batched < MaxBatch; -- Count, ++ Addresses)
+            {
+                Lacewing::Address &Address = **Addresses;
+
+                if(!Address.Ready())
+                {
+                    Lacewing::Error Error;
+
+                    Error.Add("The address object passed to Send() wasn't ready");
+                    Error.Add("Error sending");
+
+                    if(Internal.HandlerError)
+                        Internal.HandlerError(Internal.Public, Error);
+
+                    continue;
+                }
+
+                GetSockaddr(Address, To [Batched]);
+
+                memset (&Headers [Batched], 0, sizeof (mmsghdr));
+
+                Headers [Batched].msg_hdr.msg_name    = &To [Batched];
+                Headers [Batched].msg_hdr.msg_namelen = sizeof (sockaddr_in);
+                Headers [Batched].msg_hdr.msg_iov     = &Vector;
+                Headers [Batched].msg_hdr.msg_iovlen  = 1;
+
+                ++ Batched;
+            }
+
+            /* A short return means the datagram at Sent failed.  Like the
+               sendto() loop, only that datagram is lost: the error is
+               reported and the rest of the batch is still sent. */
+
+            for (int Sent = 0; Sent < Batched; )
+            {
+                int Result = sendmmsg (Internal.Socket, Headers + Sent, Batched - Sent, 0);
+
+                if (Result == -1)
+                {
+                    if (errno == EINTR)
+                        continue;
+
+                    Lacewing::Error Error;
+
+                    Error.Add(errno);            
+                    Error.Add("Error sending");
+
+                    if(Internal.HandlerError)
+                        Internal.HandlerError(*this, Error);
+
+                    ++ Sent;
+                    continue;
+                }
+
+                Sent += Result;
+            }
+        }
+
+    #endif
+}
+
 lw_i64 Lacewing::UDP::BytesReceived()
 {
     return ((UDPInternal *) InternalTag)->BytesReceived;
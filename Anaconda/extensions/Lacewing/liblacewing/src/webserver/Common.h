@@ -86,11 +86,19 @@ public:
         Session * Next;
 
         Map Data;
+    };
+
+    /* Sessions are hashed by the first half of the ID, which is already
+       an MD5 digest, into a table that doubles as it fills */
 
-    } * FirstSession;
+    Session ** Sessions;
+    int SessionBucketCount, SessionCount;
 
     Session * FindSession (const char * SessionID_Hex);
 
+    void AddSession (Session *);
+    void RemoveSession (Session *);
+
     bool AutoFinish;
 
     static void SocketConnect(Lacewing::Server &, Lacewing::Server::Client &);
@@ -179,7 +187,9 @@ public:
         HandlerDisconnect   = 0;
 
         AutoFinish = true;
-        FirstSession = 0;
+
+        Sessions = 0;
+        SessionBucketCount = SessionCount = 0;
 
         Timeout = 5;
 
@@ -187,6 +197,22 @@ public:
         Timer.onTick (TimerTickStatic);
     }
 
+    inline ~WebserverInternal()
+    {
+        for (int i = 0; i < SessionBucketCount; ++ i)
+        {
+            while (Sessions [i])
+            {
+                Session * Next = Sessions [i]->Next;
+
+                delete Sessions [i];
+                Sessions [i] = Next;
+            }
+        }
+
+        free (Sessions);
+    }
+
     static void TimerTickStatic (Lacewing::Timer &);
     void TimerTick ();
 };
@@ -27,6 +27,10 @@
  * SUCH DAMAGE.
  */
 
+/* Case insensitive string map.  Items are kept in a list (newest first) for
+   iteration, and hashed into buckets for lookup.  Clear() keeps the items and
+   buckets for reuse, since the request maps are cleared for every request. */
+
 struct Map
 {
 public:
@@ -35,53 +39,124 @@ public:
     {
         char * Key, * Value;
         Item * Next;
+
+        Item * NextInBucket;
+        unsigned int Hash;
     };
 
     Item * First;
 
     inline Map()
     {
-        First = 0;
+        First = Spare = 0;
+        Count = 0;
+
+        Buckets = InlineBuckets;
+        BucketCount = InlineBucketCount;
+
+        memset (InlineBuckets, 0, sizeof (InlineBuckets));
     }
 
     inline ~Map()
     {
         Clear();
+
+        while (Spare)
+        {
+            Item * Next = Spare->Next;
+
+            delete Spare;
+            Spare = Next;
+        }
+
+        if (Buckets != InlineBuckets)
+            free (Buckets);
+    }
+
+    static inline unsigned int Hash (const char * Key)
+    {
+        unsigned int Hash = 2166136261u;
+
+        for (; *Key; ++ Key)
+        {
+            unsigned char c = *Key;
+
+            if (c >= 'A' && c <= 'Z')
+                c += 'a' - 'A';
+
+            Hash = (Hash ^ c) * 16777619u;
+        }
+
+        return Hash;
+    }
+
+    inline Item * Find (const char * Key, unsigned int Hash)
+    {
+        for (Item * Current = Buckets [Hash & (BucketCount - 1)]; Current;
+                    Current = Current->NextInBucket)
+        {
+            if (Current->Hash == Hash && !strcasecmp (Current->Key, Key))
+                return Current;
+        }
+
+        return 0;
     }
 
     inline const char * Get (const char * Key)
     {
-        for(Item * Current = First; Current; Current = Current->Next)
-            if(!strcasecmp(Current->Key, Key))
-                return Current->Value;
+        Item * Found = Find (Key, Hash (Key));
         
-        return "";
+        return Found ? Found->Value : "";
     }
 
     inline Item * Set (const char * Key, const char * Value, bool Copy = true)
     {
-        for(Item * Current = First; Current; Current = Current->Next)
+        unsigned int Hash = this->Hash (Key);
+
+        Item * New = Find (Key, Hash);
+
+        if (New)
         {
-            if(!strcasecmp(Current->Key, Key))
-            {
-                free (Current->Value);
-                Current->Value = Copy ? strdup (Value) : (char *) Value;
+            free (New->Value);
+            New->Value = Copy ? strdup (Value) : (char *) Value;
 
-                return Current;
-            }
+            if (!Copy)
+                free ((char *) Key);
+
+            return New;
         }
         
-        Item * New = new Item;
+        if (Spare)
+        {
+            New = Spare;
+            Spare = Spare->Next;
+        }
+        else
+            New = new Item;
         
         New->Key = Copy ? strdup (Key) : (char *) Key;
         New->Value = Copy ? strdup (Value) : (char *) Value;
+        New->Hash = Hash;
+
         New->Next = First;
+        First = New;
+
+        Item ** Bucket = &Buckets [Hash & (BucketCount - 1)];
+
+        New->NextInBucket = *Bucket;
+        *Bucket = New;
 
-        return (First = New);
+        if (++ Count > BucketCount)
+            Grow ();
+
+        return New;
     }
 
     inline void Clear ()
     {
+        if (!First)
+            return;
+
         while (First)
         {
             free (First->Key);
@@ -89,9 +164,47 @@ public:
 
             Item * Next = First->Next;
 
-            delete First;
+            First->Next = Spare;
+            Spare = First;
+
             First = Next;
         }
+
+        memset (Buckets, 0, sizeof (*Buckets) * BucketCount);
+        Count = 0;
+    }
+
+private:
+
+    enum { InlineBucketCount = 16 };
+
+    Item * InlineBuckets [InlineBucketCount];
+    Item ** Buckets;
+
+    int BucketCount, Count;
+
+    Item * Spare;
+
+    inline void Grow ()
+    {
+        Item ** NewBuckets = (Item **) calloc (BucketCount * 4, sizeof (*NewBuckets));
+
+        if (!NewBuckets)
+            return;
+
+        if (Buckets != InlineBuckets)
+            free (Buckets);
+
+        Buckets = NewBuckets;
+        BucketCount *= 4;
+
+        for (Item * Current = First; Current; Current = Current->Next)
+        {
+            Item ** Bucket = &Buckets [Current->Hash & (BucketCount - 1)];
+
+            Current->NextInBucket = *Bucket;
+            *Bucket = Current;
+        }
     }
 };
 
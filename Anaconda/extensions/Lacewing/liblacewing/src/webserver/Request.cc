@@ -170,8 +170,8 @@ void RequestInternal::ProcessHeader (const char * Name, char * Value)
             while(*CookieName == ' ')
                 ++ CookieName;
 
-            while(*CookieName && CookieName[strlen(CookieName - 1)] == ' ')
-                CookieName [strlen(CookieName - 1)] = 0;
+            for(size_t Length = strlen(CookieName); Length && CookieName[Length - 1] == ' '; )
+                CookieName[-- Length] = 0;
 
             /* The copy in InCookies doesn't get modified, so the response generator
                can determine which cookies have been changed. */
@@ -60,16 +60,7 @@ void Lacewing::Webserver::Request::Session(const char * Key, const char * Value)
         Session->ID_Part1 = ((lw_i64 *) SessionID) [0];
         Session->ID_Part2 = ((lw_i64 *) SessionID) [1];
 
-        if (Internal.Server.FirstSession)
-        {
-            Session->Next = Internal.Server.FirstSession;
-            Internal.Server.FirstSession = Session;
-        }
-        else
-        {
-            Session->Next = 0;
-            Internal.Server.FirstSession = Session;
-        }
+        Internal.Server.AddSession (Session);
     }
 
     Session->Data.Set (Key, Value);
@@ -87,23 +78,14 @@ const char * Lacewing::Webserver::Request::Session(const char * Key)
 
 void Lacewing::Webserver::CloseSession (const char * ID)
 {
-    RequestInternal &Internal = *((RequestInternal *) InternalTag);
+    WebserverInternal &Internal = *((WebserverInternal *) InternalTag);
 
-    WebserverInternal::Session * Session = Internal.Server.FindSession (ID);
+    WebserverInternal::Session * Session = Internal.FindSession (ID);
 
-    if (Session == Internal.Server.FirstSession)
-        Internal.Server.FirstSession = Session->Next;
-    else
-    {
-        for (WebserverInternal::Session * S = Internal.Server.FirstSession; S; S = S->Next)
-        {
-            if (S->Next == Session)
-            {
-                S->Next = Session->Next;
-                break;
-            }
-        }
-    }
+    if (!Session)
+        return;
+
+    Internal.RemoveSession (Session);
 
     delete Session;
 }
@@ -118,14 +100,28 @@ const char * Lacewing::Webserver::Request::Session()
     return Cookie (SessionCookie);
 }
 
+static inline int HexDigit (char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+
+    return -1;
+}
+
 WebserverInternal::Session * WebserverInternal::FindSession (const char * SessionID_Hex)
 {
-    if (strlen (SessionID_Hex) != 32)
+    if (!SessionCount || strlen (SessionID_Hex) != 32)
         return 0;
 
     union
     {
-        char SessionID_Bytes [16];
+        unsigned char SessionID_Bytes [16];
         
         struct
         {
@@ -135,20 +131,21 @@ WebserverInternal::Session * WebserverInternal::FindSession (const char * Sessio
         } SessionID;
     };
 
-    char hex [3];
-    hex [2] = 0;
-
     for (int i = 0, c = 0; i < 16; ++ i, c += 2)
     {
-        hex [0] = SessionID_Hex [c];
-        hex [1] = SessionID_Hex [c + 1];
+        int High = HexDigit (SessionID_Hex [c]),
+            Low  = HexDigit (SessionID_Hex [c + 1]);
+
+        if (High == -1 || Low == -1)
+            return 0;
 
-        SessionID_Bytes [i] = (char) strtol (hex, 0, 16);
+        SessionID_Bytes [i] = (unsigned char) ((High << 4) | Low);
     }
 
-    WebserverInternal::Session * Session;
+    WebserverInternal::Session * Session =
+        Sessions [((size_t) SessionID.Part1) & (SessionBucketCount - 1)];
 
-    for (Session = FirstSession; Session; Session = Session->Next)
+    for (; Session; Session = Session->Next)
     {
         if (Session->ID_Part1 == SessionID.Part1 &&
                 Session->ID_Part2 == SessionID.Part2)
@@ -160,6 +157,63 @@ WebserverInternal::Session * WebserverInternal::FindSession (const char * Sessio
     return Session;
 }
 
+void WebserverInternal::AddSession (Session * Session)
+{
+    if (SessionCount >= SessionBucketCount)
+    {
+        /* Rehash into a table twice the size */
+
+        int NewBucketCount = SessionBucketCount ? SessionBucketCount * 2 : 64;
+
+        WebserverInternal::Session ** NewSessions = (WebserverInternal::Session **)
+                    calloc (NewBucketCount, sizeof (*NewSessions));
+
+        for (int i = 0; i < SessionBucketCount; ++ i)
+        {
+            while (Sessions [i])
+            {
+                WebserverInternal::Session * Next = Sessions [i]->Next;
+                WebserverInternal::Session ** Bucket =
+                    &NewSessions [((size_t) Sessions [i]->ID_Part1) & (NewBucketCount - 1)];
+
+                Sessions [i]->Next = *Bucket;
+                *Bucket = Sessions [i];
+
+                Sessions [i] = Next;
+            }
+        }
+
+        free (Sessions);
+
+        Sessions = NewSessions;
+        SessionBucketCount = NewBucketCount;
+    }
+
+    WebserverInternal::Session ** Bucket =
+        &Sessions [((size_t) Session->ID_Part1) & (SessionBucketCount - 1)];
+
+    Session->Next = *Bucket;
+    *Bucket = Session;
+
+    ++ SessionCount;
+}
+
+void WebserverInternal::RemoveSession (Session * Session)
+{
+    WebserverInternal::Session ** Link =
+        &Sessions [((size_t) Session->ID_Part1) & (SessionBucketCount - 1)];
+
+    for (; *Link; Link = &(*Link)->Next)
+    {
+        if (*Link == Session)
+        {
+            *Link = Session->Next;
+            -- SessionCount;
+
+            break;
+        }
+    }
+}
 
 Lacewing::Webserver::Request::SessionItem * Lacewing::Webserver::Request::FirstSessionItem ()
 {
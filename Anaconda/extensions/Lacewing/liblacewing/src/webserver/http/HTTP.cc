@@ -67,54 +67,47 @@ void HTTPClient::Process (char * Buffer, int Size)
     LastActivityTime = time (0);
 
 
-    /* State 0 : Line content
-       State 1 : Got CR, need LF
-       State 2 : Message body */
+    /* State 0 : Headers
+       State 2 : Form body
+       State 3 : Multipart body */
 
     if(State < 2)
     {
-        for(char * i = Buffer; *i; )
+        /* Lines are terminated in place in the receive buffer.  Only a line
+           split across two receives gets copied, to join the two halves. */
+
+        for(;;)
         {
-            if(State == 0 && *i == '\r')
-            {
-                State = 1;
-            }
-            else if(*i == '\n')
-            {
-                i [State == 1 ? -1 : 0] = 0;
+            char * End = (char *) memchr(Buffer, '\n', Size);
 
-                if(this->Buffer.Size)
-                {
-                    this->Buffer.Add (Buffer, -1);
-                    this->Buffer.Add <char> (0);
+            if(!End)
+                break;
 
-                    ProcessLine(this->Buffer.Buffer);
+            *End = 0;
 
-                    this->Buffer.Reset();
-                }
-                else
-                {
-                    ProcessLine(Buffer);
-                }
+            char * Line = Buffer;
+            size_t Length = End - Buffer;
 
-                Size -= (++ i) - Buffer;
-                Buffer = i;
+            Size -= (int) Length + 1;
+            Buffer = End + 1;
 
-                if(State == -1 || State >= 2)
-                    break;
+            if(this->Buffer.Size)
+            {
+                this->Buffer.Add(Line, (int) Length + 1);
 
-                State = 0;
-                continue;
+                Line = this->Buffer.Buffer;
+                Length = this->Buffer.Size - 1;
             }
-            else if(State == 1)
-            {
-                /* The only thing valid after \r is \n */
 
-                State = -1;
+            if(Length > 0 && Line[Length - 1] == '\r')
+                Line[Length - 1] = 0;
+
+            ProcessLine(Line);
+
+            this->Buffer.Reset();
+
+            if(State == -1 || State >= 2)
                 break;
-            }
-                
-            ++ i;
         }
             
         if(State == -1)
@@ -214,6 +214,10 @@ struct ServerInternal
     __int64 BytesSent;
     __int64 BytesReceived;
 
+    /* Sends can come from any thread, so this one is interlocked */
+
+    volatile __int64 SendsQueued;
+
     Lacewing::Server &Public;
 
     SOCKET Socket;
@@ -253,6 +257,7 @@ struct ServerInternal
 
         BytesSent = 0;
         BytesReceived = 0;
+        SendsQueued = 0;
 
         CertificateLoaded = false;
         ClientSpeaksFirst = false;
@@ -802,6 +807,7 @@ bool ServerClientInternal::SendWritable(bool AllowQueue, char * Data, int Size)
     {
         if(SendingFile)
         {
+            InterlockedIncrement64(&Server.SendsQueued);
             QueuedSends.Add(Data, Size);
             return true;
         }
@@ -884,6 +890,7 @@ bool ServerClientInternal::Send(bool AllowQueue, const char * Data, int Size)
     {
         if(SendingFile)
         {
+            InterlockedIncrement64(&Server.SendsQueued);
             QueuedSends.Add(Data, Size);
             return true;
         }
@@ -932,6 +939,12 @@ void Lacewing::Server::Client::Send(const char * Data, int Size)
     ((ServerClientInternal *) InternalTag)->Send(true, Data, Size);
 }
 
+void Lacewing::Server::Client::Send(const char ** Buffers, const int * Sizes, int Count)
+{
+    for(int i = 0; i < Count; ++ i)
+        ((ServerClientInternal *) InternalTag)->Send(true, Buffers [i], Sizes [i]);
+}
+
 
 /* False means the next queued data won't be sent, either because the transfer failed or we were able to use TransmitFile */
 
@@ -946,7 +959,8 @@ bool ServerClientInternal::SendFile(bool AllowQueue, const char * Filename, __in
     {
         if(SendingFile)
         {
-            QueuedSends.Add(Filename, Offset, Size);
+            InterlockedIncrement64(&Server.SendsQueued);
+        QueuedSends.Add(Filename, Offset, Size);
             return true;
         }
     }
@@ -1638,6 +1652,13 @@ lw_i64 Lacewing::Server::BytesReceived()
     return Internal.BytesReceived;
 }
 
+lw_i64 Lacewing::Server::SendsQueued()
+{
+    ServerInternal &Internal = *(ServerInternal *) InternalTag;
+
+    return LacewingCounterRead(&Internal.SendsQueued);
+}
+
 void Lacewing::Server::DisableNagling()
 {
     ServerInternal &Internal = *(ServerInternal *) InternalTag;
@@ -322,6 +322,12 @@ void Lacewing::UDP::Send(Lacewing::Address &Address, const char * Data, int Size
     }
 }
 
+void Lacewing::UDP::Send(Lacewing::Address ** Addresses, int Count, const char * Data, int Size)
+{
+    for (int i = 0; i < Count; ++ i)
+        Send (*Addresses [i], Data, Size);
+}
+
 lw_i64 Lacewing::UDP::BytesReceived()
 {
     return ((UDPInternal *) InternalTag)->BytesReceived;
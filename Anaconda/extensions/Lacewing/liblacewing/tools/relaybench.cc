@@ -0,0 +1,662 @@
+
+/* vim: set et ts=4 sw=4 ft=cpp:
+ *
+ * Copyright (C) 2011 James McLaughlin.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/* Relay load generator.  Hosts a RelayServer and connects a number of
+   RelayClients to it over loopback, puts them in channels, and then has every
+   client send (or blast) timestamped messages to its channel at a fixed rate.
+   Reports delivered messages/s and bytes/s and the end-to-end latency
+   percentiles.
+
+   With --save-baseline the results are written to a file, and a later run
+   with --baseline compares against it and exits with 1 if throughput dropped
+   or p99 latency rose by more than --tolerance percent.
+
+   Build with "make relaybench".  Unix only.  Measured baselines are in
+   relaybench-results.txt. */
+
+#include "../include/Lacewing.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+struct Options
+{
+    int Clients, ChannelSize, Rate, Size, Duration;
+    int Threads, Shards, Port;
+    bool Blast;
+
+    const char * Baseline, * SaveBaseline;
+    double Tolerance;
+
+} Options;
+
+static lw_i64 Now ()
+{
+    timespec Time;
+    clock_gettime (CLOCK_MONOTONIC, &Time);
+
+    return ((lw_i64) Time.tv_sec) * 1000000 + Time.tv_nsec / 1000;
+}
+
+/* Log-linear latency histogram in microseconds: exact below 1024, then 512
+   buckets per power of two (under 0.2% error). */
+
+struct Histogram
+{
+    enum
+    {
+        Linear     = 1024,
+        SubBuckets = 512,
+        Powers     = 40,
+        Count      = Linear + Powers * SubBuckets
+    };
+
+    unsigned int * Counts;
+    lw_i64 Total;
+
+    Histogram ()
+    {
+        Counts = (unsigned int *) calloc (Count, sizeof (*Counts));
+        Total = 0;
+    }
+
+    ~ Histogram ()
+    {
+        free (Counts);
+    }
+
+    static int Bucket (lw_i64 Value)
+    {
+        if (Value < Linear)
+            return Value < 0 ? 0 : (int) Value;
+
+        int Power = 63 - __builtin_clzll (Value);
+        int Index = Linear + (Power - 10) * SubBuckets
+                        + (int) (Value >> (Power - 9)) - SubBuckets;
+
+        return Index < Count ? Index : Count - 1;
+    }
+
+    static lw_i64 Value (int Bucket)
+    {
+        if (Bucket < Linear)
+            return Bucket;
+
+        Bucket -= Linear;
+
+        return ((lw_i64) (Bucket % SubBuckets + SubBuckets))
+                    << (Bucket / SubBuckets + 1);
+    }
+
+    inline void Add (lw_i64 Value)
+    {
+        ++ Counts [Bucket (Value)];
+        ++ Total;
+    }
+
+    void Merge (Histogram &Other)
+    {
+        for (int i = 0; i < Count; ++ i)
+            Counts [i] += Other.Counts [i];
+
+        Total += Other.Total;
+    }
+
+    lw_i64 Percentile (double P)
+    {
+        if (!Total)
+            return 0;
+
+        lw_i64 Target = (lw_i64) (P * Total), Seen = 0;
+
+        if (Target >= Total)
+            Target = Total - 1;
+
+        for (int i = 0; i < Count; ++ i)
+            if ((Seen += Counts [i]) > Target)
+                return Value (i);
+
+        return Value (Count - 1);
+    }
+};
+
+static volatile long Ready = 0, Failed = 0, Sending = 0;
+
+struct BenchThread;
+
+struct BenchClient
+{
+    BenchThread &Thread;
+    int Index;
+
+    Lacewing::RelayClient Client;
+    Lacewing::RelayClient::Channel * Channel;
+
+    BenchClient (BenchThread &_Thread, Lacewing::Pump &Pump, int _Index)
+        : Thread (_Thread), Index (_Index), Client (Pump)
+    {
+        Channel = 0;
+        Client.Tag = this;
+    }
+};
+
+struct BenchThread
+{
+    Lacewing::EventPump Pump;
+    Lacewing::Timer Timer;
+    Lacewing::Thread Thread;
+
+    BenchClient ** Clients;
+    int ClientCount;
+
+    char * Payload;
+
+    lw_i64 LastTick;
+    double Credit;
+    int Next;
+
+    lw_i64 Sent, Received, Bytes;
+    Histogram Latency;
+
+    BenchThread () : Timer (Pump), Thread ("RelayBench", (void *) Run)
+    {
+        Clients = 0;
+        ClientCount = 0;
+
+        Payload = (char *) calloc (Options.Size, 1);
+
+        LastTick = 0;
+        Credit = 0;
+        Next = 0;
+
+        Sent = Received = Bytes = 0;
+
+        Timer.Tag = this;
+    }
+
+    static int Run (BenchThread * Thread)
+    {
+        Thread->Pump.StartEventLoop ();
+        return 0;
+    }
+};
+
+void onConnect (Lacewing::RelayClient &Client)
+{
+    char Name [32];
+    sprintf (Name, "bench%d", ((BenchClient *) Client.Tag)->Index);
+
+    Client.Name (Name);
+}
+
+void onConnectionDenied (Lacewing::RelayClient &Client, const char * Reason)
+{
+    fprintf (stderr, "Connection denied: %s\n", Reason);
+    __sync_add_and_fetch (&Failed, 1);
+}
+
+void onNameSet (Lacewing::RelayClient &Client)
+{
+    char Channel [32];
+    sprintf (Channel, "bench%d", ((BenchClient *) Client.Tag)->Index / Options.ChannelSize);
+
+    Client.Join (Channel);
+}
+
+void onNameDenied (Lacewing::RelayClient &Client, const char * Name, const char * Reason)
+{
+    fprintf (stderr, "Name denied: %s\n", Reason);
+    __sync_add_and_fetch (&Failed, 1);
+}
+
+void onJoin (Lacewing::RelayClient &Client, Lacewing::RelayClient::Channel &Channel)
+{
+    ((BenchClient *) Client.Tag)->Channel = &Channel;
+    __sync_add_and_fetch (&Ready, 1);
+}
+
+void onJoinDenied (Lacewing::RelayClient &Client, const char * Channel, const char * Reason)
+{
+    fprintf (stderr, "Join denied: %s\n", Reason);
+    __sync_add_and_fetch (&Failed, 1);
+}
+
+void onError (Lacewing::RelayClient &Client, Lacewing::Error &Error)
+{
+    fprintf (stderr, "Client error: %s\n", Error.ToString ());
+    __sync_add_and_fetch (&Failed, 1);
+}
+
+void onChannelMessage (Lacewing::RelayClient &Client, Lacewing::RelayClient::Channel &Channel,
+                           Lacewing::RelayClient::Channel::Peer &Peer, bool Blasted,
+                           int Subchannel, char * Data, int Size, int Variant)
+{
+    if (!Sending || Size < (int) sizeof (lw_i64))
+        return;
+
+    BenchThread &Thread = ((BenchClient *) Client.Tag)->Thread;
+
+    lw_i64 Stamp;
+    memcpy (&Stamp, Data, sizeof (Stamp));
+
+    Thread.Latency.Add (Now () - Stamp);
+
+    ++ Thread.Received;
+    Thread.Bytes += Size;
+}
+
+/* Each thread's clients share one credit counter, so the aggregate rate holds
+   even when the timer ticks late. */
+
+void onTick (Lacewing::Timer &Timer)
+{
+    BenchThread &Thread = *(BenchThread *) Timer.Tag;
+
+    lw_i64 Time = Now ();
+
+    if (!Sending)
+    {
+        Thread.LastTick = Time;
+        return;
+    }
+
+    Thread.Credit += ((double) Options.Rate) * Thread.ClientCount
+                        * (Time - Thread.LastTick) / 1000000.0;
+
+    Thread.LastTick = Time;
+
+    for (; Thread.Credit >= 1; Thread.Next = (Thread.Next + 1) % Thread.ClientCount)
+    {
+        Lacewing::RelayClient::Channel * Channel = Thread.Clients [Thread.Next]->Channel;
+
+        Thread.Credit -= 1;
+
+        if (!Channel)
+            continue;
+
+        lw_i64 Stamp = Now ();
+        memcpy (Thread.Payload, &Stamp, sizeof (Stamp));
+
+        if (Options.Blast)
+            Channel->Blast (0, Thread.Payload, Options.Size);
+        else
+            Channel->Send (0, Thread.Payload, Options.Size);
+
+        ++ Thread.Sent;
+    }
+}
+
+void onServerError (Lacewing::RelayServer &Server, Lacewing::Error &Error)
+{
+    fprintf (stderr, "Server error: %s\n", Error.ToString ());
+}
+
+static int RunServer (Lacewing::EventPump * Pump)
+{
+    Pump->StartEventLoop ();
+    return 0;
+}
+
+struct Result
+{
+    double Messages, Bytes;
+    double P50, P99, P999;
+};
+
+static bool ReadBaseline (const char * Filename, Result &Baseline)
+{
+    FILE * File = fopen (Filename, "r");
+
+    if (!File)
+        return false;
+
+    memset (&Baseline, 0, sizeof (Baseline));
+
+    char Key [64];
+    double Value;
+
+    while (fscanf (File, "%63s %lf", Key, &Value) == 2)
+    {
+        if (!strcmp (Key, "messages_per_second"))
+            Baseline.Messages = Value;
+        else if (!strcmp (Key, "bytes_per_second"))
+            Baseline.Bytes = Value;
+        else if (!strcmp (Key, "p50_us"))
+            Baseline.P50 = Value;
+        else if (!strcmp (Key, "p99_us"))
+            Baseline.P99 = Value;
+        else if (!strcmp (Key, "p999_us"))
+            Baseline.P999 = Value;
+    }
+
+    fclose (File);
+    return true;
+}
+
+static bool WriteBaseline (const char * Filename, Result &Result)
+{
+    FILE * File = fopen (Filename, "w");
+
+    if (!File)
+        return false;
+
+    fprintf (File, "clients %d\nchannel_size %d\nrate %d\nsize %d\nblast %d\nshards %d\n",
+                Options.Clients, Options.ChannelSize, Options.Rate, Options.Size,
+                Options.Blast ? 1 : 0, Options.Shards);
+
+    fprintf (File, "messages_per_second %.0f\nbytes_per_second %.0f\n"
+                   "p50_us %.0f\np99_us %.0f\np999_us %.0f\n",
+                Result.Messages, Result.Bytes, Result.P50, Result.P99, Result.P999);
+
+    fclose (File);
+    return true;
+}
+
+static void Usage ()
+{
+    fprintf (stderr,
+        "Usage: relaybench [options]\n\n"
+        "  --clients N        number of clients (%d)\n"
+        "  --channel-size N   clients per channel (%d)\n"
+        "  --rate N           messages per client per second (%d)\n"
+        "  --size N           message size in bytes, at least 8 (%d)\n"
+        "  --duration N       seconds to measure for (%d)\n"
+        "  --blast            send over UDP instead of TCP\n"
+        "  --threads N        client threads (%d)\n"
+        "  --shards N         server shard threads, 0 for one pump (%d)\n"
+        "  --port N           loopback port (%d)\n"
+        "  --baseline FILE    compare against a saved baseline\n"
+        "  --save-baseline FILE\n"
+        "  --tolerance PCT    allowed regression in percent (%.0f)\n",
+        Options.Clients, Options.ChannelSize, Options.Rate, Options.Size,
+        Options.Duration, Options.Threads, Options.Shards, Options.Port,
+        Options.Tolerance);
+}
+
+int main (int argc, char * argv [])
+{
+    Options.Clients       = 500;
+    Options.ChannelSize   = 10;
+    Options.Rate          = 10;
+    Options.Size          = 64;
+    Options.Duration      = 10;
+    Options.Threads       = 2;
+    Options.Shards        = 0;
+    Options.Port          = 6130;
+    Options.Blast         = false;
+    Options.Baseline      = 0;
+    Options.SaveBaseline  = 0;
+    Options.Tolerance     = 10;
+
+    for (int i = 1; i < argc; ++ i)
+    {
+        const char * Arg = argv [i], * Value = i + 1 < argc ? argv [i + 1] : 0;
+
+        if (!strcmp (Arg, "--blast"))
+        {
+            Options.Blast = true;
+            continue;
+        }
+
+        if (!Value)
+        {
+            Usage ();
+            return 2;
+        }
+
+        ++ i;
+
+        if (!strcmp (Arg, "--clients"))
+            Options.Clients = atoi (Value);
+        else if (!strcmp (Arg, "--channel-size"))
+            Options.ChannelSize = atoi (Value);
+        else if (!strcmp (Arg, "--rate"))
+            Options.Rate = atoi (Value);
+        else if (!strcmp (Arg, "--size"))
+            Options.Size = atoi (Value);
+        else if (!strcmp (Arg, "--duration"))
+            Options.Duration = atoi (Value);
+        else if (!strcmp (Arg, "--threads"))
+            Options.Threads = atoi (Value);
+        else if (!strcmp (Arg, "--shards"))
+            Options.Shards = atoi (Value);
+        else if (!strcmp (Arg, "--port"))
+            Options.Port = atoi (Value);
+        else if (!strcmp (Arg, "--baseline"))
+            Options.Baseline = Value;
+        else if (!strcmp (Arg, "--save-baseline"))
+            Options.SaveBaseline = Value;
+        else if (!strcmp (Arg, "--tolerance"))
+            Options.Tolerance = atof (Value);
+        else
+        {
+            Usage ();
+            return 2;
+        }
+    }
+
+    if (Options.Clients < 1 || Options.ChannelSize < 1 || Options.Threads < 1
+            || Options.Duration < 1 || Options.Size < (int) sizeof (lw_i64))
+    {
+        Usage ();
+        return 2;
+    }
+
+    if (Options.Threads > Options.Clients)
+        Options.Threads = Options.Clients;
+
+    Result Baseline;
+
+    if (Options.Baseline && !ReadBaseline (Options.Baseline, Baseline))
+    {
+        fprintf (stderr, "Couldn't read %s\n", Options.Baseline);
+        return 2;
+    }
+
+    /* Each client is a TCP socket, a UDP socket and the server's end of the
+       connection, so the default descriptor limit runs out quickly. */
+
+    rlimit Limit;
+
+    if (!getrlimit (RLIMIT_NOFILE, &Limit))
+    {
+        Limit.rlim_cur = Limit.rlim_max;
+        setrlimit (RLIMIT_NOFILE, &Limit);
+    }
+
+    Lacewing::EventPump ServerPump;
+    Lacewing::RelayServer Server (ServerPump);
+
+    Server.onError (onServerError);
+
+    if (Options.Shards > 0)
+        Server.SetShardCount (Options.Shards);
+
+    /* Reuse, so a rerun isn't stopped by the last run's TIME_WAIT sockets */
+
+    Lacewing::Filter Filter;
+
+    Filter.LocalPort (Options.Port);
+    Filter.Reuse (true);
+
+    Server.Host (Filter);
+
+    if (!Server.Hosting ())
+    {
+        fprintf (stderr, "Couldn't host on port %d\n", Options.Port);
+        return 2;
+    }
+
+    Lacewing::Thread ServerThread ("RelayBenchServer", (void *) RunServer);
+    ServerThread.Start (&ServerPump);
+
+    BenchThread * Threads = new BenchThread [Options.Threads];
+
+    for (int t = 0; t < Options.Threads; ++ t)
+    {
+        Threads [t].Clients = new BenchClient * [Options.Clients / Options.Threads + 1];
+
+        Threads [t].Timer.onTick (onTick);
+        Threads [t].Timer.Start (10);
+    }
+
+    /* Clients are dealt out round robin, so every channel spans the threads */
+
+    for (int i = 0; i < Options.Clients; ++ i)
+    {
+        BenchThread &Thread = Threads [i % Options.Threads];
+
+        BenchClient * Client = new BenchClient (Thread, Thread.Pump, i);
+
+        Client->Client.onConnect           (onConnect);
+        Client->Client.onConnectionDenied  (onConnectionDenied);
+        Client->Client.onNameSet           (onNameSet);
+        Client->Client.onNameDenied        (onNameDenied);
+        Client->Client.onJoin              (onJoin);
+        Client->Client.onJoinDenied        (onJoinDenied);
+        Client->Client.onError             (onError);
+        Client->Client.onChannelMessage    (onChannelMessage);
+
+        Thread.Clients [Thread.ClientCount ++] = Client;
+
+        Client->Client.Connect ("127.0.0.1", Options.Port);
+    }
+
+    for (int t = 0; t < Options.Threads; ++ t)
+        Threads [t].Thread.Start (&Threads [t]);
+
+    /* Wait for everyone to join, giving up after a while without progress */
+
+    for (long Last = -1, Idle = 0; Ready + Failed < Options.Clients; )
+    {
+        usleep (100000);
+
+        if (Ready == Last)
+        {
+            if (++ Idle >= 100)
+                break;
+        }
+        else
+        {
+            Last = Ready;
+            Idle = 0;
+        }
+    }
+
+    if (Ready < Options.Clients)
+    {
+        fprintf (stderr, "Only %ld of %d clients joined\n", (long) Ready, Options.Clients);
+        _exit (2);
+    }
+
+    printf ("%d clients in %d channels, %d msg/s each, %d bytes, %s, %d shard%s\n",
+                Options.Clients, (Options.Clients + Options.ChannelSize - 1) / Options.ChannelSize,
+                Options.Rate, Options.Size, Options.Blast ? "UDP" : "TCP",
+                Options.Shards, Options.Shards == 1 ? "" : "s");
+
+    lw_i64 Start = Now ();
+
+    __sync_lock_test_and_set (&Sending, 1);
+    usleep (Options.Duration * 1000000);
+    __sync_lock_test_and_set (&Sending, 0);
+
+    double Elapsed = (Now () - Start) / 1000000.0;
+
+    for (int t = 0; t < Options.Threads; ++ t)
+    {
+        Threads [t].Pump.PostEventLoopExit ();
+        Threads [t].Thread.Join ();
+    }
+
+    ServerPump.PostEventLoopExit ();
+    ServerThread.Join ();
+
+    Histogram Latency;
+    lw_i64 Sent = 0, Received = 0, Bytes = 0;
+
+    for (int t = 0; t < Options.Threads; ++ t)
+    {
+        Latency.Merge (Threads [t].Latency);
+
+        Sent      += Threads [t].Sent;
+        Received  += Threads [t].Received;
+        Bytes     += Threads [t].Bytes;
+    }
+
+    Result Result;
+
+    Result.Messages  = Received / Elapsed;
+    Result.Bytes     = Bytes / Elapsed;
+    Result.P50       = (double) Latency.Percentile (0.5);
+    Result.P99       = (double) Latency.Percentile (0.99);
+    Result.P999      = (double) Latency.Percentile (0.999);
+
+    printf ("sent %lld, delivered %lld in %.2fs\n", (long long) Sent, (long long) Received, Elapsed);
+    printf ("%.0f msg/s, %.2f MB/s\n", Result.Messages, Result.Bytes / (1024 * 1024));
+    printf ("latency p50 %.0fus, p99 %.0fus, p999 %.0fus\n", Result.P50, Result.P99, Result.P999);
+
+    int Status = 0;
+
+    if (Options.SaveBaseline && !WriteBaseline (Options.SaveBaseline, Result))
+    {
+        fprintf (stderr, "Couldn't write %s\n", Options.SaveBaseline);
+        Status = 2;
+    }
+
+    if (Options.Baseline)
+    {
+        double Tolerance = Options.Tolerance / 100;
+
+        printf ("baseline %.0f msg/s, p99 %.0fus\n", Baseline.Messages, Baseline.P99);
+
+        if (Result.Messages < Baseline.Messages * (1 - Tolerance))
+        {
+            printf ("REGRESSION: throughput %.1f%% below baseline\n",
+                        100 * (1 - Result.Messages / Baseline.Messages));
+            Status = 1;
+        }
+
+        if (Baseline.P99 > 0 && Result.P99 > Baseline.P99 * (1 + Tolerance))
+        {
+            printf ("REGRESSION: p99 latency %.1f%% above baseline\n",
+                        100 * (Result.P99 / Baseline.P99 - 1));
+            Status = 1;
+        }
+    }
+
+    /* The clients and pumps are left for the process exit to clean up */
+
+    fflush (stdout);
+    _exit (Status);
+}
+
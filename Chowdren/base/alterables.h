@@ -6,32 +6,76 @@
 #include <string.h>
 #include <string>
 #include <iostream>
+#include <new>
 #include "dynnum.h"
 #include "pool.h"
 
 #define ALT_VALUES 26
 #define ALT_STRINGS 10
 
+// which alterable slots an object type stores. the exporter only gives a slot
+// to the values and strings that events can write to, everything else reads
+// back as the initial value of the type.
+
+struct AlterableLayout
+{
+    int value_count;
+    int string_count;
+    // index -> storage slot, -1 if not stored
+    signed char value_slots[ALT_VALUES];
+    signed char string_slots[ALT_STRINGS];
+    // initial values, NULL if all are 0 or empty
+    const int * values;
+    const std::string * const * strings;
+    SizedPool pool;
+
+    int get_value(size_t index) const
+    {
+        if (values == NULL)
+            return 0;
+        return values[index];
+    }
+
+    const std::string & get_string(size_t index) const
+    {
+        static std::string empty;
+        if (strings == NULL || strings[index] == NULL)
+            return empty;
+        return *strings[index];
+    }
+};
+
+extern AlterableLayout full_alterable_layout;
+
 class AlterableValues
 {
 public:
-    DynamicNumber values[ALT_VALUES];
+    DynamicNumber * values;
+    const AlterableLayout * layout;
 
-    AlterableValues()
+    void init(const AlterableLayout & layout, DynamicNumber * values)
     {
+        this->layout = &layout;
+        this->values = values;
         for (int i = 0; i < ALT_VALUES; i++) {
-            values[i] = 0;
+            int slot = layout.value_slots[i];
+            if (slot < 0)
+                continue;
+            new (&values[slot]) DynamicNumber(layout.get_value(i));
         }
     }
 
-    DynamicNumber get(size_t index)
+    DynamicNumber get(size_t index) const
     {
         if (index >= ALT_VALUES)
             return 0;
-        return values[index];
+        int slot = layout->value_slots[index];
+        if (slot < 0)
+            return layout->get_value(index);
+        return values[slot];
     }
 
-    int get_int(size_t index)
+    int get_int(size_t index) const
     {
         return int(get(index));
     }
@@ -40,7 +84,10 @@ public:
     {
         if (index >= ALT_VALUES)
             return;
-        values[index] = value;
+        int slot = layout->value_slots[index];
+        if (slot < 0)
+            return;
+        values[slot] = value;
     }
 
     void add(size_t index, DynamicNumber value)
@@ -55,39 +102,75 @@ public:
 
     void set(const AlterableValues & v)
     {
-        memcpy(values, v.values, ALT_VALUES*sizeof(DynamicNumber));
+        if (layout == v.layout) {
+            memcpy(values, v.values,
+                   layout->value_count*sizeof(DynamicNumber));
+            return;
+        }
+        for (int i = 0; i < ALT_VALUES; i++) {
+            set(i, v.get(i));
+        }
     }
 };
 
 class AlterableStrings
 {
 public:
-    std::string values[ALT_STRINGS];
+    std::string * values;
+    const AlterableLayout * layout;
 
-    AlterableStrings()
+    void init(const AlterableLayout & layout, std::string * values)
     {
+        this->layout = &layout;
+        this->values = values;
+        for (int i = 0; i < ALT_STRINGS; i++) {
+            int slot = layout.string_slots[i];
+            if (slot < 0)
+                continue;
+            new (&values[slot]) std::string(layout.get_string(i));
+        }
     }
 
-    const std::string & get(size_t index)
+    void destroy()
+    {
+        typedef std::string string_type;
+        for (int i = 0; i < layout->string_count; i++) {
+            values[i].~string_type();
+        }
+    }
+
+    const std::string & get(size_t index) const
     {
         if (index >= ALT_STRINGS) {
             static std::string empty;
             return empty;
         }
-        return values[index];
+        int slot = layout->string_slots[index];
+        if (slot < 0)
+            return layout->get_string(index);
+        return values[slot];
     }
 
     void set(size_t index, const std::string & value)
     {
         if (index >= ALT_STRINGS)
             return;
-        values[index] = value;
+        int slot = layout->string_slots[index];
+        if (slot < 0)
+            return;
+        values[slot] = value;
     }
 
     void set(const AlterableStrings & v)
     {
+        if (layout == v.layout) {
+            for (int i = 0; i < layout->string_count; i++) {
+                values[i] = v.values[i];
+            }
+            return;
+        }
         for (int i = 0; i < ALT_STRINGS; i++) {
-            values[i] = v.values[i];
+            set(i, v.get(i));
         }
     }
 };
@@ -150,6 +233,7 @@ public:
     AlterableStrings strings;
     AlterableValues values;
     AlterableFlags flags;
+    AlterableLayout * layout;
 
     void set(const Alterables & other)
     {
@@ -158,20 +242,34 @@ public:
         flags.set(other.flags);
     }
 
-    static Alterables * create();
+    static Alterables * create(
+        AlterableLayout & layout = full_alterable_layout);
     static void destroy(Alterables * ptr);
 };
 
-extern ObjectPool<Alterables> alterable_pool;
+// the stored values and strings follow the header in the same pool item
+#define ALT_HEADER_SIZE ((sizeof(Alterables) + 7) & ~size_t(7))
 
-inline Alterables * Alterables::create()
+inline Alterables * Alterables::create(AlterableLayout & layout)
 {
-    return new (alterable_pool.create()) Alterables();
+    size_t values_size = layout.value_count * sizeof(DynamicNumber);
+    size_t size = ALT_HEADER_SIZE + values_size
+                  + layout.string_count * sizeof(std::string);
+    unsigned char * data = (unsigned char*)layout.pool.create(size);
+    Alterables * ptr = new (data) Alterables();
+    data += ALT_HEADER_SIZE;
+    ptr->layout = &layout;
+    ptr->values.init(layout, (DynamicNumber*)data);
+    ptr->strings.init(layout, (std::string*)(data + values_size));
+    return ptr;
 }
 
 inline void Alterables::destroy(Alterables * ptr)
 {
-    alterable_pool.destroy(ptr);
+    if (ptr == NULL)
+        return;
+    ptr->strings.destroy();
+    ptr->layout->pool.destroy(ptr);
 }
 
 #endif // ALTERABLES_H
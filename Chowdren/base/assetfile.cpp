@@ -1,7 +1,9 @@
 #include "assetfile.h"
 #include "chowconfig.h"
 #include "datastream.h"
+#include "types.h"
 #include <iostream>
+#include <algorithm>
 
 static bool assets_initialized = false;
 
@@ -9,12 +11,14 @@ static unsigned int image_offsets[IMAGE_ARRAY_SIZE];
 static unsigned int sound_offsets[SOUND_ARRAY_SIZE];
 static unsigned int font_offsets[FONT_ARRAY_SIZE];
 static unsigned int shader_offsets[SHADER_ARRAY_SIZE];
+static unsigned int atlas_offsets[ATLAS_ARRAY_SIZE];
 
 static unsigned int * asset_offsets[] = {
     image_offsets,
     sound_offsets,
     font_offsets,
-    shader_offsets
+    shader_offsets,
+    atlas_offsets
 };
 
 void read_offsets(FileStream & stream, int count, unsigned int * array)
@@ -37,6 +41,7 @@ void init_assets(FSFile & fp)
     read_offsets(stream, SOUND_COUNT, sound_offsets);
     read_offsets(stream, FONT_COUNT, font_offsets);
     read_offsets(stream, SHADER_COUNT, shader_offsets);
+    read_offsets(stream, ATLAS_COUNT, atlas_offsets);
 }
 
 // AssetFile
@@ -49,6 +54,13 @@ AssetFile::AssetFile()
 void AssetFile::open()
 {
     FSFile::open("./Assets.dat", "r");
+
+    // read the offsets up front, so files opened later (possibly on other
+    // threads) never have to
+    if (assets_initialized || !is_open())
+        return;
+    init_assets(*this);
+    seek(0);
 }
 
 void AssetFile::set_item(int index, AssetType type)
@@ -59,3 +71,106 @@ void AssetFile::set_item(int index, AssetType type)
 
     seek(asset_offsets[type][index]);
 }
+
+#ifdef CHOWDREN_ASSET_MAPPING
+
+// asset map
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static const char * map_data = NULL;
+static size_t map_size = 0;
+
+// every asset ends where the next one in the file starts
+static vector<unsigned int> asset_ends;
+
+static bool map_file(const char * filename)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    GetFileSizeEx(file, &size);
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0,
+                                        NULL);
+    CloseHandle(file);
+    if (mapping == NULL)
+        return false;
+    void * data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (data == NULL)
+        return false;
+    map_size = size_t(size.QuadPart);
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1)
+        return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return false;
+    }
+    void * data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return false;
+    map_size = info.st_size;
+#endif
+    map_data = (const char*)data;
+    return true;
+}
+
+void open_asset_map()
+{
+    if (map_data != NULL)
+        return;
+
+    // reads the offset tables
+    AssetFile fp;
+    fp.open();
+
+    if (!map_file("./Assets.dat")) {
+        // no mapping possible, so keep the whole file in memory instead
+        std::cout << "Could not map Assets.dat" << std::endl;
+        map_size = fp.get_size();
+        char * data = new char[map_size];
+        fp.read(data, map_size);
+        map_data = data;
+    }
+
+    for (int i = 0; i < 5; i++) {
+        static const int counts[] = {IMAGE_COUNT, SOUND_COUNT, FONT_COUNT,
+                                     SHADER_COUNT, ATLAS_COUNT};
+        asset_ends.insert(asset_ends.end(), asset_offsets[i],
+                          asset_offsets[i] + counts[i]);
+    }
+    asset_ends.push_back(map_size);
+    std::sort(asset_ends.begin(), asset_ends.end());
+}
+
+AssetView get_asset(int index, AssetFile::AssetType type)
+{
+    open_asset_map();
+    unsigned int offset = asset_offsets[type][index];
+    unsigned int end = *std::upper_bound(asset_ends.begin(),
+                                         asset_ends.end() - 1, offset);
+    AssetView view;
+    view.data = map_data + offset;
+    view.size = end - offset;
+    return view;
+}
+
+#endif
@@ -9,8 +9,13 @@
 #define FONT_ARRAY_SIZE OFFSET_SIZE(FONT_COUNT)
 #define SOUND_ARRAY_SIZE OFFSET_SIZE(SOUND_COUNT)
 #define SHADER_ARRAY_SIZE OFFSET_SIZE(SHADER_COUNT)
+#define ATLAS_ARRAY_SIZE OFFSET_SIZE(ATLAS_COUNT)
 #define INVALID_ASSET_ID ((unsigned int)(-1))
 
+#if defined(CHOWDREN_IS_DESKTOP) && !defined(CHOWDREN_IS_EMSCRIPTEN)
+#define CHOWDREN_ASSET_MAPPING
+#endif
+
 class AssetFile : public FSFile
 {
 public:
@@ -19,7 +24,8 @@ public:
         IMAGE_DATA = 0,
         SOUND_DATA,
         FONT_DATA,
-        SHADER_DATA
+        SHADER_DATA,
+        ATLAS_DATA
     };
 
     AssetFile();
@@ -28,4 +34,20 @@ public:
     void set_item(int index, AssetType type);
 };
 
+#ifdef CHOWDREN_ASSET_MAPPING
+
+// Assets.dat mapped into memory. views point straight into the mapping, stay
+// valid for the lifetime of the process and can be read from any thread.
+
+struct AssetView
+{
+    const char * data;
+    size_t size;
+};
+
+void open_asset_map();
+AssetView get_asset(int index, AssetFile::AssetType type);
+
+#endif
+
 #endif // CHOWDREN_ASSETFILE_H
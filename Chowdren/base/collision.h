@@ -8,6 +8,7 @@
 #include "image.h"
 
 bool collide(CollisionBase * a, CollisionBase * b);
+bool collide(CollisionBase * a, int a_box[4], CollisionBase * b, int b_box[4]);
 
 enum CollisionType
 {
@@ -366,6 +367,24 @@ public:
         return image->get_alpha(x, y);
     }
 
+#ifndef CHOWDREN_IS_WIIU
+    // a NULL mask means every pixel is set. returns false if the
+    // per-pixel path has to be used
+    bool get_mask(const AlphaMask *& mask)
+    {
+        if (flags & HAS_TRANSFORM)
+            return false;
+        if (flags & BOX_COLLISION) {
+            mask = NULL;
+            return true;
+        }
+        if (image->alpha.empty())
+            return false;
+        mask = &image->alpha;
+        return true;
+    }
+#endif
+
     void update_aabb()
     {
         aabb[0] = instance->x - new_hotspot_x;
@@ -400,6 +419,16 @@ public:
     {
         return image->get_alpha(x, y);
     }
+
+#ifndef CHOWDREN_IS_WIIU
+    bool get_mask(const AlphaMask *& mask)
+    {
+        if (image->alpha.empty())
+            return false;
+        mask = &image->alpha;
+        return true;
+    }
+#endif
 };
 
 class PointCollision : public CollisionBase
@@ -435,6 +464,8 @@ public:
     Color color;
     Image * image;
     int collision_type;
+    int proxy;
+    unsigned int paste_index;
 
     unsigned int col;
 
@@ -456,6 +487,16 @@ public:
         return image->get_alpha(x, y);
     }
 
+#ifndef CHOWDREN_IS_WIIU
+    bool get_mask(const AlphaMask *& mask)
+    {
+        if (image->alpha.empty())
+            return false;
+        mask = &image->alpha;
+        return true;
+    }
+#endif
+
     void draw()
     {
         color.apply();
@@ -463,6 +504,37 @@ public:
     }
 };
 
+#ifndef CHOWDREN_IS_WIIU
+
+// word-parallel test for untransformed masks. a NULL mask has every pixel set.
+
+inline uint64_t get_row_bits(int w)
+{
+    if (w >= 64)
+        return ~uint64_t(0);
+    return (uint64_t(1) << w) - 1;
+}
+
+inline bool collide_mask_mask(const AlphaMask * a, const AlphaMask * b,
+                              int w, int h, int offx1, int offy1,
+                              int offx2, int offy2)
+{
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x += 64) {
+            uint64_t bits = get_row_bits(w - x);
+            if (a != NULL)
+                bits &= a->get_bits(offx1 + x, offy1 + y);
+            if (b != NULL)
+                bits &= b->get_bits(offx2 + x, offy2 + y);
+            if (bits != 0)
+                return true;
+        }
+    }
+    return false;
+}
+
+#endif
+
 inline bool collide_sprite_background(CollisionBase * a, CollisionBase * b,
                                       int w, int h, int offx1, int offy1,
                                       int offx2, int offy2)
@@ -472,6 +544,15 @@ inline bool collide_sprite_background(CollisionBase * a, CollisionBase * b,
     offx2 += ((BackgroundItem*)b)->src_x;
     offy2 += ((BackgroundItem*)b)->src_y;
 
+#ifndef CHOWDREN_IS_WIIU
+    const AlphaMask * mask1;
+    const AlphaMask * mask2;
+    if (((SpriteCollision*)a)->get_mask(mask1) &&
+        ((BackgroundItem*)b)->get_mask(mask2))
+        return collide_mask_mask(mask1, mask2, w, h, offx1, offy1,
+                                 offx2, offy2);
+#endif
+
     for (int y = 0; y < h; y++) {
         for (int x = 0; x < w; x++) {
             bool c1 = ((SpriteCollision*)a)->get_bit(offx1 + x, offy1 + y);
@@ -489,6 +570,12 @@ inline bool collide_background_box(CollisionBase * a, int w, int h,
     offx += ((BackgroundItem*)a)->src_x;
     offy += ((BackgroundItem*)a)->src_y;
 
+#ifndef CHOWDREN_IS_WIIU
+    const AlphaMask * mask;
+    if (((BackgroundItem*)a)->get_mask(mask))
+        return collide_mask_mask(mask, NULL, w, h, offx, offy, 0, 0);
+#endif
+
     for (int y = 0; y < h; y++) {
         for (int x = 0; x < w; x++) {
             if (((BackgroundItem*)a)->get_bit(offx + x, offy + y))
@@ -501,6 +588,12 @@ inline bool collide_background_box(CollisionBase * a, int w, int h,
 inline bool collide_backdrop_box(CollisionBase * a, int w, int h,
                                  int offx, int offy)
 {
+#ifndef CHOWDREN_IS_WIIU
+    const AlphaMask * mask;
+    if (((BackdropCollision*)a)->get_mask(mask))
+        return collide_mask_mask(mask, NULL, w, h, offx, offy, 0, 0);
+#endif
+
     for (int y = 0; y < h; y++) {
         for (int x = 0; x < w; x++) {
             if (((BackdropCollision*)a)->get_bit(offx + x, offy + y))
@@ -516,6 +609,12 @@ inline bool collide_sprite_box(CollisionBase * a, int w, int h,
     offx += ((SpriteCollision*)a)->x_t;
     offy += ((SpriteCollision*)a)->y_t;
 
+#ifndef CHOWDREN_IS_WIIU
+    const AlphaMask * mask;
+    if (((SpriteCollision*)a)->get_mask(mask))
+        return collide_mask_mask(mask, NULL, w, h, offx, offy, 0, 0);
+#endif
+
     for (int y = 0; y < h; y++) {
         for (int x = 0; x < w; x++) {
             if (((SpriteCollision*)a)->get_bit(offx + x, offy + y))
@@ -534,6 +633,15 @@ inline bool collide_sprite_sprite(CollisionBase * a, CollisionBase * b,
     offx2 += ((SpriteCollision*)b)->x_t;
     offy2 += ((SpriteCollision*)b)->y_t;
 
+#ifndef CHOWDREN_IS_WIIU
+    const AlphaMask * mask1;
+    const AlphaMask * mask2;
+    if (((SpriteCollision*)a)->get_mask(mask1) &&
+        ((SpriteCollision*)b)->get_mask(mask2))
+        return collide_mask_mask(mask1, mask2, w, h, offx1, offy1,
+                                 offx2, offy2);
+#endif
+
     for (int y = 0; y < h; y++) {
         for (int x = 0; x < w; x++) {
             bool c1 = ((SpriteCollision*)a)->get_bit(offx1 + x, offy1 + y);
@@ -552,6 +660,15 @@ inline bool collide_sprite_backdrop(CollisionBase * a, CollisionBase * b,
     offx1 += ((SpriteCollision*)a)->x_t;
     offy1 += ((SpriteCollision*)a)->y_t;
 
+#ifndef CHOWDREN_IS_WIIU
+    const AlphaMask * mask1;
+    const AlphaMask * mask2;
+    if (((SpriteCollision*)a)->get_mask(mask1) &&
+        ((BackdropCollision*)b)->get_mask(mask2))
+        return collide_mask_mask(mask1, mask2, w, h, offx1, offy1,
+                                 offx2, offy2);
+#endif
+
     for (int y = 0; y < h; y++) {
         for (int x = 0; x < w; x++) {
             bool c1 = ((SpriteCollision*)a)->get_bit(offx1 + x, offy1 + y);
@@ -563,9 +680,14 @@ inline bool collide_sprite_backdrop(CollisionBase * a, CollisionBase * b,
     return false;
 }
 
-inline bool collide(CollisionBase * a, CollisionBase * b)
+// collides the shapes as if they were at a_box and b_box instead of their
+// own aabbs. only the box position is used, so a probe box must have the
+// same size as the shape's aabb.
+
+inline bool collide(CollisionBase * a, int a_box[4],
+                    CollisionBase * b, int b_box[4])
 {
-    if (!collides(a->aabb, b->aabb))
+    if (!collides(a_box, b_box))
         return false;
 
     if ((a->flags & BOX_COLLISION) && (b->flags & BOX_COLLISION))
@@ -573,15 +695,15 @@ inline bool collide(CollisionBase * a, CollisionBase * b)
 
     // calculate the overlapping area
     int x1, y1, x2, y2;
-    intersect(a->aabb[0], a->aabb[1], a->aabb[2], a->aabb[3],
-              b->aabb[0], b->aabb[1], b->aabb[2], b->aabb[3],
+    intersect(a_box[0], a_box[1], a_box[2], a_box[3],
+              b_box[0], b_box[1], b_box[2], b_box[3],
               x1, y1, x2, y2);
 
     // figure out the offsets of the overlapping area in each
-    int offx1 = x1 - a->aabb[0];
-    int offy1 = y1 - a->aabb[1];
-    int offx2 = x1 - b->aabb[0];
-    int offy2 = y1 - b->aabb[1];
+    int offx1 = x1 - a_box[0];
+    int offy1 = y1 - a_box[1];
+    int offx2 = x1 - b_box[0];
+    int offy2 = y1 - b_box[1];
 
     int w = x2 - x1;
     int h = y2 - y1;
@@ -632,6 +754,19 @@ inline bool collide(CollisionBase * a, CollisionBase * b)
     }
 }
 
+inline bool collide(CollisionBase * a, CollisionBase * b)
+{
+    return collide(a, a->aabb, b, b->aabb);
+}
+
+inline void offset_box(int box[4], int dx, int dy, int out[4])
+{
+    out[0] = box[0] + dx;
+    out[1] = box[1] + dy;
+    out[2] = box[2] + dx;
+    out[3] = box[3] + dy;
+}
+
 inline bool collide_box(FrameObject * a, int v[4])
 {
     CollisionBase * col = a->collision;
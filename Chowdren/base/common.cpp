@@ -7,6 +7,7 @@
 #include <iomanip>
 #include "md5.h"
 #include "intern.cpp"
+#include "altlayout.cpp"
 
 #ifdef CHOWDREN_USE_VALUEADD
 #include "extra_keys.cpp"
@@ -71,14 +72,18 @@ Font::Font(const char * face, int size, bool bold, bool italic, bool underline)
 // Background
 
 Background::Background()
+: paste_index(0)
 {
+    broadphase.init();
+    col_broadphase.init();
 }
 
-void clear_back_vec(BackgroundItems & items)
+void Background::clear_items(BackgroundItems & items, Broadphase & broadphase)
 {
     BackgroundItems::iterator it;
     for (it = items.begin(); it != items.end(); ++it) {
         BackgroundItem * item = *it;
+        broadphase.remove(item->proxy);
         delete item;
     }
     items.clear();
@@ -86,45 +91,80 @@ void clear_back_vec(BackgroundItems & items)
 
 Background::~Background()
 {
-    clear_back_vec(col_items);
-    clear_back_vec(items);
+    clear_items(col_items, col_broadphase);
+    clear_items(items, broadphase);
 }
 
 void Background::reset(bool clear_items)
 {
     if (clear_items) {
-        clear_back_vec(col_items);
-        clear_back_vec(items);
+        this->clear_items(col_items, col_broadphase);
+        this->clear_items(items, broadphase);
+        paste_index = 0;
     }
 }
 
-void Background::destroy_at(int x, int y)
+struct PasteQueryCallback
 {
-    BackgroundItems::iterator it = items.begin();
-    while (it != items.end()) {
+    BackgroundItems & list;
+    int * aabb;
+
+    PasteQueryCallback(BackgroundItems & list, int v[4])
+    : list(list), aabb(v)
+    {
+    }
+
+    bool on_callback(void * data)
+    {
+        BackgroundItem * item = (BackgroundItem*)data;
+        if (!collides(item->aabb, aabb))
+            return true;
+        list.push_back(item);
+        return true;
+    }
+};
+
+inline void remove_destroyed(BackgroundItems & items)
+{
+    BackgroundItems::iterator it, dst;
+    dst = items.begin();
+    for (it = items.begin(); it != items.end(); ++it) {
         BackgroundItem * item = *it;
-        if (collides(item->dest_x, item->dest_y,
-                     item->dest_x + item->src_width,
-                     item->dest_y + item->src_height,
-                     x, y, x+1, y+1)) {
+        if (item->proxy == -1) {
             delete item;
-            it = items.erase(it);
-        } else {
-            ++it;
+            continue;
         }
+        *dst = item;
+        ++dst;
     }
-    it = col_items.begin();
-    while (it != col_items.end()) {
+    items.erase(dst, items.end());
+}
+
+static void destroy_items(BackgroundItems & items, Broadphase & broadphase,
+                          int v[4])
+{
+    static BackgroundItems hits;
+    hits.clear();
+    PasteQueryCallback callback(hits, v);
+    broadphase.query(v, callback);
+    if (hits.empty())
+        return;
+
+    // removed from the item list in a single pass afterwards
+    BackgroundItems::const_iterator it;
+    for (it = hits.begin(); it != hits.end(); ++it) {
         BackgroundItem * item = *it;
-        if (collides(item->dest_x, item->dest_y,
-                     item->dest_x + item->src_width,
-                     item->dest_y + item->src_height,
-                     x, y, x+1, y+1)) {
-            delete item;
-            it = col_items.erase(it);
-        } else
-            ++it;
+        broadphase.remove(item->proxy);
+        item->proxy = -1;
     }
+    remove_destroyed(items);
+}
+
+void Background::destroy_at(int x, int y)
+{
+    int v[4] = {x, y, x + 1, y + 1};
+    destroy_items(items, broadphase, v);
+    destroy_items(col_items, col_broadphase, v);
 }
 
 void Background::paste(Image * img, int dest_x, int dest_y,
@@ -141,11 +181,14 @@ void Background::paste(Image * img, int dest_x, int dest_y,
     if (src_width <= 0 || src_height <= 0)
         return;
 
+    BackgroundItem * item;
+
     if (collision_type == 1) {
-        col_items.push_back(new BackgroundItem(img, dest_x, dest_y,
-                                               src_x, src_y,
-                                               src_width, src_height,
-                                               collision_type, color));
+        item = new BackgroundItem(img, dest_x, dest_y, src_x, src_y,
+                                  src_width, src_height, collision_type,
+                                  color);
+        item->proxy = col_broadphase.add(item, item->aabb);
+        col_items.push_back(item);
 #ifndef CHOWDREN_OBSTACLE_IMAGE
         return;
 #endif
@@ -154,32 +197,68 @@ void Background::paste(Image * img, int dest_x, int dest_y,
     if (color.a == 0 || color.a == 1)
         return;
 
-    items.push_back(new BackgroundItem(img, dest_x, dest_y,
-                                       src_x, src_y,
-                                       src_width, src_height,
-                                       collision_type, color));
+    item = new BackgroundItem(img, dest_x, dest_y, src_x, src_y,
+                              src_width, src_height, collision_type, color);
+    item->proxy = broadphase.add(item, item->aabb);
+    item->paste_index = paste_index++;
+    items.push_back(item);
+}
+
+inline bool sort_paste_comp(BackgroundItem * item1, BackgroundItem * item2)
+{
+    return item1->paste_index < item2->paste_index;
 }
 
 void Background::draw(int v[4])
 {
+    // the grid does not keep paste order, so restore it for the visible
+    // items
+    static BackgroundItems draw_list;
+    draw_list.clear();
+    PasteQueryCallback callback(draw_list, v);
+    broadphase.query(v, callback);
+
+    std::sort(draw_list.begin(), draw_list.end(), sort_paste_comp);
+
     BackgroundItems::const_iterator it;
-    for (it = items.begin(); it != items.end(); ++it) {
+    for (it = draw_list.begin(); it != draw_list.end(); ++it) {
         BackgroundItem * item = *it;
-        if (!collides(item->aabb, v))
-            continue;
         item->draw();
     }
 }
 
-CollisionBase * Background::collide(CollisionBase * a)
+struct PasteCollisionCallback
 {
-    BackgroundItems::iterator it;
-    for (it = col_items.begin(); it != col_items.end(); ++it) {
-        BackgroundItem * item = *it;
-        if (::collide(a, item))
-            return item;
+    CollisionBase * col;
+    int * box;
+    BackgroundItem * other;
+
+    PasteCollisionCallback(CollisionBase * col, int * box)
+    : col(col), box(box)
+    {
     }
-    return NULL;
+
+    bool on_callback(void * data)
+    {
+        BackgroundItem * item = (BackgroundItem*)data;
+        if (!::collide(col, box, item, item->aabb))
+            return true;
+        other = item;
+        return false;
+    }
+};
+
+CollisionBase * Background::collide(CollisionBase * a)
+{
+    return collide(a, a->aabb);
+}
+
+CollisionBase * Background::collide(CollisionBase * a, int box[4])
+{
+    PasteCollisionCallback callback(a, box);
+    if (col_broadphase.query(box, callback))
+        return NULL;
+    return callback.other;
 }
 
 // Layer
@@ -214,6 +293,7 @@ void Layer::reset()
     x = y = 0;
     off_x = off_y = 0;
     back = NULL;
+    levels_dirty = true;
 
 #ifdef CHOWDREN_IS_3DS
     depth = 0.0f;
@@ -368,6 +448,7 @@ inline unsigned int sub_depth(unsigned int start, unsigned int sub,
 
 void Layer::add_object(FrameObject * instance)
 {
+    levels_dirty = true;
     bool reset = false;
     if (instances.empty())
         instance->depth = LAYER_DEPTH_START;
@@ -388,6 +469,7 @@ void Layer::add_object(FrameObject * instance)
 
 void Layer::insert_object(FrameObject * instance, int index)
 {
+    levels_dirty = true;
     bool reset = false;
 
     if (index == 0) {
@@ -427,6 +509,7 @@ void Layer::insert_object(FrameObject * instance, int index)
 
 void Layer::reset_depth()
 {
+    levels_dirty = true;
     LayerInstances::iterator it;
     unsigned int i = LAYER_DEPTH_START;
     for (it = instances.begin(); it != instances.end(); ++it) {
@@ -437,6 +520,7 @@ void Layer::reset_depth()
 
 void Layer::remove_object(FrameObject * instance)
 {
+    levels_dirty = true;
     instances.erase(LayerInstances::s_iterator_to(*instance));
 }
 
@@ -453,14 +537,25 @@ void Layer::set_level(FrameObject * instance, int new_index)
 
 int Layer::get_level(FrameObject * instance)
 {
-    LayerInstances::const_iterator it;
-    int i = 0;
-    for (it = instances.begin(); it != instances.end(); ++it) {
-        if (&*it == instance)
-            return i;
-        i++;
+    if (instance->layer != this || (instance->flags & BACKGROUND))
+        return -1;
+
+    // the instance list is kept in depth order, so the level is the number
+    // of depths below this one. the depths are only collected again after
+    // the list has changed, so repeated queries are a binary search.
+    if (levels_dirty) {
+        levels_dirty = false;
+        levels.clear();
+        LayerInstances::const_iterator it;
+        for (it = instances.begin(); it != instances.end(); ++it)
+            levels.push_back(it->depth);
     }
-    return -1;
+
+    vector<unsigned int>::const_iterator it;
+    it = std::lower_bound(levels.begin(), levels.end(), instance->depth);
+    if (it == levels.end() || *it != instance->depth)
+        return -1;
+    return it - levels.begin();
 }
 
 void Layer::destroy_backgrounds()
@@ -535,6 +630,13 @@ void Layer::paste(Image * img, int dest_x, int dest_y,
                 src_width, src_height, collision_type, color);
 }
 
+inline bool is_drawable(FrameObject * item, int v[4])
+{
+    if (!(item->flags & VISIBLE) || item->flags & DESTROYING)
+        return false;
+    return collide_box(item, v);
+}
+
 struct DrawCallback
 {
     FlatObjectList & list;
@@ -548,27 +650,32 @@ struct DrawCallback
     bool on_callback(void * data)
     {
         FrameObject * item = (FrameObject*)data;
-        if (!(item->flags & VISIBLE) || item->flags & DESTROYING)
-            return true;
-        if (!collide_box(item, aabb))
+        if (!is_drawable(item, aabb))
             return true;
         list.push_back(item);
         return true;
     }
 };
 
+inline bool is_background(FrameObject * obj)
+{
+    return (obj->flags & BACKGROUND) != 0;
+}
+
 inline bool sort_depth_comp(FrameObject * obj1, FrameObject * obj2)
 {
-    if (obj1->flags & BACKGROUND && !(obj2->flags & BACKGROUND))
-        return true;
-    if (obj2->flags & BACKGROUND && !(obj1->flags & BACKGROUND))
-        return false;
     return obj1->depth < obj2->depth;
 }
 
-inline void sort_depth(FlatObjectList & list)
+// sorting the k visible items costs about k * log2(k) comparisons, while
+// walking the depth-ordered list of n items costs n cheap AABB tests
+
+inline bool use_depth_sort(unsigned int k, unsigned int n)
 {
-    std::sort(list.begin(), list.end(), sort_depth_comp);
+    unsigned int cost = 0;
+    for (unsigned int i = k; i > 1; i >>= 1)
+        cost += k;
+    return cost < n;
 }
 
 void Layer::draw(int off_x, int off_y)
@@ -609,14 +716,28 @@ void Layer::draw(int off_x, int off_y)
     DrawCallback callback(draw_list, v);
     broadphase.query(v, callback);
 
-    sort_depth(draw_list);
+    // backgrounds and instances are both kept in depth order already. if
+    // only a few of them are visible, the query results are sorted, and
+    // otherwise the ordered lists are walked and culled directly.
+    FlatObjectList::iterator middle = std::partition(draw_list.begin(),
+                                                     draw_list.end(),
+                                                     is_background);
 
-    FlatObjectList::const_iterator it;
-    for (it = draw_list.begin(); it != draw_list.end(); ++it) {
-        FrameObject * obj = *it;
-        if (!(obj->flags & BACKGROUND))
-            break;
-        obj->draw();
+    FlatObjectList::iterator it;
+    if (use_depth_sort(middle - draw_list.begin(),
+                       background_instances.size()))
+    {
+        std::sort(draw_list.begin(), middle, sort_depth_comp);
+        for (it = draw_list.begin(); it != middle; ++it)
+            (*it)->draw();
+    } else {
+        for (it = background_instances.begin();
+             it != background_instances.end(); ++it) {
+            FrameObject * obj = *it;
+            if (!is_drawable(obj, v))
+                continue;
+            obj->draw();
+        }
     }
 
     PROFILE_BEGIN(Layer_draw_pasted);
@@ -627,8 +748,19 @@ void Layer::draw(int off_x, int off_y)
 
     PROFILE_END();
 
-    for (; it != draw_list.end(); ++it) {
-        (*it)->draw();
+    if (use_depth_sort(draw_list.end() - middle, instances.size())) {
+        std::sort(middle, draw_list.end(), sort_depth_comp);
+        for (it = middle; it != draw_list.end(); ++it)
+            (*it)->draw();
+    } else {
+        LayerInstances::iterator it2;
+        for (it2 = instances.begin(); it2 != instances.end(); ++it2) {
+            FrameObject * obj = &*it2;
+            // only instances with a collision proxy are found by the query
+            if (obj->collision == NULL || !is_drawable(obj, v))
+                continue;
+            obj->draw();
+        }
     }
 
     PROFILE_END();
@@ -861,6 +993,17 @@ void Frame::clean_instances()
          ++it) {
         FrameObject * instance = *it;
         INSTANCE_MAP.items[instance->id].remove(instance);
+    }
+
+    // close the holes before any destructor gets to see the lists
+    for (it = destroyed_instances.begin(); it != destroyed_instances.end();
+         ++it) {
+        INSTANCE_MAP.items[(*it)->id].compact();
+    }
+
+    for (it = destroyed_instances.begin(); it != destroyed_instances.end();
+         ++it) {
+        FrameObject * instance = *it;
         if (instance->flags & BACKGROUND)
             instance->layer->remove_background_object(instance);
         else
@@ -1069,7 +1212,8 @@ void Frame::reset()
 
 FrameObject::FrameObject(int x, int y, int type_id)
 : x(x), y(y), id(type_id), flags(SCROLL | VISIBLE), shader(NULL),
-  alterables(NULL), shader_parameters(NULL), direction(0),
+  alterables(NULL), shader_parameters(NULL), extra_shader_parameters(NULL),
+  direction(0),
   movement(NULL), movements(NULL), movement_count(0), collision(NULL)
 {
 #ifdef CHOWDREN_USE_BOX2D
@@ -1092,7 +1236,8 @@ FrameObject::~FrameObject()
         }
         delete[] movements;
     }
-    delete shader_parameters;
+    delete[] shader_parameters;
+    delete extra_shader_parameters;
     if (!(flags & GLOBAL))
         Alterables::destroy(alterables);
 #ifdef CHOWDREN_USE_VALUEADD
@@ -1108,6 +1253,9 @@ void FrameObject::draw_image(Image * img, int x, int y, float angle,
     bool has_tex_param = false;
 
     if (shader != NULL) {
+        // shaders sample around the image, so give them a texture of its own
+        if (shader != additive_shader)
+            img->unpack_atlas();
         shader->begin(this, img);
         back_tex = shader->get_background_texture();
         has_tex_param = shader->has_texture_param();
@@ -1194,9 +1342,9 @@ void FrameObject::set_y(int new_y)
     collision->update_proxy();
 }
 
-void FrameObject::create_alterables()
+void FrameObject::create_alterables(AlterableLayout & layout)
 {
-    alterables = Alterables::create();
+    alterables = Alterables::create(layout);
 }
 
 void FrameObject::set_visible(bool value)
@@ -1247,6 +1395,23 @@ bool FrameObject::mouse_over()
     return collide(&col1, collision);
 }
 
+bool FrameObject::overlaps(FrameObject * other, int dx, int dy)
+{
+    if (flags & INACTIVE || other->flags & INACTIVE)
+        return false;
+    if (other == this)
+        return false;
+    if (collision->type == NONE_COLLISION)
+        return false;
+    if (other->collision->type == NONE_COLLISION)
+        return false;
+    if (other->layer != layer)
+        return false;
+    int box[4];
+    offset_box(collision->aabb, dx, dy, box);
+    return collide(collision, box, other->collision, other->collision->aabb);
+}
+
 bool FrameObject::overlaps(FrameObject * other)
 {
     if (flags & INACTIVE || other->flags & INACTIVE)
@@ -1265,9 +1430,10 @@ bool FrameObject::overlaps(FrameObject * other)
 struct BackgroundOverlapCallback
 {
     CollisionBase * collision;
+    int * box;
 
-    BackgroundOverlapCallback(CollisionBase * collision)
-    : collision(collision)
+    BackgroundOverlapCallback(CollisionBase * collision, int * box)
+    : collision(collision), box(box)
     {
     }
 
@@ -1281,7 +1447,7 @@ struct BackgroundOverlapCallback
             return true;
         if (other->flags & LADDER_OBSTACLE)
             return true;
-        if (!collide(collision, other))
+        if (!collide(collision, box, other, other->aabb))
             return true;
         return false;
     }
@@ -1298,7 +1464,7 @@ bool FrameObject::overlaps_background()
         flags |= HAS_COLLISION;
         return true;
     }
-    BackgroundOverlapCallback callback(collision);
+    BackgroundOverlapCallback callback(collision, collision->aabb);
     if (!layer->broadphase.query_static(collision->proxy, callback)) {
         flags |= HAS_COLLISION;
         return true;
@@ -1306,6 +1472,21 @@ bool FrameObject::overlaps_background()
     return false;
 }
 
+// the probes below test the instance as if it was moved by (dx, dy), without
+// touching its position, the collision cache or the broadphase
+
+bool FrameObject::overlaps_background(int dx, int dy)
+{
+    if (flags & DESTROYING || collision == NULL)
+        return false;
+    int box[4];
+    offset_box(collision->aabb, dx, dy, box);
+    if (layer->back != NULL && layer->back->collide(collision, box))
+        return true;
+    BackgroundOverlapCallback callback(collision, box);
+    return !layer->broadphase.query_static(box, callback);
+}
+
 bool FrameObject::overlaps_background_save()
 {
     bool ret = overlaps_background();
@@ -1373,22 +1554,65 @@ int FrameObject::get_box_index(int index)
     return ret;
 }
 
+static double * create_shader_parameters()
+{
+    double * values = new double[SHADER_PARAMETER_COUNT];
+    for (int i = 0; i < SHADER_PARAMETER_COUNT; i++)
+        values[i] = 0.0;
+    return values;
+}
+
 void FrameObject::set_shader(Shader * value)
 {
     if (shader_parameters == NULL)
-        shader_parameters = new ShaderParameters;
+        shader_parameters = create_shader_parameters();
     shader = value;
 }
 
-void FrameObject::set_shader_parameter(const std::string & name, double value)
+void FrameObject::set_shader_parameter(int slot, double value)
 {
+    if (slot < 0)
+        return;
     if (shader_parameters == NULL)
-        shader_parameters = new ShaderParameters;
-    (*shader_parameters)[name] = value;
+        shader_parameters = create_shader_parameters();
+    shader_parameters[slot] = value;
+}
+
+void FrameObject::set_shader_parameter(int slot, Image & img)
+{
+    img.unpack_atlas();
+    img.upload_texture();
+    set_shader_parameter(slot, (double)img.tex);
+}
+
+void FrameObject::set_shader_parameter(int slot, const std::string & path)
+{
+    Image * img = get_image_cache(path, 0, 0, 0, 0, TransparentColor());
+    set_shader_parameter(slot, *img);
+}
+
+void FrameObject::set_shader_parameter(int slot, const Color & color)
+{
+    set_shader_parameter(slot, (double)color.get_int());
+}
+
+void FrameObject::set_shader_parameter(const std::string & name, double value)
+{
+    int slot = get_shader_parameter_slot(name);
+    if (slot >= 0) {
+        set_shader_parameter(slot, value);
+        return;
+    }
+    // a name built at runtime. no shader reads it, but the EffectParameter
+    // expression can
+    if (extra_shader_parameters == NULL)
+        extra_shader_parameters = new ShaderParameters;
+    (*extra_shader_parameters)[name] = value;
 }
 
 void FrameObject::set_shader_parameter(const std::string & name, Image & img)
 {
+    img.unpack_atlas();
     img.upload_texture();
     set_shader_parameter(name, (double)img.tex);
 }
@@ -1406,11 +1630,24 @@ void FrameObject::set_shader_parameter(const std::string & name,
     set_shader_parameter(name, (double)color.get_int());
 }
 
+double FrameObject::get_shader_parameter(int slot)
+{
+    if (shader_parameters == NULL || slot < 0)
+        return 0.0;
+    return shader_parameters[slot];
+}
+
 double FrameObject::get_shader_parameter(const std::string & name)
 {
-    if (shader_parameters == NULL)
+    int slot = get_shader_parameter_slot(name);
+    if (slot >= 0)
+        return get_shader_parameter(slot);
+    if (extra_shader_parameters == NULL)
+        return 0.0;
+    ShaderParameters::const_iterator it = extra_shader_parameters->find(name);
+    if (it == extra_shader_parameters->end())
         return 0.0;
-    return (*shader_parameters)[name];
+    return it->second;
 }
 
 void FrameObject::destroy()
@@ -1505,6 +1742,7 @@ void FrameObject::move_back(FrameObject * other)
 
     layer->instances.erase(LayerInstances::s_iterator_to(*this));
     layer->instances.insert(it, *this);
+    layer->levels_dirty = true;
 
     if (reset) {
 #ifndef NDEBUG
@@ -1541,6 +1779,7 @@ void FrameObject::move_front(FrameObject * other)
 
     layer->instances.erase(LayerInstances::s_iterator_to(*this));
     layer->instances.insert(it, *this);
+    layer->levels_dirty = true;
 
     if (reset) {
 #ifndef NDEBUG
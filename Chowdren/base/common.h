@@ -35,6 +35,7 @@
 #include "input.h"
 #include "movement.h"
 #include "intern.h"
+#include "altlayout.h"
 
 extern std::string newline_character;
 // string helpers
@@ -262,6 +263,212 @@ inline bool check_overlap(FrameObject * obj1, FrameObject * obj2)
     return true;
 }
 
+// broadphase overlap
+
+/*
+For larger selections, the list vs list tests below query the layer
+broadphase with every instance of the smaller side instead of testing every
+pair. int_temp holds one entry per instance of both sides, where the outer
+side starts at offset 0 and the inner side at outer.size:
+
+* OVERLAP_NONE, not selected (or selected without collision)
+* OVERLAP_CANDIDATE, selected in the side that is looked up
+* OVERLAP_HIT, overlaps at least one instance of the other side
+*/
+
+#ifndef CHOWDREN_OVERLAP_BROADPHASE_MIN
+#define CHOWDREN_OVERLAP_BROADPHASE_MIN 64
+#endif
+
+enum OverlapState
+{
+    OVERLAP_NONE = 0,
+    OVERLAP_CANDIDATE,
+    OVERLAP_HIT
+};
+
+class OverlapSet
+{
+public:
+    ObjectList ** lists;
+    int count;
+    int offset;
+    int size;
+
+    OverlapSet(ObjectList ** lists, int count)
+    : lists(lists), count(count), offset(0), size(0)
+    {
+        for (int i = 0; i < count; i++)
+            size += lists[i]->size();
+    }
+
+    bool has_proxies()
+    {
+        for (int i = 0; i < count; i++) {
+            for (ObjectIterator it(*lists[i]); !it.end(); ++it) {
+                InstanceCollision * col = (*it)->collision;
+                if (col != NULL && col->proxy == -1)
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    bool has_collision()
+    {
+        for (int i = 0; i < count; i++) {
+            for (ObjectIterator it(*lists[i]); !it.end(); ++it) {
+                if ((*it)->collision != NULL)
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    int find(FrameObject * obj)
+    {
+        int temp_offset = offset;
+        for (int i = 0; i < count; i++) {
+            ObjectList & list = *lists[i];
+            int size = list.size();
+            if (size > 0 && list.items[1].obj->id == obj->id) {
+                int index = obj->index;
+                if (index <= 0 || index > size || list.items[index].obj != obj)
+                    return -1;
+                return temp_offset + index - 1;
+            }
+            temp_offset += size;
+        }
+        return -1;
+    }
+
+    void mark_candidates()
+    {
+        int temp_offset = offset;
+        for (int i = 0; i < count; i++) {
+            ObjectList & list = *lists[i];
+            for (ObjectIterator it(list); !it.end(); ++it) {
+                if ((*it)->collision == NULL)
+                    continue;
+                int_temp[temp_offset + it.index - 1] = OVERLAP_CANDIDATE;
+            }
+            temp_offset += list.size();
+        }
+    }
+
+    void deselect_missed()
+    {
+        int temp_offset = offset;
+        for (int i = 0; i < count; i++) {
+            ObjectList & list = *lists[i];
+            for (ObjectIterator it(list); !it.end(); ++it) {
+                if (int_temp[temp_offset + it.index - 1] != OVERLAP_HIT)
+                    it.deselect();
+            }
+            temp_offset += list.size();
+        }
+    }
+
+    void deselect_no_collision()
+    {
+        for (int i = 0; i < count; i++) {
+            for (ObjectIterator it(*lists[i]); !it.end(); ++it) {
+                if ((*it)->collision == NULL)
+                    it.deselect();
+            }
+        }
+    }
+
+    void empty_selection()
+    {
+        for (int i = 0; i < count; i++)
+            lists[i]->empty_selection();
+    }
+};
+
+template <bool save>
+struct OverlapCallback
+{
+    FrameObject * instance;
+    OverlapSet & other;
+    bool added;
+
+    OverlapCallback(FrameObject * instance, OverlapSet & other)
+    : instance(instance), other(other), added(false)
+    {
+    }
+
+    bool on_callback(void * data)
+    {
+        FrameObject * obj = (FrameObject*)data;
+        int slot = other.find(obj);
+        if (slot == -1 || int_temp[slot] == OVERLAP_NONE)
+            return true;
+        if (!check_overlap<save>(instance, obj))
+            return true;
+        int_temp[slot] = OVERLAP_HIT;
+        added = true;
+        return true;
+    }
+};
+
+// returns false if the broadphase cannot be used for these sets, in which
+// case the caller should fall back to testing every pair
+
+template <bool save>
+inline bool check_overlap_broadphase(OverlapSet & outer, OverlapSet & inner,
+                                     bool & ret)
+{
+    if (int64_t(outer.size) * inner.size < CHOWDREN_OVERLAP_BROADPHASE_MIN)
+        return false;
+
+    // query with the smaller set, look up candidates in the bigger one
+    OverlapSet * query_set = &outer;
+    OverlapSet * other_set = &inner;
+    if (inner.size < outer.size)
+        std::swap(query_set, other_set);
+
+    if (!other_set->has_proxies())
+        return false;
+
+    outer.offset = 0;
+    inner.offset = outer.size;
+    int_temp.resize(outer.size + inner.size);
+    std::fill(int_temp.begin(), int_temp.end(), 0);
+    other_set->mark_candidates();
+
+    ret = false;
+    int temp_offset = query_set->offset;
+    for (int i = 0; i < query_set->count; i++) {
+        ObjectList & list = *query_set->lists[i];
+        for (ObjectIterator it(list); !it.end(); ++it) {
+            FrameObject * instance = *it;
+            InstanceCollision * col = instance->collision;
+            if (col == NULL)
+                continue;
+            OverlapCallback<save> callback(instance, *other_set);
+            instance->layer->broadphase.query(col->aabb, callback);
+            if (!callback.added)
+                continue;
+            int_temp[temp_offset + it.index - 1] = OVERLAP_HIT;
+            ret = true;
+        }
+        temp_offset += list.size();
+    }
+
+    if (!ret) {
+        // same selection as the pairwise test leaves behind
+        if (outer.has_collision())
+            inner.deselect_no_collision();
+        outer.empty_selection();
+        return true;
+    }
+
+    outer.deselect_missed();
+    inner.deselect_missed();
+    return true;
+}
+
 // ObjectList vs ObjectList
 
 template <bool save>
@@ -270,6 +477,15 @@ inline bool check_overlap(ObjectList & list1, ObjectList & list2)
     int size = list2.size();
     if (size <= 0)
         return false;
+
+    ObjectList * outer_lists[1] = {&list1};
+    ObjectList * inner_lists[1] = {&list2};
+    OverlapSet outer(outer_lists, 1);
+    OverlapSet inner(inner_lists, 1);
+    bool broadphase_ret;
+    if (check_overlap_broadphase<save>(outer, inner, broadphase_ret))
+        return broadphase_ret;
+
     int_temp.resize(size);
     std::fill(int_temp.begin(), int_temp.end(), 0);
 
@@ -352,6 +568,14 @@ inline bool check_overlap(QualifierList & list1, ObjectList & list2)
     int size = list1.size();
     if (size <= 0)
         return false;
+
+    ObjectList * outer_lists[1] = {&list2};
+    OverlapSet outer(outer_lists, 1);
+    OverlapSet inner(list1.items, list1.count);
+    bool broadphase_ret;
+    if (check_overlap_broadphase<save>(outer, inner, broadphase_ret))
+        return broadphase_ret;
+
     int_temp.resize(size);
     std::fill(int_temp.begin(), int_temp.end(), 0);
 
@@ -456,6 +680,13 @@ inline bool check_overlap(QualifierList & list1, QualifierList & list2)
     int size = list1.size();
     if (size <= 0)
         return false;
+
+    OverlapSet outer(list2.items, list2.count);
+    OverlapSet inner(list1.items, list1.count);
+    bool broadphase_ret;
+    if (check_overlap_broadphase<save>(outer, inner, broadphase_ret))
+        return broadphase_ret;
+
     int_temp.resize(size);
     std::fill(int_temp.begin(), int_temp.end(), 0);
 
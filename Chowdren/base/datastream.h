@@ -234,4 +234,49 @@ public:
     }
 };
 
+class MemoryStream : public BaseStream
+{
+public:
+    const char * data;
+    size_t size;
+    size_t pos;
+
+    MemoryStream(const char * data, size_t size)
+    : data(data), size(size), pos(0)
+    {
+    }
+
+    bool read(char * out, size_t len)
+    {
+        if (size - pos < len)
+            return false;
+        memcpy(out, data + pos, len);
+        pos += len;
+        return true;
+    }
+
+    // returns the data at the current position and skips past it, so callers
+    // can use it in-place
+    const char * get_pointer(size_t len)
+    {
+        const char * ret = data + pos;
+        pos = std::min(pos + len, size);
+        return ret;
+    }
+
+    void seek(size_t p)
+    {
+        pos = std::min(p, size);
+    }
+
+    bool at_end()
+    {
+        return pos == size;
+    }
+
+    void write(const char * data, size_t len)
+    {
+    }
+};
+
 #endif // CHOWDREN_DATASTREAM_H
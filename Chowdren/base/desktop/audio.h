@@ -15,12 +15,19 @@
 #endif
 
 #include <boost/thread/thread.hpp>
-#include <boost/thread/recursive_mutex.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/lockfree/spsc_queue.hpp>
+#include <boost/atomic.hpp>
 
 #include <math.h>
 #include "../types.h"
 #include "../audiodecoders.h"
 
+#ifdef CHOWDREN_USE_TRACING
+#include "../tracing.h"
+#endif
+
 namespace ChowdrenAudio {
 
 #ifndef CHOWDREN_IS_EMSCRIPTEN
@@ -86,22 +93,57 @@ void _al_check(const std::string& file, unsigned int line)
 
 class SoundStream;
 
+// streams are owned by the streaming thread. the game thread only sends
+// commands through a single-producer/single-consumer queue, so it never
+// waits on a decode, and the streaming thread sleeps until the next queued
+// buffer is due to be consumed or a command comes in.
+
+struct StreamCommand
+{
+    enum Type
+    {
+        ADD,
+        PLAY,
+        PAUSE,
+        STOP,
+        SEEK,
+        PAN,
+        DESTROY
+    };
+
+    SoundStream * stream;
+    int type;
+    double a, b;
+};
+
+#define STREAM_COMMAND_COUNT 1024
+
+// longest the streaming thread sleeps without a command or a due buffer
+#define STREAM_MAX_WAIT 0.25
+// how long after a buffer is due to wake up, so it has been processed
+#define STREAM_WAKE_MARGIN 0.002
+
 class AudioDevice
 {
 public:
     ALCdevice * device;
     ALCcontext * context;
     ALboolean direct_channels_ext, sub_buffer_data_ext;
+    // only touched on the streaming thread
     vector<SoundStream*> streams;
     boost::thread * streaming_thread;
-    boost::recursive_mutex stream_mutex;
+    boost::lockfree::spsc_queue<StreamCommand,
+        boost::lockfree::capacity<STREAM_COMMAND_COUNT> > commands;
+    boost::mutex wake_mutex;
+    boost::condition_variable wake;
+    bool woken;
     volatile bool closing;
 
     void open();
     static void _stream_update(void * data);
     void stream_update();
-    void add_stream(SoundStream*);
-    void remove_stream(SoundStream*);
+    void post(SoundStream * stream, int type, double a = 0.0, double b = 0.0);
+    void run_command(const StreamCommand & cmd);
     void close();
 };
 
@@ -248,7 +290,8 @@ public:
     unsigned int channels;
     SoundList sounds;
 
-    Sample(FSFile & fp, Media::AudioType type, size_t size);
+    Sample(SoundInput fp, Media::AudioType type, size_t size);
+    Sample(SoundDecoder & file);
     ~Sample();
     void add_sound(Sound* sound);
     void remove_sound(Sound* sound);
@@ -390,7 +433,7 @@ public:
         al_check(alDeleteSources(1, &source));
     }
 
-    void destroy()
+    virtual void destroy()
     {
         stop();
         delete this;
@@ -485,20 +528,30 @@ public:
 };
 
 #define BUFFER_COUNT 3
-#define LOCK_STREAM global_device.stream_mutex.lock
-#define UNLOCK_STREAM global_device.stream_mutex.unlock
 
 class SoundStream : public SoundBase
 {
 public:
     AssetFile fp;
     SoundDecoder * file;
-    bool playing;
+    // only written by the streaming thread, set while the stream is active
+    boost::atomic<bool> playing;
+    bool loop;
+    // what the game thread last asked for. until the streaming thread has
+    // run every command that was posted, this is reported instead of the
+    // state of the source.
+    Status requested;
+    double requested_offset;
+    unsigned int posted;
+    unsigned int seek_command;
+    boost::atomic<unsigned int> handled;
+    // written by the streaming thread, read with the source offset
+    boost::atomic<uint64_t> samples_processed;
+    // everything below is only touched on the streaming thread
+    bool active;
     SoundBuffer * buffers[BUFFER_COUNT];
     unsigned int channels;
     unsigned int sample_rate;
-    bool loop;
-    uint64_t samples_processed;
     bool end_buffers[BUFFER_COUNT];
     bool stopping;
 
@@ -517,80 +570,89 @@ public:
         init(create_decoder(fp, type, size));
     }
 
+    SoundStream(const char * data, Media::AudioType type, size_t size)
+    : SoundBase()
+    {
+        init(create_decoder(SoundInput(data, size), type, size));
+    }
+
     void init(SoundDecoder * decoder)
     {
         file = decoder;
-        playing = loop = stopping = false;
+        loop = stopping = active = false;
+        playing = false;
+        requested = Stopped;
+        requested_offset = 0.0;
+        posted = seek_command = 0;
+        handled = 0;
+        samples_processed = 0;
+        channels = file->channels;
+        sample_rate = file->sample_rate;
         format = get_format(file->channels);
 
         for (int i = 0; i < BUFFER_COUNT; ++i)
             buffers[i] = new SoundBuffer(file->sample_rate, file->channels,
                                          format);
 
-        LOCK_STREAM();
-        global_device.add_stream(this);
-        UNLOCK_STREAM();
+        global_device.post(this, StreamCommand::ADD);
     }
 
     ~SoundStream()
     {
-        stop();
-
-        LOCK_STREAM();
         for (int i = 0; i < BUFFER_COUNT; i++)
             delete buffers[i];
-
-        global_device.remove_stream(this);
-        UNLOCK_STREAM();
-
         delete file;
     }
 
-    void play()
-    {
-        // If the sound is already playing (probably paused), just resume it
-        if (playing) {
-            al_check(alSourcePlay(source));
-            return;
-        }
+    // game thread interface
 
-        // Move to the beginning
-        on_seek(0);
-
-        samples_processed = 0;
+    void send(int type, double a = 0.0, double b = 0.0)
+    {
+        posted++;
+        global_device.post(this, type, a, b);
+    }
 
-        for (int i = 0; i < BUFFER_COUNT; ++i) {
-            end_buffers[i] = false;
-        }
+    bool is_pending()
+    {
+        return handled.load(boost::memory_order_acquire) != posted;
+    }
 
-        stopping = fill_queue();
-        al_check(alSourcePlay(source));
+    void destroy()
+    {
+        global_device.post(this, StreamCommand::DESTROY);
+    }
 
-        playing = true;
+    void play()
+    {
+        requested = Playing;
+        send(StreamCommand::PLAY);
     }
 
     void pause()
     {
-        al_check(alSourcePause(source));
+        requested = Paused;
+        send(StreamCommand::PAUSE);
     }
 
     void stop()
     {
-        if (!playing)
+        // with nothing pending, a stream that isn't playing has nothing to
+        // stop. otherwise a play() may still be on its way.
+        if (!is_pending() && !playing)
             return;
-        LOCK_STREAM();
-        playing = false;
-        UNLOCK_STREAM();
-        al_check(alSourceStop(source));
-        clear_queue();
-        al_check(alSourcei(source, AL_BUFFER, 0));
+        requested = Stopped;
+        send(StreamCommand::STOP);
     }
 
     Status get_status()
     {
+        if (is_pending())
+            return requested;
+
         Status status = SoundBase::get_status();
 
-        // To compensate for the lag between play() and alSourceplay()
+        // the source stops when the stream underruns or runs out, until the
+        // streaming thread restarts or halts it
         if ((status == Stopped) && playing)
             status = Playing;
 
@@ -599,26 +661,21 @@ public:
 
     void set_playing_offset(double time)
     {
-        LOCK_STREAM();
-        al_check(alSourceStop(source));
-        clear_queue();
-        al_check(alSourcei(source, AL_BUFFER, 0));
-        on_seek(time);
-        samples_processed = static_cast<uint64_t>(
-            time * file->sample_rate * file->channels);
-        for (int i = 0; i < BUFFER_COUNT; ++i)
-            end_buffers[i] = false;
-        stopping = fill_queue();
-        al_check(alSourcePlay(source));
-        UNLOCK_STREAM();
+        // seeking restarts the source
+        requested = Playing;
+        requested_offset = time;
+        send(StreamCommand::SEEK, time);
+        seek_command = posted;
     }
 
     double get_playing_offset()
     {
+        if (int(handled.load(boost::memory_order_acquire) - seek_command) < 0)
+            return requested_offset;
         ALfloat secs = 0.0f;
         al_check(alGetSourcef(source, AL_SEC_OFFSET, &secs));
-        return secs + static_cast<float>(samples_processed
-            ) / file->sample_rate / file->channels;
+        return secs + static_cast<float>(samples_processed.load(
+            boost::memory_order_relaxed)) / file->sample_rate / file->channels;
     }
 
     double get_duration()
@@ -641,22 +698,105 @@ public:
         return file->sample_rate;
     }
 
-    void update()
+    void update_stereo_pan()
+    {
+        send(StreamCommand::PAN, left_gain, right_gain);
+    }
+
+    // streaming thread
+
+    void run_command(const StreamCommand & cmd)
+    {
+        switch (cmd.type) {
+            case StreamCommand::PLAY:
+                start();
+                break;
+            case StreamCommand::PAUSE:
+                al_check(alSourcePause(source));
+                break;
+            case StreamCommand::STOP:
+                halt();
+                break;
+            case StreamCommand::SEEK:
+                seek(cmd.a);
+                break;
+            case StreamCommand::PAN:
+                for (int i = 0; i < BUFFER_COUNT; i++)
+                    buffers[i]->set_pan(cmd.a, cmd.b);
+                break;
+        }
+        handled.fetch_add(1, boost::memory_order_release);
+    }
+
+    void start()
+    {
+        // If the sound is already playing (probably paused), just resume it
+        if (active) {
+            al_check(alSourcePlay(source));
+            return;
+        }
+
+        // Move to the beginning
+        on_seek(0);
+
+        samples_processed = 0;
+
+        for (int i = 0; i < BUFFER_COUNT; ++i) {
+            end_buffers[i] = false;
+        }
+
+        stopping = fill_queue();
+        al_check(alSourcePlay(source));
+
+        active = true;
+        playing = true;
+    }
+
+    void halt()
     {
-        if (!playing)
+        if (!active)
             return;
+        active = false;
+        playing = false;
+        al_check(alSourceStop(source));
+        clear_queue();
+        al_check(alSourcei(source, AL_BUFFER, 0));
+    }
+
+    void seek(double time)
+    {
+        al_check(alSourceStop(source));
+        clear_queue();
+        al_check(alSourcei(source, AL_BUFFER, 0));
+        on_seek(time);
+        samples_processed = static_cast<uint64_t>(
+            time * file->sample_rate * file->channels);
+        for (int i = 0; i < BUFFER_COUNT; ++i)
+            end_buffers[i] = false;
+        stopping = fill_queue();
+        al_check(alSourcePlay(source));
+        active = true;
+        playing = true;
+    }
+
+    // refills the processed buffers, and returns how long until the playing
+    // buffer has been consumed
+    double update()
+    {
+        if (!active)
+            return STREAM_MAX_WAIT;
 
         ALint status;
         al_check(alGetSourcei(source, AL_SOURCE_STATE, &status));
 
         if (status == AL_PAUSED)
-            return;
+            return STREAM_MAX_WAIT;
 
         // The stream has been interrupted!
         if (status == AL_STOPPED) {
             if (stopping) {
-                stop();
-                return;
+                halt();
+                return STREAM_MAX_WAIT;
             } else
                 al_check(alSourcePlay(source));
         }
@@ -689,7 +829,8 @@ public:
                 ALint size, bits;
                 al_check(alGetBufferi(buffer, AL_SIZE, &size));
                 al_check(alGetBufferi(buffer, AL_BITS, &bits));
-                samples_processed += size / (bits / 8);
+                samples_processed.fetch_add(size / (bits / 8),
+                                            boost::memory_order_relaxed);
             }
 
             // Fill it and push it back into the playing queue
@@ -698,11 +839,35 @@ public:
                     stopping = true;
             }
         }
+
+        return get_time_left();
+    }
+
+    double get_time_left()
+    {
+        ALint current, offset;
+        al_check(alGetSourcei(source, AL_BUFFER, &current));
+        al_check(alGetSourcei(source, AL_SAMPLE_OFFSET, &offset));
+
+        SoundBuffer * buffer = NULL;
+        for (int i = 0; i < BUFFER_COUNT; ++i) {
+            if (buffers[i]->buffer != ALuint(current))
+                continue;
+            buffer = buffers[i];
+            break;
+        }
+        if (buffer == NULL)
+            return STREAM_MAX_WAIT;
+
+        double frames = double(buffer->sample_count) / channels - offset;
+        double rate = sample_rate * pitch;
+        if (frames <= 0.0 || rate <= 0.0)
+            return 0.0;
+        return frames / rate;
     }
 
     void on_seek(double offset)
     {
-        // Lock lock(m_mutex);
         file->seek(offset);
     }
 
@@ -763,14 +928,6 @@ public:
         for (ALint i = 0; i < queued; ++i)
             al_check(alSourceUnqueueBuffers(source, 1, &buffer));
     }
-
-    void update_stereo_pan()
-    {
-        LOCK_STREAM();
-        for (int i = 0; i < BUFFER_COUNT; i++)
-            buffers[i]->set_pan(left_gain, right_gain);
-        UNLOCK_STREAM();
-    }
 };
 
 // audio device implementation
@@ -778,6 +935,7 @@ public:
 void AudioDevice::open()
 {
     closing = false;
+    woken = false;
     streaming_thread = NULL;
     device = NULL;
     context = NULL;
@@ -827,7 +985,12 @@ void AudioDevice::open()
 
 void AudioDevice::close()
 {
-    closing = true;
+    {
+        boost::mutex::scoped_lock guard(wake_mutex);
+        closing = true;
+        woken = true;
+    }
+    wake.notify_one();
     if (streaming_thread != NULL)
         streaming_thread->join();
 
@@ -839,6 +1002,51 @@ void AudioDevice::close()
     }
 }
 
+void AudioDevice::post(SoundStream * stream, int type, double a, double b)
+{
+    StreamCommand cmd;
+    cmd.stream = stream;
+    cmd.type = type;
+    cmd.a = a;
+    cmd.b = b;
+
+    // without a streaming thread, commands run right away
+    if (streaming_thread == NULL) {
+        run_command(cmd);
+        return;
+    }
+
+    // only waits if the streaming thread is over a thousand commands behind
+    while (!commands.push(cmd))
+        boost::this_thread::yield();
+
+    {
+        boost::mutex::scoped_lock guard(wake_mutex);
+        woken = true;
+    }
+    wake.notify_one();
+}
+
+void AudioDevice::run_command(const StreamCommand & cmd)
+{
+    SoundStream * stream = cmd.stream;
+    switch (cmd.type) {
+        case StreamCommand::ADD:
+            streams.push_back(stream);
+            break;
+        case StreamCommand::DESTROY:
+            stream->halt();
+            streams.erase(std::remove(streams.begin(), streams.end(),
+                                      stream),
+                          streams.end());
+            delete stream;
+            break;
+        default:
+            stream->run_command(cmd);
+            break;
+    }
+}
+
 void AudioDevice::stream_update()
 {
 #ifdef CHOWDREN_IS_EMSCRIPTEN
@@ -849,13 +1057,41 @@ void AudioDevice::stream_update()
         (*it)->update();
     emscripten_async_call(_stream_update, (void*)this, 125);
 #else
-    while (!closing) {
-        stream_mutex.lock();
+#ifdef CHOWDREN_USE_TRACING
+    trace_set_thread_name("audio");
+#endif
+    StreamCommand cmd;
+    while (true) {
+        while (commands.pop(cmd))
+            run_command(cmd);
+
+        if (closing)
+            break;
+
+#ifdef CHOWDREN_USE_TRACING
+        trace_begin("stream_update");
+#endif
+        double wait = STREAM_MAX_WAIT;
         vector<SoundStream*>::const_iterator it;
         for (it = streams.begin(); it != streams.end(); ++it)
-            (*it)->update();
-        stream_mutex.unlock();
-        boost::this_thread::sleep_for(boost::chrono::milliseconds(125));
+            wait = std::min(wait, (*it)->update());
+        wait += STREAM_WAKE_MARGIN;
+#ifdef CHOWDREN_USE_TRACING
+        trace_end();
+#endif
+
+        boost::chrono::steady_clock::time_point deadline =
+            boost::chrono::steady_clock::now() +
+            boost::chrono::duration_cast<boost::chrono::nanoseconds>(
+                boost::chrono::duration<double>(wait));
+
+        boost::mutex::scoped_lock guard(wake_mutex);
+        while (!woken) {
+            if (wake.wait_until(guard, deadline) ==
+                boost::cv_status::timeout)
+                break;
+        }
+        woken = false;
     }
 #endif
 }
@@ -865,17 +1101,6 @@ void AudioDevice::_stream_update(void * data)
     ((AudioDevice*)data)->stream_update();
 }
 
-void AudioDevice::add_stream(SoundStream * stream)
-{
-    streams.push_back(stream);
-}
-
-void AudioDevice::remove_stream(SoundStream * stream)
-{
-    streams.erase(std::remove(streams.begin(), streams.end(), stream),
-                  streams.end());
-}
-
 class Listener
 {
 public:
@@ -894,7 +1119,7 @@ public:
 
 // Sample implementation
 
-Sample::Sample(FSFile & fp, Media::AudioType type, size_t size)
+Sample::Sample(SoundInput fp, Media::AudioType type, size_t size)
 {
     SoundDecoder * file = create_decoder(fp, type, size);
     channels = file->channels;
@@ -903,6 +1128,13 @@ Sample::Sample(FSFile & fp, Media::AudioType type, size_t size)
     delete file;
 }
 
+Sample::Sample(SoundDecoder & file)
+{
+    channels = file.channels;
+    sample_rate = file.sample_rate;
+    buffer = new SoundBuffer(file, file.samples);
+}
+
 Sample::~Sample()
 {
     SoundList::const_iterator it;
@@ -131,6 +131,7 @@ void platform_begin_draw()
 
 void platform_swap_buffers()
 {
+    glc_end_frame();
 }
 
 void platform_get_size(int * width, int * height)
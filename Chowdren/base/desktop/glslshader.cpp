@@ -9,34 +9,38 @@
 #include "datastream.h"
 #include "assetfile.h"
 
-static bool background_initialized = false;
-static GLuint background_texture;
+// the capture for the shader that is currently drawing
+static GLuint background_texture = 0;
 
-static void initialize_background()
-{
-    background_initialized = true;
-    glGenTextures(1, &background_texture);
-    glBindTexture(GL_TEXTURE_2D, background_texture);
 #ifdef CHOWDREN_QUICK_SCALE
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+#define BACKGROUND_LINEAR false
 #else
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+#define BACKGROUND_LINEAR true
 #endif
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-}
 
 GLSLShader * GLSLShader::current = NULL;
 
 GLSLShader::GLSLShader(unsigned int id, int flags,
                        const char * texture_parameter)
-: initialized(false), id(id), flags(flags),
-  texture_parameter(texture_parameter)
+: size_width(0), size_height(0), initialized(false), id(id), flags(flags),
+  texture_parameter(texture_parameter), texture_slot(-1)
 {
 }
 
+#ifdef CHOWDREN_ASSET_MAPPING
+
+void GLSLShader::initialize()
+{
+    // the sources are handed to GL straight from the asset map
+    AssetView view = get_asset(id, AssetFile::SHADER_DATA);
+    MemoryStream stream(view.data, view.size);
+    GLint vert_size = stream.read_uint32();
+    const GLchar * vert_data = stream.get_pointer(vert_size);
+    GLint frag_size = stream.read_uint32();
+    const GLchar * frag_data = stream.get_pointer(frag_size);
+
+#else
+
 static AssetFile fp;
 
 void GLSLShader::initialize()
@@ -46,9 +50,26 @@ void GLSLShader::initialize()
 
     fp.set_item(id, AssetFile::SHADER_DATA);
 
+    FileStream stream(fp);
+    GLint vert_size = stream.read_uint32();
+    GLchar * vert_data = new GLchar[vert_size];
+    stream.read(vert_data, vert_size);
+    GLint frag_size = stream.read_uint32();
+    GLchar * frag_data = new GLchar[frag_size];
+    stream.read(frag_data, frag_size);
+
+#endif
+
     program = glCreateProgram();
-    GLuint vert_shader = attach_source(fp, GL_VERTEX_SHADER);
-    GLuint frag_shader = attach_source(fp, GL_FRAGMENT_SHADER);
+    GLuint vert_shader = attach_source(vert_data, vert_size,
+                                       GL_VERTEX_SHADER);
+    GLuint frag_shader = attach_source(frag_data, frag_size,
+                                       GL_FRAGMENT_SHADER);
+
+#ifndef CHOWDREN_ASSET_MAPPING
+    delete[] vert_data;
+    delete[] frag_data;
+#endif
 
 #ifndef CHOWDREN_USE_GL
     glBindAttribLocation(program, POSITION_ATTRIB_IDX, POSITION_ATTRIB_NAME);
@@ -73,9 +94,6 @@ void GLSLShader::initialize()
     glDetachShader(program, vert_shader);
     glDetachShader(program, frag_shader);
 
-    if ((flags & SHADER_HAS_BACK) && !background_initialized)
-        initialize_background();
-
     glUseProgram(program);
 
     // setup uniforms
@@ -88,6 +106,7 @@ void GLSLShader::initialize()
 
     if (texture_parameter != NULL) {
         glUniform1i((GLint)get_uniform(texture_parameter), 2);
+        texture_slot = get_shader_parameter_slot(texture_parameter);
     }
 
     glUseProgram(0);
@@ -113,18 +132,11 @@ bool GLSLShader::has_texture_param()
     return texture_parameter != NULL;
 }
 
-GLuint GLSLShader::attach_source(FSFile & fp, GLenum type)
+GLuint GLSLShader::attach_source(const GLchar * data, GLint size,
+                                 GLenum type)
 {
     GLuint shader = glCreateShader(type);
-
-    FileStream stream(fp);
-    size_t size = stream.read_uint32();
-    GLchar * data = new GLchar[size];
-    stream.read(data, size);
-
-    GLint len = size;
-    glShaderSource(shader, 1, (const GLchar**)&data, &len);
-    delete[] data;
+    glShaderSource(shader, 1, (const GLchar**)&data, &size);
     glCompileShader(shader);
 
     GLint status;
@@ -151,14 +163,18 @@ void GLSLShader::begin(FrameObject * instance, int width, int height)
     if (flags & SHADER_HAS_BACK) {
         int box[4];
         instance->get_screen_aabb(box);
-        glc_copy_color_buffer_rect(background_texture, box[0], box[1],
-                                   box[2], box[3]);
+        background_texture = glc_capture_color_buffer_rect(
+            box[0], box[1], box[2], box[3], BACKGROUND_LINEAR);
     }
 
     glUseProgram(program);
 
-    if (flags & SHADER_HAS_TEX_SIZE)
+    if ((flags & SHADER_HAS_TEX_SIZE) &&
+        (width != size_width || height != size_height)) {
+        size_width = width;
+        size_height = height;
         glUniform2f(size_uniform, 1.0f / width, 1.0f / height);
+    }
 
     set_parameters(instance);
 
@@ -177,26 +193,56 @@ void GLSLShader::end(FrameObject * instance)
     glUseProgram(0);
 }
 
-void GLSLShader::set_int(FrameObject * instance, const std::string & name,
-                           int uniform)
+void GLSLShader::init_uniform(ShaderUniform & uniform, const char * name)
+{
+    init_uniform(uniform, name, name);
+}
+
+void GLSLShader::init_uniform(ShaderUniform & uniform, const char * name,
+                              const char * parameter)
+{
+    uniform.location = get_uniform(name);
+    uniform.slot = get_shader_parameter_slot(parameter);
+    uniform.set = false;
+    uniform.value = 0.0;
+}
+
+// returns true if the value differs from the one last sent to the program
+static bool update_uniform(ShaderUniform & uniform, double value)
+{
+    if (uniform.location == -1)
+        return false;
+    if (uniform.set && uniform.value == value)
+        return false;
+    uniform.set = true;
+    uniform.value = value;
+    return true;
+}
+
+void GLSLShader::set_int(FrameObject * instance, ShaderUniform & uniform)
 {
-    int val = (int)(*instance->shader_parameters)[name];
-    glUniform1i((GLint)uniform, val);
+    int val = (int)instance->get_shader_parameter(uniform.slot);
+    if (!update_uniform(uniform, val))
+        return;
+    glUniform1i(uniform.location, val);
 }
 
-void GLSLShader::set_float(FrameObject * instance, const std::string & name,
-                           int uniform)
+void GLSLShader::set_float(FrameObject * instance, ShaderUniform & uniform)
 {
-    glUniform1f((GLint)uniform, (*instance->shader_parameters)[name]);
+    double val = instance->get_shader_parameter(uniform.slot);
+    if (!update_uniform(uniform, val))
+        return;
+    glUniform1f(uniform.location, val);
 }
 
-void GLSLShader::set_vec4(FrameObject * instance, const std::string & name,
-                          int uniform)
+void GLSLShader::set_vec4(FrameObject * instance, ShaderUniform & uniform)
 {
-    int val = (int)(*instance->shader_parameters)[name];
+    int val = (int)instance->get_shader_parameter(uniform.slot);
+    if (!update_uniform(uniform, val))
+        return;
     float a, b, c, d;
     convert_vec4(val, a, b, c, d);
-    glUniform4f((GLint)uniform, a, b, c, d);
+    glUniform4f(uniform.location, a, b, c, d);
 }
 
 int GLSLShader::get_uniform(const char * value)
@@ -1,5 +1,15 @@
 #include "../shader.h"
 
+// a uniform fed from an instance parameter. uniforms keep their values in
+// the program, so the last uploaded value is remembered and not sent again.
+struct ShaderUniform
+{
+    GLint location;
+    int slot;
+    bool set;
+    double value;
+};
+
 class GLSLShader : public Shader
 {
 public:
@@ -7,15 +17,17 @@ public:
     static GLSLShader * current;
     GLuint program;
     GLint size_uniform;
+    int size_width, size_height;
     bool initialized;
     unsigned int id;
     int flags;
     const char * texture_parameter;
+    int texture_slot;
 
     GLSLShader(unsigned int id, int flags = 0,
                const char * texture_parameter = NULL);
     void initialize();
-    GLuint attach_source(FSFile & fp, GLenum type);
+    GLuint attach_source(const GLchar * data, GLint size, GLenum type);
     GLuint get_background_texture();
     bool has_texture_param();
     int get_uniform(const char * value);
@@ -23,11 +35,12 @@ public:
     void begin(FrameObject * instance, int width, int height);
     virtual void set_parameters(FrameObject * instance);
     void end(FrameObject * instance);
-    void set_int(FrameObject * instance, const std::string & name,
-                 int uniform);
-    void set_float(FrameObject * instance, const std::string & name,
-                   int uniform);
-    void set_vec4(FrameObject * instance, const std::string & name,
-                  int uniform);
-    void set_image(FrameObject * instance, const std::string & name);
+    void init_uniform(ShaderUniform & uniform, const char * name);
+    // for uniforms that are set from a parameter with a different name
+    void init_uniform(ShaderUniform & uniform, const char * name,
+                      const char * parameter);
+    void set_int(FrameObject * instance, ShaderUniform & uniform);
+    void set_float(FrameObject * instance, ShaderUniform & uniform);
+    void set_vec4(FrameObject * instance, ShaderUniform & uniform);
+    void set_image(FrameObject * instance);
 };
\ No newline at end of file
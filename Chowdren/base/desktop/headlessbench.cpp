@@ -0,0 +1,490 @@
+// runtime microbenchmarks for the headless runner. they build their own
+// instances and lists instead of loading a frame, so any exported game can
+// run them.
+//
+// usage: Chowdren --bench overlap|churn|ball|text
+//
+// overlap: ObjectList vs ObjectList check_overlap for a sweep of list sizes,
+//          with the layer broadphase and with the pairwise loop
+// churn:   spawn/destroy churn on an ObjectList of 10k instances, removed
+//          the way Frame::clean_instances does it
+// ball:    ball movements bouncing around a field of background blocks, with
+//          the Movement::test_position probes that bounce() runs
+// text:    a HUD of Text and TextBlitter objects with text that never
+//          changes, drawn with their cached glyph meshes and with the meshes
+//          rebuilt every frame
+
+#include "chowconfig.h"
+#include "platform.h"
+#include "common.h"
+#include "crossrand.h"
+#include "movement.h"
+#include "mathcommon.h"
+#include "datastream.h"
+#include "objects/text.h"
+#include "objects/textblitter.h"
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+
+#define BENCH_AREA 2048
+#define BENCH_OBJECT_SIZE 16
+
+// the layer broadphase is sized from the current frame
+
+class BenchFrame : public Frame
+{
+public:
+    void set_index(int index)
+    {
+    }
+};
+
+static void create_bench_frame()
+{
+    Frame * frame = new BenchFrame;
+    frame->width = frame->height = BENCH_AREA;
+    manager.frame = frame;
+}
+
+static FrameObject * create_bench_object(Layer * layer, int id)
+{
+    int x = cross_rand() % BENCH_AREA;
+    int y = cross_rand() % BENCH_AREA;
+    FrameObject * obj = new FrameObject(x, y, id);
+    obj->width = obj->height = BENCH_OBJECT_SIZE;
+    obj->layer = layer;
+    obj->collision = new InstanceBox(obj);
+    obj->collision->update_aabb();
+    obj->collision->create_proxy();
+    return obj;
+}
+
+static void destroy_bench_objects(ObjectList & list)
+{
+    for (ObjectList::iterator it = list.begin(); it != list.end(); ++it) {
+        FrameObject * obj = it->obj;
+        delete obj->collision;
+        delete obj;
+    }
+    list.clear();
+}
+
+static void set_proxies(ObjectList & list, bool value)
+{
+    for (ObjectList::iterator it = list.begin(); it != list.end(); ++it) {
+        InstanceCollision * col = it->obj->collision;
+        if (value)
+            col->create_proxy();
+        else
+            col->remove_proxy();
+    }
+}
+
+// returns the mean time of one check_overlap call in microseconds, and the
+// number of instances left selected in both lists
+
+static double time_overlap(ObjectList & a, ObjectList & b, int rounds,
+                           int & selected)
+{
+    double start = platform_get_real_time();
+    for (int i = 0; i < rounds; i++) {
+        a.clear_selection();
+        b.clear_selection();
+        check_overlap<false>(a, b);
+    }
+    double t = platform_get_real_time() - start;
+    selected = a.get_selection_size() + b.get_selection_size();
+    return (t / rounds) * 1000000.0;
+}
+
+static int bench_overlap()
+{
+    static const int sizes[] = {16, 64, 256, 1024, 4096};
+    static const int size_count = sizeof(sizes) / sizeof(int);
+
+    create_bench_frame();
+    Layer layer(0, 1.0, 1.0, true, false, false);
+    cross_srand(0);
+
+    std::cout << "Overlap, " << BENCH_OBJECT_SIZE << "px boxes in "
+        << BENCH_AREA << "x" << BENCH_AREA << " (us per call)" << std::endl;
+    std::cout << std::setw(6) << "N" << std::setw(6) << "M"
+        << std::setw(14) << "broadphase" << std::setw(14) << "pairwise"
+        << std::setw(10) << "selected" << std::endl;
+
+    bool mismatch = false;
+    for (int n = 0; n < size_count; n++)
+    for (int m = 0; m < size_count; m++) {
+        ObjectList a, b;
+        for (int i = 0; i < sizes[n]; i++)
+            a.add(create_bench_object(&layer, 0));
+        for (int i = 0; i < sizes[m]; i++)
+            b.add(create_bench_object(&layer, 1));
+
+        // keep every cell at roughly the same amount of pair tests
+        int64_t pairs = int64_t(sizes[n]) * sizes[m];
+        int rounds = int(std::max<int64_t>(1, (1 << 22) / pairs));
+
+        int selected, pairwise_selected;
+        double broadphase = time_overlap(a, b, rounds, selected);
+
+        // without proxies, check_overlap falls back to the pairwise loop
+        set_proxies(a, false);
+        set_proxies(b, false);
+        double pairwise = time_overlap(a, b, rounds, pairwise_selected);
+        set_proxies(a, true);
+        set_proxies(b, true);
+
+        std::cout << std::setw(6) << sizes[n] << std::setw(6) << sizes[m]
+            << std::setw(14) << std::fixed << std::setprecision(2)
+            << broadphase << std::setw(14) << pairwise
+            << std::setw(10) << selected;
+        if (selected != pairwise_selected) {
+            std::cout << " (pairwise: " << pairwise_selected << ")";
+            mismatch = true;
+        }
+        std::cout << std::endl;
+
+        destroy_bench_objects(a);
+        destroy_bench_objects(b);
+    }
+
+    if (mismatch) {
+        std::cout << "Broadphase and pairwise selections differ" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+#define CHURN_INSTANCES 10000
+#define CHURN_ROUNDS 200
+
+// destroys every instance marked in dead with one compact() (batched) or
+// one compact() per instance (which costs as much as shifting the rest of
+// the list on every removal), then spawns the same number again
+
+static void churn_round(ObjectList & list, vector<FrameObject*> & dead,
+                        bool batched)
+{
+    for (unsigned int i = 0; i < dead.size(); i++) {
+        list.remove(dead[i]);
+        if (!batched)
+            list.compact();
+    }
+    list.compact();
+    for (unsigned int i = 0; i < dead.size(); i++) {
+        delete dead[i];
+        FrameObject * obj = new FrameObject(0, 0, 0);
+        list.add(obj);
+        list.add_back();
+    }
+}
+
+static double time_churn(int percent, bool batched)
+{
+    ObjectList list;
+    for (int i = 0; i < CHURN_INSTANCES; i++)
+        list.add(new FrameObject(0, 0, 0));
+    cross_srand(0);
+
+    vector<FrameObject*> dead;
+    int checksum = 0;
+    double start = platform_get_real_time();
+    for (int round = 0; round < CHURN_ROUNDS; round++) {
+        // what generated events do with the list between cleanups
+        list.clear_selection();
+        dead.clear();
+        for (ObjectIterator it(list); !it.end(); ++it) {
+            if (int(cross_rand() % 100) < percent)
+                dead.push_back(*it);
+        }
+        int size = list.get_selection_size();
+        for (int i = 0; i < 16; i++)
+            checksum += list.get_selection((i * 7919) % size)->index;
+        churn_round(list, dead, batched);
+    }
+    double t = platform_get_real_time() - start;
+
+    if (list.size() != CHURN_INSTANCES || checksum < 0)
+        std::cout << "Churn lost instances" << std::endl;
+    for (ObjectList::iterator it = list.begin(); it != list.end(); ++it)
+        delete it->obj;
+    return (t / CHURN_ROUNDS) * 1000.0;
+}
+
+static int bench_churn()
+{
+    static const int percents[] = {1, 5, 25, 50};
+    static const int percent_count = sizeof(percents) / sizeof(int);
+
+    std::cout << "Churn, " << CHURN_INSTANCES << " instances, "
+        << CHURN_ROUNDS << " rounds (ms per round)" << std::endl;
+    std::cout << std::setw(10) << "destroyed" << std::setw(12) << "batched"
+        << std::setw(14) << "one by one" << std::endl;
+
+    for (int i = 0; i < percent_count; i++) {
+        double batched = time_churn(percents[i], true);
+        double single = time_churn(percents[i], false);
+        std::cout << std::setw(9) << percents[i] << "%"
+            << std::setw(12) << std::fixed << std::setprecision(3)
+            << batched << std::setw(14) << single << std::endl;
+    }
+    return 0;
+}
+
+#define BALL_COUNT 1000
+#define BALL_FRAMES 200
+#define BALL_SPEED 4
+#define BALL_BLOCK 32
+
+static FrameObject * create_ball_block(Layer * layer, int x, int y)
+{
+    FrameObject * obj = new FrameObject(x, y, BACKGROUND_TYPE);
+    obj->width = obj->height = BALL_BLOCK;
+    obj->layer = layer;
+    obj->collision = new InstanceBox(obj);
+    obj->collision->update_aabb();
+    obj->collision->create_static_proxy();
+    return obj;
+}
+
+static int bench_ball()
+{
+    create_bench_frame();
+    Layer layer(0, 1.0, 1.0, true, false, false);
+    cross_srand(0);
+
+    // walls around the area and a block in about a quarter of the cells
+    vector<FrameObject*> blocks;
+    int cells = BENCH_AREA / BALL_BLOCK;
+    for (int y = 0; y < cells; y++)
+    for (int x = 0; x < cells; x++) {
+        bool wall = x == 0 || y == 0 || x == cells - 1 || y == cells - 1;
+        if (!wall && cross_rand() % 4 != 0)
+            continue;
+        blocks.push_back(create_ball_block(&layer, x * BALL_BLOCK,
+                                           y * BALL_BLOCK));
+    }
+
+    vector<FrameObject*> balls;
+    while (balls.size() < BALL_COUNT) {
+        FrameObject * obj = create_bench_object(&layer, 0);
+        if (obj->overlaps_background()) {
+            delete obj->collision;
+            delete obj;
+            continue;
+        }
+        obj->direction = cross_rand() % 32;
+        obj->movement = new BallMovement(obj);
+        obj->movement->set_background_collision();
+        balls.push_back(obj);
+    }
+
+    // what a ball movement and a "bounce on background collision" event do
+    // every frame
+    int bounces = 0;
+    double bounce_time = 0.0;
+    double start = platform_get_real_time();
+    for (int frame = 0; frame < BALL_FRAMES; frame++)
+    for (unsigned int i = 0; i < balls.size(); i++) {
+        FrameObject * obj = balls[i];
+        Movement * movement = obj->movement;
+        movement->old_x = obj->x;
+        movement->old_y = obj->y;
+        double a = rad(obj->direction * 11.25);
+        obj->set_position(obj->x + int(cos(a) * BALL_SPEED),
+                          obj->y - int(sin(a) * BALL_SPEED));
+        if (!obj->overlaps_background())
+            continue;
+        double bounce_start = platform_get_real_time();
+        movement->bounce(true);
+        bounce_time += platform_get_real_time() - bounce_start;
+        bounces++;
+    }
+    double t = platform_get_real_time() - start;
+
+    // the same moves and bounces must come out of every version of the probes
+    unsigned int checksum = 0;
+    for (unsigned int i = 0; i < balls.size(); i++) {
+        FrameObject * obj = balls[i];
+        checksum = checksum * 31 + obj->x * 7 + obj->y * 3 + obj->direction;
+        delete obj->collision;
+        delete obj;
+    }
+    for (unsigned int i = 0; i < blocks.size(); i++) {
+        delete blocks[i]->collision;
+        delete blocks[i];
+    }
+
+    std::cout << "Ball, " << BALL_COUNT << " balls, " << blocks.size()
+        << " background blocks, " << BALL_FRAMES << " frames" << std::endl;
+    std::cout << std::fixed << std::setprecision(2)
+        << (t / BALL_FRAMES) * 1000.0 << " ms per frame, " << bounces
+        << " bounces, " << (bounce_time / std::max(1, bounces)) * 1000000.0
+        << " us per bounce, checksum " << std::hex << checksum
+        << std::dec << std::endl;
+    return 0;
+}
+
+#define TEXT_OBJECTS 50
+#define TEXT_FRAMES 200
+#define TEXT_GLYPH_WIDTH 8
+#define TEXT_GLYPH_HEIGHT 14
+
+static const char * text_lines[] = {
+    "Score: 0012450",
+    "Lives x3   Time 02:41",
+    "Press Start to continue",
+    "Gold 125\nKeys 2\nBombs 10"
+};
+
+static void write_float(DataStream & stream, float value)
+{
+    stream.write((const char*)&value, sizeof(float));
+}
+
+// a monospace font with blank glyphs for printable ASCII, in the format the
+// exporter writes fonts in
+
+static FTTextureFont * create_bench_font(std::stringstream & data)
+{
+    DataStream stream(data);
+    stream.write_int32(12);
+    write_float(stream, TEXT_GLYPH_WIDTH);
+    write_float(stream, TEXT_GLYPH_HEIGHT);
+    write_float(stream, 11.0f);
+    write_float(stream, -3.0f);
+    stream.write_int32(127 - 32);
+    std::string pixels(TEXT_GLYPH_WIDTH * TEXT_GLYPH_HEIGHT, '\0');
+    for (int c = 32; c < 127; c++) {
+        stream.write_uint32(c);
+        write_float(stream, 0.0f);
+        write_float(stream, -3.0f);
+        write_float(stream, TEXT_GLYPH_WIDTH - 1);
+        write_float(stream, 11.0f);
+        write_float(stream, TEXT_GLYPH_WIDTH);
+        write_float(stream, 0.0f);
+        write_float(stream, 0.0f);
+        write_float(stream, 11.0f);
+        stream.write_int32(TEXT_GLYPH_WIDTH);
+        stream.write_int32(TEXT_GLYPH_HEIGHT);
+        stream.write_string(pixels);
+    }
+    data.seekg(0);
+    return new FTTextureFont(stream);
+}
+
+static Image * create_bench_charmap_image()
+{
+    Image * image = new Image;
+    image->width = 16 * TEXT_GLYPH_WIDTH;
+    image->height = 6 * TEXT_GLYPH_HEIGHT;
+    image->image = (unsigned char*)calloc(image->width * image->height, 4);
+    image->upload_texture();
+    return image;
+}
+
+// returns the mean time of one frame in microseconds
+
+static double time_text(vector<FrameObject*> & objects, bool rebuild)
+{
+    double start = platform_get_real_time();
+    for (int frame = 0; frame < TEXT_FRAMES; frame++)
+    for (unsigned int i = 0; i < objects.size(); i++) {
+        FrameObject * obj = objects[i];
+        if (rebuild) {
+            // what a changed text, font or layout does
+            if (i % 2 == 0)
+                ((Text*)obj)->mesh_set = false;
+            else
+                ((TextBlitter*)obj)->mesh_set = false;
+        }
+        obj->draw();
+    }
+    double t = platform_get_real_time() - start;
+    return (t / TEXT_FRAMES) * 1000000.0;
+}
+
+static int bench_text()
+{
+    std::stringstream font_data;
+    FTTextureFont * font = create_bench_font(font_data);
+    Image * image = create_bench_charmap_image();
+    std::string charmap;
+    for (int c = 32; c < 127; c++)
+        charmap.push_back(char(c));
+
+    // even objects are Text, odd ones TextBlitter
+    vector<FrameObject*> objects;
+    for (int i = 0; i < TEXT_OBJECTS; i++) {
+        const char * line = text_lines[(i / 2) % 4];
+        int x = (i % 5) * 200;
+        int y = (i / 5) * 48;
+        if (i % 2 == 0) {
+            Text * text = new Text(x, y, 0);
+            text->width = 200;
+            text->height = 48;
+            text->font = font;
+            text->alignment = (i / 2) % 3 == 0 ? ALIGN_HCENTER : ALIGN_LEFT;
+            text->bold = text->italic = false;
+            text->set_string(line);
+            objects.push_back(text);
+            continue;
+        }
+        TextBlitter * blitter = new TextBlitter(x, y, 0);
+        blitter->width = 200;
+        blitter->height = 48;
+        blitter->image = image;
+        blitter->image_width = image->width;
+        blitter->char_width = TEXT_GLYPH_WIDTH;
+        blitter->char_height = TEXT_GLYPH_HEIGHT;
+        blitter->char_offset = 0;
+        blitter->x_off = blitter->y_off = 0;
+        blitter->alignment = (i / 2) % 3 == 0 ? ALIGN_HCENTER : ALIGN_LEFT;
+        blitter->wrap = false;
+        blitter->set_charmap(charmap);
+        blitter->set_text(line);
+        objects.push_back(blitter);
+    }
+
+    double rebuilt = time_text(objects, true);
+    double cached = time_text(objects, false);
+
+    // a mesh is drawn with one submission per texture run
+    int glyphs = 0, runs = 0;
+    for (unsigned int i = 0; i < objects.size(); i++) {
+        FrameObject * obj = objects[i];
+        QuadMesh & mesh = i % 2 == 0 ? ((Text*)obj)->mesh
+                                     : ((TextBlitter*)obj)->mesh;
+        glyphs += int(mesh.vertices.size()) / 4;
+        runs += int(mesh.runs.size());
+        delete obj;
+    }
+    delete font;
+    delete image;
+
+    std::cout << "Text, " << TEXT_OBJECTS / 2 << " Text and "
+        << TEXT_OBJECTS / 2 << " TextBlitter objects, " << TEXT_FRAMES
+        << " frames" << std::endl;
+    std::cout << glyphs << " glyphs in " << runs
+        << " draw submissions per frame" << std::endl;
+    std::cout << std::fixed << std::setprecision(1) << cached
+        << " us per frame cached, " << rebuilt
+        << " us per frame rebuilt" << std::endl;
+    return 0;
+}
+
+int run_benchmark(const std::string & name)
+{
+    if (name == "overlap")
+        return bench_overlap();
+    if (name == "churn")
+        return bench_churn();
+    if (name == "ball")
+        return bench_ball();
+    if (name == "text")
+        return bench_text();
+    std::cout << "Unknown benchmark: " << name << std::endl;
+    return 2;
+}
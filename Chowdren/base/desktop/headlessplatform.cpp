@@ -0,0 +1,480 @@
+// headless platform layer. there is no window, no input devices and no GL
+// context (see nullgl.cpp). time is a fixed-step clock that only advances
+// once per tick, and input is read from a script, so two runs with the same
+// arguments execute the same events.
+//
+// usage: Chowdren [--ticks n] [--input script.txt] [--timings out.csv]
+//        Chowdren --bench name (see headlessbench.cpp)
+//
+// the input script has one event per line:
+//
+//   <tick> key_down|key_up <key name or code>
+//   <tick> mouse_down|mouse_up <button>
+//   <tick> mouse_move <x> <y>
+//
+// lines starting with '#' are ignored.
+
+#include "chowconfig.h"
+#include "platform.h"
+#include "include_gl.h"
+#include "manager.h"
+#include "mathcommon.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <time.h>
+#include <stdlib.h>
+#include <boost/cstdint.hpp>
+#include <boost/chrono.hpp>
+
+using boost::uintmax_t;
+
+#define HEADLESS_DEFAULT_TICKS 600
+
+enum HeadlessEventType
+{
+    HEADLESS_KEY_DOWN,
+    HEADLESS_KEY_UP,
+    HEADLESS_MOUSE_DOWN,
+    HEADLESS_MOUSE_UP,
+    HEADLESS_MOUSE_MOVE
+};
+
+struct HeadlessEvent
+{
+    int tick;
+    int type;
+    int a, b;
+};
+
+static bool sort_events(const HeadlessEvent & a, const HeadlessEvent & b)
+{
+    return a.tick < b.tick;
+}
+
+struct TickTiming
+{
+    double events;
+    double draw;
+};
+
+static int max_ticks = HEADLESS_DEFAULT_TICKS;
+static std::string input_path;
+static std::string timings_path("timings.csv");
+static std::string benchmark;
+
+static vector<HeadlessEvent> script;
+static unsigned int script_pos = 0;
+static vector<TickTiming> timings;
+
+static int tick = -1;
+static double headless_time = 0.0;
+static int mouse_x = 0;
+static int mouse_y = 0;
+static boost::chrono::high_resolution_clock::time_point real_start;
+
+void platform_set_args(int argc, char ** argv)
+{
+    for (int i = 1; i < argc - 1; i++) {
+        std::string arg(argv[i]);
+        if (arg == "--ticks")
+            max_ticks = atoi(argv[++i]);
+        else if (arg == "--input")
+            input_path = argv[++i];
+        else if (arg == "--timings")
+            timings_path = argv[++i];
+        else if (arg == "--bench")
+            benchmark = argv[++i];
+    }
+}
+
+const std::string & platform_get_benchmark()
+{
+    return benchmark;
+}
+
+static int parse_key(const std::string & value)
+{
+    if (!value.empty() && value[0] >= '0' && value[0] <= '9')
+        return atoi(value.c_str());
+    return translate_string_to_key(value);
+}
+
+static void load_script()
+{
+    if (input_path.empty())
+        return;
+    std::ifstream fp(input_path.c_str());
+    if (!fp) {
+        std::cout << "Could not open input script: " << input_path
+            << std::endl;
+        return;
+    }
+    std::string line;
+    while (std::getline(fp, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream stream(line);
+        HeadlessEvent event;
+        std::string name, value;
+        stream >> event.tick >> name >> value;
+        event.b = 0;
+        if (name == "key_down") {
+            event.type = HEADLESS_KEY_DOWN;
+            event.a = parse_key(value);
+        } else if (name == "key_up") {
+            event.type = HEADLESS_KEY_UP;
+            event.a = parse_key(value);
+        } else if (name == "mouse_down") {
+            event.type = HEADLESS_MOUSE_DOWN;
+            event.a = atoi(value.c_str());
+        } else if (name == "mouse_up") {
+            event.type = HEADLESS_MOUSE_UP;
+            event.a = atoi(value.c_str());
+        } else if (name == "mouse_move") {
+            event.type = HEADLESS_MOUSE_MOVE;
+            event.a = atoi(value.c_str());
+            stream >> event.b;
+        } else {
+            std::cout << "Unknown input event: " << line << std::endl;
+            continue;
+        }
+        script.push_back(event);
+    }
+    std::stable_sort(script.begin(), script.end(), sort_events);
+}
+
+void platform_init()
+{
+    real_start = boost::chrono::high_resolution_clock::now();
+    load_script();
+    timings.reserve(max_ticks);
+    std::cout << "Headless run: " << max_ticks << " ticks, "
+        << script.size() << " input events" << std::endl;
+}
+
+static void dump_timings()
+{
+    if (timings.empty())
+        return;
+
+    std::ofstream fp(timings_path.c_str());
+    fp << "tick,events,draw\n";
+    vector<double> totals;
+    totals.reserve(timings.size());
+    double total = 0.0;
+    for (unsigned int i = 0; i < timings.size(); i++) {
+        const TickTiming & t = timings[i];
+        fp << i << "," << t.events << "," << t.draw << "\n";
+        totals.push_back(t.events + t.draw);
+        total += t.events + t.draw;
+    }
+    fp.close();
+
+    std::sort(totals.begin(), totals.end());
+    int n = totals.size();
+    std::cout << "Ran " << n << " ticks in " << total << "s" << std::endl;
+    std::cout << "Tick mean " << total / n << "s, median "
+        << totals[n / 2] << "s, 95th " << totals[(n * 95) / 100]
+        << "s, max " << totals[n - 1] << "s" << std::endl;
+    std::cout << "Timings written to " << timings_path << std::endl;
+}
+
+void platform_exit()
+{
+    dump_timings();
+}
+
+void platform_poll_events()
+{
+    tick++;
+    if (tick > 0)
+        headless_time += 1.0 / manager.fps_limit.framerate;
+
+    while (script_pos < script.size()) {
+        const HeadlessEvent & event = script[script_pos];
+        if (event.tick > tick)
+            break;
+        script_pos++;
+        switch (event.type) {
+            case HEADLESS_KEY_DOWN:
+                manager.on_key(event.a, true);
+                break;
+            case HEADLESS_KEY_UP:
+                manager.on_key(event.a, false);
+                break;
+            case HEADLESS_MOUSE_DOWN:
+                manager.on_mouse(event.a, true);
+                break;
+            case HEADLESS_MOUSE_UP:
+                manager.on_mouse(event.a, false);
+                break;
+            case HEADLESS_MOUSE_MOVE:
+                mouse_x = event.a;
+                mouse_y = event.b;
+                break;
+        }
+    }
+}
+
+void platform_add_timing(double events, double draw)
+{
+    TickTiming t;
+    t.events = events;
+    t.draw = draw;
+    timings.push_back(t);
+}
+
+// time
+
+double platform_get_time()
+{
+    return headless_time;
+}
+
+double platform_get_real_time()
+{
+    boost::chrono::duration<double> d =
+        boost::chrono::high_resolution_clock::now() - real_start;
+    return d.count();
+}
+
+unsigned int platform_get_global_time()
+{
+    // fixed, so the random seed is the same for every run
+    return 0;
+}
+
+void platform_sleep(double t)
+{
+}
+
+bool platform_display_closed()
+{
+    return tick + 1 >= max_ticks;
+}
+
+void platform_get_mouse_pos(int * x, int * y)
+{
+    *x = mouse_x;
+    *y = mouse_y;
+}
+
+void platform_create_display(bool fullscreen)
+{
+}
+
+void platform_set_vsync(bool value)
+{
+}
+
+void platform_set_fullscreen(bool value)
+{
+}
+
+void platform_begin_draw()
+{
+}
+
+void platform_swap_buffers()
+{
+    glc_end_frame();
+}
+
+void platform_get_size(int * width, int * height)
+{
+    *width = WINDOW_WIDTH;
+    *height = WINDOW_HEIGHT;
+}
+
+void platform_get_screen_size(int * width, int * height)
+{
+    *width = WINDOW_WIDTH;
+    *height = WINDOW_HEIGHT;
+}
+
+bool platform_has_focus()
+{
+    return true;
+}
+
+void platform_set_focus(bool value)
+{
+}
+
+void platform_show_mouse()
+{
+}
+
+void platform_hide_mouse()
+{
+}
+
+const std::string & platform_get_language()
+{
+    static std::string language("English");
+    return language;
+}
+
+// filesystem stuff
+
+#include <sys/stat.h>
+#include <boost/filesystem.hpp>
+
+size_t platform_get_file_size(const char * filename)
+{
+    boost::system::error_code err;
+    uintmax_t ret = boost::filesystem::file_size(filename, err);
+    if (ret == uintmax_t(-1))
+        return 0;
+    return ret;
+}
+
+bool platform_path_exists(const std::string & value)
+{
+    boost::system::error_code err;
+    return boost::filesystem::exists(value, err);
+}
+
+bool platform_is_directory(const std::string & value)
+{
+    boost::system::error_code err;
+    return boost::filesystem::is_directory(value, err);
+}
+
+bool platform_is_file(const std::string & value)
+{
+    boost::system::error_code err;
+    return boost::filesystem::is_regular_file(value, err);
+}
+
+void platform_create_directories(const std::string & value)
+{
+    boost::filesystem::path path(value);
+    if (path.has_filename())
+        path.remove_filename();
+
+    boost::system::error_code err;
+    boost::filesystem::create_directories(path, err);
+}
+
+const std::string & platform_get_appdata_dir()
+{
+    // keep saves out of the user's real appdata directory
+    static std::string dir("./headless");
+    return dir;
+}
+
+// joystick
+
+int get_joystick_last_press(int n)
+{
+    return CHOWDREN_BUTTON_INVALID;
+}
+
+bool is_joystick_attached(int n)
+{
+    return false;
+}
+
+bool is_joystick_pressed(int n, int button)
+{
+    return false;
+}
+
+bool any_joystick_pressed(int n)
+{
+    return false;
+}
+
+bool is_joystick_released(int n, int button)
+{
+    return true;
+}
+
+void joystick_vibrate(int n, int l, int r, int ms)
+{
+}
+
+float get_joystick_axis(int n, int axis)
+{
+    return 0.0f;
+}
+
+// url open
+
+void open_url(const std::string & name)
+{
+}
+
+// file
+
+bool platform_remove_file(const std::string & file)
+{
+    return remove(convert_path(file).c_str()) == 0;
+}
+
+#include "fileio.cpp"
+#include "stdiofile.cpp"
+
+// path
+
+std::string convert_path(const std::string & v)
+{
+    std::string value = v;
+    if (value.compare(0, 3, "./\\") == 0)
+        value = std::string("./", 2) + value.substr(3);
+#ifndef _WIN32
+    std::replace(value.begin(), value.end(), '\\', '/');
+#else
+    std::replace(value.begin(), value.end(), '/', '\\');
+#endif
+    return value;
+}
+
+// debug
+
+void platform_print_stats()
+{
+}
+
+void platform_debug(const std::string & value)
+{
+    std::cout << "Debug: " << value << std::endl;
+}
+
+// dummies
+
+void platform_prepare_frame_change()
+{
+}
+
+void platform_set_remote_setting(const std::string & v)
+{
+}
+
+void platform_set_remote_value(int v)
+{
+}
+
+int platform_get_remote_value()
+{
+    return CHOWDREN_TV_TARGET;
+}
+
+void platform_set_border(bool v)
+{
+}
+
+static std::string remote_string("TV");
+
+const std::string & platform_get_remote_setting()
+{
+    return remote_string;
+}
+
+bool platform_has_error()
+{
+    return false;
+}
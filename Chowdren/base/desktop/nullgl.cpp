@@ -0,0 +1,368 @@
+// null OpenGL backend for headless runs. every entry point the runtime uses
+// is implemented here as a no-op, so nothing is rendered and no driver or
+// display is needed. object names are still handed out, since the runtime
+// treats 0 as "no texture".
+
+#include <SDL_opengl.h>
+#include <string.h>
+
+static GLuint null_names = 0;
+
+static void gen_names(GLsizei n, GLuint * names)
+{
+    for (GLsizei i = 0; i < n; i++)
+        names[i] = ++null_names;
+}
+
+extern "C" {
+
+// state
+
+void APIENTRY glEnable(GLenum cap)
+{
+}
+
+void APIENTRY glDisable(GLenum cap)
+{
+}
+
+void APIENTRY glBlendFunc(GLenum sfactor, GLenum dfactor)
+{
+}
+
+void APIENTRY glScissor(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+}
+
+void APIENTRY glViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+}
+
+void APIENTRY glClearColor(GLclampf red, GLclampf green, GLclampf blue,
+                           GLclampf alpha)
+{
+}
+
+void APIENTRY glClear(GLbitfield mask)
+{
+}
+
+void APIENTRY glPixelStorei(GLenum pname, GLint param)
+{
+}
+
+void APIENTRY glGetIntegerv(GLenum pname, GLint * params)
+{
+    if (pname == GL_MAX_TEXTURE_SIZE) {
+        *params = 4096;
+        return;
+    }
+    *params = 0;
+}
+
+void APIENTRY glGetFloatv(GLenum pname, GLfloat * params)
+{
+    if (pname == GL_MODELVIEW_MATRIX || pname == GL_PROJECTION_MATRIX) {
+        memset(params, 0, sizeof(GLfloat) * 16);
+        params[0] = params[5] = params[10] = params[15] = 1.0f;
+        return;
+    }
+    *params = 0.0f;
+}
+
+// matrices
+
+void APIENTRY glMatrixMode(GLenum mode)
+{
+}
+
+void APIENTRY glLoadIdentity()
+{
+}
+
+void APIENTRY glPushMatrix()
+{
+}
+
+void APIENTRY glPopMatrix()
+{
+}
+
+void APIENTRY glOrtho(GLdouble left, GLdouble right, GLdouble bottom,
+                      GLdouble top, GLdouble near_val, GLdouble far_val)
+{
+}
+
+void APIENTRY glTranslatef(GLfloat x, GLfloat y, GLfloat z)
+{
+}
+
+void APIENTRY glTranslated(GLdouble x, GLdouble y, GLdouble z)
+{
+}
+
+void APIENTRY glScalef(GLfloat x, GLfloat y, GLfloat z)
+{
+}
+
+void APIENTRY glRotatef(GLfloat angle, GLfloat x, GLfloat y, GLfloat z)
+{
+}
+
+// immediate mode
+
+void APIENTRY glBegin(GLenum mode)
+{
+}
+
+void APIENTRY glEnd()
+{
+}
+
+void APIENTRY glColor4ub(GLubyte red, GLubyte green, GLubyte blue,
+                         GLubyte alpha)
+{
+}
+
+void APIENTRY glColor4f(GLfloat red, GLfloat green, GLfloat blue,
+                        GLfloat alpha)
+{
+}
+
+void APIENTRY glTexCoord2f(GLfloat s, GLfloat t)
+{
+}
+
+void APIENTRY glVertex2i(GLint x, GLint y)
+{
+}
+
+void APIENTRY glVertex2f(GLfloat x, GLfloat y)
+{
+}
+
+void APIENTRY glVertex2d(GLdouble x, GLdouble y)
+{
+}
+
+void APIENTRY glVertex3f(GLfloat x, GLfloat y, GLfloat z)
+{
+}
+
+// vertex arrays
+
+void APIENTRY glEnableClientState(GLenum array)
+{
+}
+
+void APIENTRY glDisableClientState(GLenum array)
+{
+}
+
+void APIENTRY glVertexPointer(GLint size, GLenum type, GLsizei stride,
+                              const GLvoid * pointer)
+{
+}
+
+void APIENTRY glTexCoordPointer(GLint size, GLenum type, GLsizei stride,
+                                const GLvoid * pointer)
+{
+}
+
+void APIENTRY glDrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+}
+
+// textures
+
+void APIENTRY glGenTextures(GLsizei n, GLuint * textures)
+{
+    gen_names(n, textures);
+}
+
+void APIENTRY glDeleteTextures(GLsizei n, const GLuint * textures)
+{
+}
+
+void APIENTRY glBindTexture(GLenum target, GLuint texture)
+{
+}
+
+void APIENTRY glTexParameteri(GLenum target, GLenum pname, GLint param)
+{
+}
+
+void APIENTRY glTexImage2D(GLenum target, GLint level, GLint internalFormat,
+                           GLsizei width, GLsizei height, GLint border,
+                           GLenum format, GLenum type, const GLvoid * pixels)
+{
+}
+
+void APIENTRY glTexSubImage2D(GLenum target, GLint level, GLint xoffset,
+                              GLint yoffset, GLsizei width, GLsizei height,
+                              GLenum format, GLenum type,
+                              const GLvoid * pixels)
+{
+}
+
+void APIENTRY glCopyTexSubImage2D(GLenum target, GLint level, GLint xoffset,
+                                  GLint yoffset, GLint x, GLint y,
+                                  GLsizei width, GLsizei height)
+{
+}
+
+} // extern "C"
+
+// extensions
+
+static void APIENTRY null_blend_equation(GLenum mode)
+{
+}
+
+static void APIENTRY null_blend_equation_separate(GLenum rgb, GLenum alpha)
+{
+}
+
+static void APIENTRY null_blend_func_separate(GLenum src_rgb, GLenum dst_rgb,
+                                              GLenum src_alpha,
+                                              GLenum dst_alpha)
+{
+}
+
+static void APIENTRY null_active_texture(GLenum texture)
+{
+}
+
+static void APIENTRY null_multi_texcoord_2f(GLenum target, GLfloat s,
+                                            GLfloat t)
+{
+}
+
+static void APIENTRY null_gen_framebuffers(GLsizei n, GLuint * framebuffers)
+{
+    gen_names(n, framebuffers);
+}
+
+static void APIENTRY null_framebuffer_texture_2d(GLenum target,
+                                                 GLenum attachment,
+                                                 GLenum textarget,
+                                                 GLuint texture, GLint level)
+{
+}
+
+static void APIENTRY null_bind_framebuffer(GLenum target, GLuint framebuffer)
+{
+}
+
+static void APIENTRY null_use_program(GLuint program)
+{
+}
+
+static void APIENTRY null_detach_shader(GLuint program, GLuint shader)
+{
+}
+
+static void APIENTRY null_get_info_log(GLuint object, GLsizei size,
+                                       GLsizei * length, GLchar * log)
+{
+    if (length != NULL)
+        *length = 0;
+    if (size > 0)
+        log[0] = '\0';
+}
+
+static void APIENTRY null_get_program(GLuint program, GLenum pname,
+                                      GLint * params)
+{
+    *params = pname == GL_LINK_STATUS ? GL_TRUE : 0;
+}
+
+static void APIENTRY null_get_shader(GLuint shader, GLenum pname,
+                                     GLint * params)
+{
+    *params = pname == GL_COMPILE_STATUS ? GL_TRUE : 0;
+}
+
+static void APIENTRY null_link_program(GLuint program)
+{
+}
+
+static GLuint APIENTRY null_create_program()
+{
+    return ++null_names;
+}
+
+static GLuint APIENTRY null_create_shader(GLenum type)
+{
+    return ++null_names;
+}
+
+static void APIENTRY null_attach_shader(GLuint program, GLuint shader)
+{
+}
+
+static void APIENTRY null_compile_shader(GLuint shader)
+{
+}
+
+static void APIENTRY null_shader_source(GLuint shader, GLsizei count,
+                                        const GLchar ** string,
+                                        const GLint * length)
+{
+}
+
+static void APIENTRY null_uniform_1i(GLint location, GLint v0)
+{
+}
+
+static void APIENTRY null_uniform_1f(GLint location, GLfloat v0)
+{
+}
+
+static void APIENTRY null_uniform_2f(GLint location, GLfloat v0, GLfloat v1)
+{
+}
+
+static void APIENTRY null_uniform_4f(GLint location, GLfloat v0, GLfloat v1,
+                                     GLfloat v2, GLfloat v3)
+{
+}
+
+static GLint APIENTRY null_get_uniform_location(GLuint program,
+                                                const GLchar * name)
+{
+    return 0;
+}
+
+PFNGLBLENDEQUATIONSEPARATEEXTPROC __glBlendEquationSeparateEXT =
+    null_blend_equation_separate;
+PFNGLBLENDEQUATIONEXTPROC __glBlendEquationEXT = null_blend_equation;
+PFNGLBLENDFUNCSEPARATEEXTPROC __glBlendFuncSeparateEXT =
+    null_blend_func_separate;
+PFNGLACTIVETEXTUREARBPROC __glActiveTextureARB = null_active_texture;
+PFNGLMULTITEXCOORD2FARBPROC __glMultiTexCoord2fARB = null_multi_texcoord_2f;
+PFNGLGENFRAMEBUFFERSEXTPROC __glGenFramebuffersEXT = null_gen_framebuffers;
+PFNGLFRAMEBUFFERTEXTURE2DEXTPROC __glFramebufferTexture2DEXT =
+    null_framebuffer_texture_2d;
+PFNGLBINDFRAMEBUFFEREXTPROC __glBindFramebufferEXT = null_bind_framebuffer;
+
+PFNGLUSEPROGRAMPROC __glUseProgram = null_use_program;
+PFNGLDETACHSHADERPROC __glDetachShader = null_detach_shader;
+PFNGLGETPROGRAMINFOLOGPROC __glGetProgramInfoLog = null_get_info_log;
+PFNGLGETPROGRAMIVPROC __glGetProgramiv = null_get_program;
+PFNGLLINKPROGRAMPROC __glLinkProgram = null_link_program;
+PFNGLCREATEPROGRAMPROC __glCreateProgram = null_create_program;
+PFNGLATTACHSHADERPROC __glAttachShader = null_attach_shader;
+PFNGLGETSHADERINFOLOGPROC __glGetShaderInfoLog = null_get_info_log;
+PFNGLGETSHADERIVPROC __glGetShaderiv = null_get_shader;
+PFNGLCOMPILESHADERPROC __glCompileShader = null_compile_shader;
+// the constness of the source argument differs between glext.h versions
+PFNGLSHADERSOURCEPROC __glShaderSource =
+    (PFNGLSHADERSOURCEPROC)null_shader_source;
+PFNGLCREATESHADERPROC __glCreateShader = null_create_shader;
+PFNGLUNIFORM1IPROC __glUniform1i = null_uniform_1i;
+PFNGLUNIFORM2FPROC __glUniform2f = null_uniform_2f;
+PFNGLUNIFORM1FPROC __glUniform1f = null_uniform_1f;
+PFNGLUNIFORM4FPROC __glUniform4f = null_uniform_4f;
+PFNGLGETUNIFORMLOCATIONPROC __glGetUniformLocation =
+    null_get_uniform_location;
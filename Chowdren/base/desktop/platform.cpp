@@ -510,6 +510,7 @@ void platform_swap_buffers()
     glEnable(GL_BLEND);
     glDisable(GL_TEXTURE_2D);
 
+    glc_end_frame();
     SDL_GL_SwapWindow(global_window);
 }
 
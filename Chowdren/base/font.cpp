@@ -11,12 +11,19 @@
 
 bool load_fonts(FontList & fonts)
 {
+#ifndef CHOWDREN_ASSET_MAPPING
     AssetFile fp;
     fp.open();
     FileStream stream(fp);
+#endif
 
     for (int i = 0; i < FONT_COUNT; i++) {
+#ifdef CHOWDREN_ASSET_MAPPING
+        AssetView view = get_asset(i, AssetFile::FONT_DATA);
+        MemoryStream stream(view.data, view.size);
+#else
         fp.set_item(i, AssetFile::FONT_DATA);
+#endif
         unsigned int count = stream.read_uint32();
         for (unsigned int i = 0; i < count; i++) {
             FTTextureFont * font = new FTTextureFont(stream);
@@ -236,7 +243,7 @@ inline void FTUnicodeStringItr<T>::readUTF16()
 // FTFont
 
 
-FTFont::FTFont(FileStream & stream)
+FTFont::FTFont(BaseStream & stream)
 {
     glyphList = new FTGlyphContainer(this);
 
@@ -464,7 +471,7 @@ static inline GLuint ClampSize(GLuint in, GLuint maxTextureSize)
 // FTTextureFont
 //
 
-FTTextureFont::FTTextureFont(FileStream & stream)
+FTTextureFont::FTTextureFont(BaseStream & stream)
 : FTFont(stream), maximumGLTextureSize(0), textureWidth(0),
   textureHeight(0), xOffset(0), yOffset(0), padding(3)
 {
@@ -580,8 +587,9 @@ FTPoint FTTextureFont::Render(const wchar_t * string, const int len,
 //
 
 GLint FTGlyph::activeTextureID = 0;
+QuadMesh * FTGlyph::mesh = NULL;
 
-FTGlyph::FTGlyph(FileStream & stream)
+FTGlyph::FTGlyph(BaseStream & stream)
 : glTextureID(0), loaded(false)
 {
     charcode = stream.read_uint32();
@@ -671,14 +679,23 @@ const FTPoint& FTGlyph::Render(const FTPoint& pen)
 {
     float dx, dy;
 
+    dx = floor(pen.Xf() + corner.Xf());
+    dy = floor(pen.Yf() + corner.Yf());
+
+    if (mesh != NULL) {
+        // blank glyphs like spaces only advance the pen
+        if (width == 0 || height == 0)
+            return advance;
+        mesh->add_quad(glTextureID, dx, dy, dx + width, dy - height,
+                       uv[0].Xf(), uv[0].Yf(), uv[1].Xf(), uv[1].Yf());
+        return advance;
+    }
+
     if (activeTextureID != glTextureID) {
         glBindTexture(GL_TEXTURE_2D, (GLuint)glTextureID);
         activeTextureID = glTextureID;
     }
 
-    dx = floor(pen.Xf() + corner.Xf());
-    dy = floor(pen.Yf() + corner.Yf());
-
     glBegin(GL_QUADS);
     glTexCoord2f(uv[0].Xf(), uv[0].Yf());
     glVertex3f(dx, dy, pen.Zf());
@@ -20,6 +20,7 @@ typedef enum
 #include "include_gl.h"
 #include "types.h"
 #include "datastream.h"
+#include "quadmesh.h"
 #include <string>
 
 
@@ -324,7 +325,7 @@ public:
     bool hasKerningTable;
     int numGlyphs;
 
-    FTFont(FileStream & fp);
+    FTFont(BaseStream & fp);
 
     FTPoint KernAdvance(unsigned int index1, unsigned int index2);
 
@@ -371,7 +372,7 @@ public:
     FTBBox bBox;
     char * data;
 
-    FTGlyph(FileStream & stream);
+    FTGlyph(BaseStream & stream);
     void Load(int id, int xOffset, int yOffset, int tex_width, int tex_height);
     ~FTGlyph();
     const FTPoint& Render(const FTPoint& pen);
@@ -379,6 +380,9 @@ public:
     float Advance() const;
     const FTBBox& BBox() const;
 
+    // if set, Render() adds the glyph quads here instead of drawing them
+    static QuadMesh * mesh;
+
 private:
     int width;
     int height;
@@ -402,7 +406,7 @@ public:
     int xOffset;
     int yOffset;
 
-    FTTextureFont(FileStream & stream);
+    FTTextureFont(BaseStream & stream);
     ~FTTextureFont();
     void CalculateTextureSize();
     GLuint CreateTexture();
@@ -411,8 +415,10 @@ public:
     inline FTPoint RenderI(const T* string, const int len,
                            FTPoint position, FTPoint spacing)
     {
-        glEnable(GL_TEXTURE_2D);
-        FTGlyph::ResetActiveTexture();
+        if (FTGlyph::mesh == NULL) {
+            glEnable(GL_TEXTURE_2D);
+            FTGlyph::ResetActiveTexture();
+        }
         FTPoint tmp = FTFont::Render(string, len,
                                      position, spacing);
         return tmp;
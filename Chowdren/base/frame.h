@@ -23,9 +23,13 @@ class Background
 public:
     BackgroundItems items;
     BackgroundItems col_items;
+    Broadphase broadphase;
+    Broadphase col_broadphase;
+    unsigned int paste_index;
 
     Background();
     ~Background();
+    void clear_items(BackgroundItems & items, Broadphase & broadphase);
     void reset(bool clear_items = true);
     void destroy_at(int x, int y);
     void paste(Image * img, int dest_x, int dest_y,
@@ -33,6 +37,7 @@ public:
                int collision_type, const Color & color);
     void draw(int v[4]);
     CollisionBase * collide(CollisionBase * a);
+    CollisionBase * collide(CollisionBase * a, int box[4]);
 };
 
 typedef boost::intrusive::member_hook<FrameObject, LayerPos,
@@ -44,6 +49,9 @@ class Layer
 public:
     LayerInstances instances;
     FlatObjectList background_instances;
+    // sorted instance depths for get_level, rebuilt when instances change
+    vector<unsigned int> levels;
+    bool levels_dirty;
     bool visible;
     double scroll_x, scroll_y;
     Background * back;
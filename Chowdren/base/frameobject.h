@@ -213,7 +213,10 @@ public:
     Layer * layer;
     LayerPos layer_pos;
     Shader * shader;
-    ShaderParameters * shader_parameters;
+    // indexed by get_shader_parameter_slot()
+    double * shader_parameters;
+    // parameters with names the exporter never saw
+    ShaderParameters * extra_shader_parameters;
     int movement_count;
     Movement ** movements;
     Movement * movement;
@@ -244,7 +247,7 @@ public:
     virtual int get_action_y();
     virtual float get_angle();
     virtual void set_angle(float angle, int quality = 0);
-    void create_alterables();
+    void create_alterables(AlterableLayout & layout = full_alterable_layout);
     void set_visible(bool value);
     void set_blend_color(int color);
     virtual void draw();
@@ -258,13 +261,19 @@ public:
     virtual int get_direction();
     bool mouse_over();
     bool overlaps(FrameObject * other);
+    bool overlaps(FrameObject * other, int dx, int dy);
     void set_layer(int layer);
     void set_shader(Shader * shader);
+    void set_shader_parameter(int slot, double value);
+    void set_shader_parameter(int slot, Image & image);
+    void set_shader_parameter(int slot, const Color & color);
+    void set_shader_parameter(int slot, const std::string & path);
     void set_shader_parameter(const std::string & name, double value);
     void set_shader_parameter(const std::string & name, Image & image);
     void set_shader_parameter(const std::string & name, const Color & color);
     void set_shader_parameter(const std::string & name,
                               const std::string & path);
+    double get_shader_parameter(int slot);
     double get_shader_parameter(const std::string & name);
     int get_level();
     void set_level(int index);
@@ -278,6 +287,7 @@ public:
     bool outside_playfield();
     int get_box_index(int index);
     bool overlaps_background();
+    bool overlaps_background(int dx, int dy);
     bool overlaps_background_save();
     void clear_movements();
     void set_movement(int i);
@@ -340,6 +350,15 @@ When the current selection is cleared, the first item points to the end of
 the array, so the most recently added instance is always iterated first.
 The next instance will be set to current_index-1, etc., until the first item
 is met. The first item is then always the last item pointed to by another item.
+
+Removing an instance only leaves a hole in the array. All holes are closed in
+a single pass by compact(), which keeps the order of the remaining instances.
+The number of selected instances is kept up to date by every operation that
+changes the selection, so get_selection_size() does not need to walk it.
+
+A selection always links its instances in descending index order, so a
+selection as big as the list is the default one, and get_selection() can
+index into it directly. Smaller selections are walked up to the index.
 */
 
 class ObjectList
@@ -348,12 +367,15 @@ public:
     FrameObject * back_obj;
     unsigned int saved_start;
     vector<int> saved_items;
+    int selection_size;
+    int removed;
+    int first_removed;
 
     ObjectListItems items;
     typedef ObjectListItems::iterator iterator;
 
     ObjectList()
-    : back_obj(NULL)
+    : back_obj(NULL), selection_size(0), removed(0), first_removed(0)
     {
         items.resize(1);
         ObjectListItem & item = items[0];
@@ -389,6 +411,7 @@ public:
         ObjectListItem & item = items[i];
         item.next = items[0].next;
         items[0].next = i;
+        selection_size++;
     }
 
     ObjectList & clear_selection()
@@ -397,14 +420,19 @@ public:
         items[0].next = size-1;
         for (int i = 1; i < size; i++)
             items[i].next = i-1;
+        selection_size = size-1;
         return *this;
     }
 
-    int get_selection_size();
+    int get_selection_size() const
+    {
+        return selection_size;
+    }
 
     void empty_selection()
     {
         items[0].next = LAST_SELECTED;
+        selection_size = 0;
     }
 
     bool has_selection() const
@@ -452,29 +480,50 @@ public:
         back_obj = NULL;
         items.resize(1);
         items[0].next = LAST_SELECTED;
+        selection_size = 0;
+        removed = 0;
     }
 
     void copy(ObjectList & other)
     {
         back_obj = other.back_obj;
         items = other.items;
+        selection_size = other.selection_size;
     }
 
     void remove(FrameObject * obj)
     {
-        for (int i = obj->index+1; i < int(items.size()); i++) {
-            items[i-1].obj = items[i].obj;
-            items[i].obj->index = i-1;
-        }
+        int i = obj->index;
+        items[i].obj = NULL;
+        if (removed == 0 || i < first_removed)
+            first_removed = i;
+        removed++;
+    }
 
-        items.resize(items.size()-1);
+    void compact()
+    {
+        if (removed == 0)
+            return;
+        int size = items.size();
+        int n = first_removed;
+        for (int i = first_removed+1; i < size; i++) {
+            FrameObject * obj = items[i].obj;
+            if (obj == NULL)
+                continue;
+            items[n].obj = obj;
+            obj->index = n;
+            n++;
+        }
+        items.resize(n);
         back_obj = items.back().obj;
+        removed = 0;
     }
 
     void select_single(FrameObject * obj)
     {
         items[0].next = obj->index;
         items[obj->index].next = LAST_SELECTED;
+        selection_size = 1;
     }
 
     void save_selection();
@@ -527,6 +576,7 @@ public:
     {
         selected = false;
         list.items[last].next = list.items[index].next;
+        list.selection_size--;
     }
 
     bool end() const
@@ -538,24 +588,27 @@ public:
     {
         list.items[0].next = index;
         list.items[index].next = LAST_SELECTED;
+        list.selection_size = 1;
     }
 };
 
 inline FrameObject * ObjectList::get_wrapped_selection(int index)
 {
-    if (!has_selection())
+    if (selection_size <= 0)
         return NULL;
-    while (true) {
-        for (ObjectIterator it(*this); !it.end(); ++it) {
-            if (index == 0)
-                return *it;
-            index--;
-        }
-    }
+    index %= selection_size;
+    if (index < 0)
+        index += selection_size;
+    return get_selection(index);
 }
 
 inline FrameObject * ObjectList::get_selection(int index)
 {
+    if (index < 0 || index >= selection_size)
+        return NULL;
+    // a selection holding every instance is always in the default order
+    if (selection_size == size())
+        return items[selection_size - index].obj;
     for (ObjectIterator it(*this); !it.end(); ++it) {
         if (index == 0)
             return *it;
@@ -564,15 +617,6 @@ inline FrameObject * ObjectList::get_selection(int index)
     return NULL;
 }
 
-inline int ObjectList::get_selection_size()
-{
-    int size = 0;
-    for (ObjectIterator it(*this); !it.end(); ++it) {
-        size++;
-    }
-    return size;
-}
-
 class QualifierList
 {
 public:
@@ -809,6 +853,7 @@ public:
     {
         selected = false;
         list->items[last].next = list->items[index].next;
+        list->selection_size--;
     }
 
     bool end()
@@ -829,28 +874,31 @@ public:
         }
         list->items[0].next = index;
         list->items[index].next = LAST_SELECTED;
+        list->selection_size = 1;
     }
 };
 
 inline FrameObject * QualifierList::get_wrapped_selection(int index)
 {
-    if (!has_selection())
+    int size = get_selection_size();
+    if (size <= 0)
         return NULL;
-    while (true) {
-        for (QualifierIterator it(*this); !it.end(); ++it) {
-            if (index == 0)
-                return *it;
-            index--;
-        }
-    }
+    index %= size;
+    if (index < 0)
+        index += size;
+    return get_selection(index);
 }
 
 inline FrameObject * QualifierList::get_selection(int index)
 {
-    for (QualifierIterator it(*this); !it.end(); ++it) {
-        if (index == 0)
-            return *it;
-        index--;
+    if (index < 0)
+        return NULL;
+    for (int i = 0; i < count; i++) {
+        ObjectList & list = *items[i];
+        int size = list.get_selection_size();
+        if (index < size)
+            return list.get_selection(index);
+        index -= size;
     }
     return NULL;
 }
@@ -878,13 +926,16 @@ inline void ObjectList::restore_selection()
 {
     items[0].next = saved_start;
     int last = saved_start;
+    int size = saved_start == LAST_SELECTED ? 0 : 1;
     for (int i = saved_start-1; i >= 1; i--) {
         if (!saved_items[i-1])
             continue;
         items[last].next = i;
         last = i;
+        size++;
     }
     items[last].next = LAST_SELECTED;
+    selection_size = size;
 }
 
 void setup_default_instance(FrameObject * obj);
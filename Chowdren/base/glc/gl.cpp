@@ -5,6 +5,7 @@
 #include "glslshader.h"
 #include "types.h"
 #include <string.h>
+#include <stddef.h>
 
 struct Vec2
 {
@@ -44,18 +45,172 @@ void glc_copy_color_buffer_rect(unsigned int tex, int x1, int y1, int x2,
 
     int y = WINDOW_HEIGHT - y2;
 
+    glc_flush();
+#ifdef CHOWDREN_USE_GL
     glBindTexture(GL_TEXTURE_2D, tex);
+#else
+    glc_bind_texture(GL_TEXTURE_2D, tex);
+#endif
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height,
                  0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
     glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, x1, y, width, height);
 }
 
+// pooled captures. a capture goes into a texture of exactly its size, so
+// shaders still see the whole texture as the captured area. when no pooled
+// texture has the size, the least recently used one is resized, and a new one
+// is only made when all of them are needed within the same frame. a sprite
+// that keeps changing size therefore costs one reallocation per capture, as
+// with a single shared texture, while steady sizes are only copied into.
+// captures of the same size share a texture, which is fine since each one is
+// drawn before the next copy is made.
+
+// most textures kept in the pool
+#define CAPTURE_POOL_SIZE 8
+// textures that haven't been used for this many frames are freed
+#define CAPTURE_KEEP_FRAMES 120
+
+struct CaptureTexture
+{
+    GLuint tex;
+    int width, height;
+    bool linear;
+    unsigned int frame;
+    unsigned int use;
+};
+
+static vector<CaptureTexture> capture_pool;
+static unsigned int capture_frame = 0;
+static unsigned int capture_use = 0;
+
+static void bind_capture_texture(GLuint tex)
+{
+#ifdef CHOWDREN_USE_GL
+    glBindTexture(GL_TEXTURE_2D, tex);
+#else
+    glc_bind_texture(GL_TEXTURE_2D, tex);
+#endif
+}
+
+static void set_capture_filter(bool linear)
+{
+    GLint filter = linear ? GL_LINEAR : GL_NEAREST;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+}
+
+static CaptureTexture & get_capture_texture(int width, int height,
+                                            bool linear)
+{
+    CaptureTexture * oldest = NULL;
+    vector<CaptureTexture>::iterator it;
+    for (it = capture_pool.begin(); it != capture_pool.end(); ++it) {
+        CaptureTexture & capture = *it;
+        if (capture.width == width && capture.height == height &&
+            capture.linear == linear)
+        {
+            bind_capture_texture(capture.tex);
+            return capture;
+        }
+        if (oldest == NULL || capture.use < oldest->use)
+            oldest = &capture;
+    }
+
+    if (oldest != NULL && (oldest->frame != capture_frame ||
+                           capture_pool.size() >= CAPTURE_POOL_SIZE))
+    {
+        bind_capture_texture(oldest->tex);
+        if (oldest->linear != linear)
+            set_capture_filter(linear);
+        oldest->width = width;
+        oldest->height = height;
+        oldest->linear = linear;
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height,
+                     0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+        return *oldest;
+    }
+
+    CaptureTexture capture;
+    capture.width = width;
+    capture.height = height;
+    capture.linear = linear;
+    glGenTextures(1, &capture.tex);
+    bind_capture_texture(capture.tex);
+    set_capture_filter(linear);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height,
+                 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+    capture_pool.push_back(capture);
+    return capture_pool.back();
+}
+
+unsigned int glc_capture_color_buffer_rect(int x1, int y1, int x2, int y2,
+                                           bool linear)
+{
+    int width = x2 - x1;
+    int height = y2 - y1;
+    if (width <= 0 || height <= 0)
+        return 0;
+
+    int y = WINDOW_HEIGHT - y2;
+
+    glc_flush();
+    CaptureTexture & capture = get_capture_texture(width, height, linear);
+    capture.frame = capture_frame;
+    capture.use = ++capture_use;
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, x1, y, width, height);
+    return capture.tex;
+}
+
+static void end_capture_frame()
+{
+    capture_frame++;
+    vector<CaptureTexture>::iterator it = capture_pool.begin();
+    while (it != capture_pool.end()) {
+        if (capture_frame - it->frame <= CAPTURE_KEEP_FRAMES) {
+            ++it;
+            continue;
+        }
+        glDeleteTextures(1, &it->tex);
+        it = capture_pool.erase(it);
+    }
+}
+
 #ifdef CHOWDREN_USE_GL
 
 void glc_init()
 {
 }
 
+void glc_flush()
+{
+}
+
+void glc_end_frame()
+{
+    end_capture_frame();
+}
+
+static GLCStats gl_stats;
+
+const GLCStats & glc_get_stats()
+{
+    return gl_stats;
+}
+
+void glc_draw_quads(const GLCQuadVertex * vertices, int count)
+{
+    GLsizei stride = sizeof(GLCQuadVertex);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glVertexPointer(2, GL_FLOAT, stride, &vertices[0].x);
+    glTexCoordPointer(2, GL_FLOAT, stride, &vertices[0].u);
+    glDrawArrays(GL_QUADS, 0, count * 4);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+}
+
 #else
 
 inline void mult_matrix(Mat4x4 & m, Mat4x4 & n, Mat4x4 & d)
@@ -141,22 +296,162 @@ public:
 
 static GLState gl_state;
 
+// quad batching
+
+#define BATCH_QUADS 1024
+#define TEXTURE_UNITS 3
+
+struct BatchVertex
+{
+    Vec3 position;
+    Vec4 color;
+    Vec2 texcoord;
+};
+
+class QuadBatch
+{
+public:
+    BatchVertex vertices[BATCH_QUADS * 4];
+    GLushort indices[BATCH_QUADS * 6];
+    GLuint vbo, ibo;
+    int count;
+
+    // batch key
+    bool tex_on;
+    GLuint texture;
+    GLenum blend_src, blend_dst;
+
+    // requested state, applied lazily on the next glc_end
+    GLenum active_unit;
+    GLuint bound[TEXTURE_UNITS];
+    GLenum src, dst;
+
+    QuadBatch()
+    : count(0), tex_on(false), texture(0), blend_src(GL_ONE),
+      blend_dst(GL_ZERO), active_unit(0), src(GL_ONE), dst(GL_ZERO)
+    {
+        for (int i = 0; i < TEXTURE_UNITS; i++)
+            bound[i] = 0;
+    }
+};
+
+static QuadBatch batch;
+static GLCStats gl_stats;
+static GLCStats frame_stats;
+
 void glc_init()
 {
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    for (int i = 0; i < BATCH_QUADS; i++) {
+        GLushort * index = &batch.indices[i * 6];
+        GLushort v = i * 4;
+        // same triangles as a GL_TRIANGLE_FAN over the quad
+        index[0] = v;
+        index[1] = v + 1;
+        index[2] = v + 2;
+        index[3] = v;
+        index[4] = v + 2;
+        index[5] = v + 3;
+    }
+
+    glGenBuffers(1, &batch.ibo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch.ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(batch.indices),
+                 batch.indices, GL_STATIC_DRAW);
+
+    glGenBuffers(1, &batch.vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, batch.vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(batch.vertices), NULL,
+                 GL_STREAM_DRAW);
+
+    GLsizei stride = sizeof(BatchVertex);
     glEnableVertexAttribArray(POSITION_ATTRIB_IDX);
-    glVertexAttribPointer(POSITION_ATTRIB_IDX, 3, GL_FLOAT, GL_FALSE, 0,
-                          (void*)&gl_state.vertices[0]);
+    glVertexAttribPointer(POSITION_ATTRIB_IDX, 3, GL_FLOAT, GL_FALSE, stride,
+                          (void*)offsetof(BatchVertex, position));
 
     glEnableVertexAttribArray(COLOR_ATTRIB_IDX);
-    glVertexAttribPointer(COLOR_ATTRIB_IDX, 4, GL_FLOAT, GL_FALSE, 0,
-                          (void*)&gl_state.colors[0]);
+    glVertexAttribPointer(COLOR_ATTRIB_IDX, 4, GL_FLOAT, GL_FALSE, stride,
+                          (void*)offsetof(BatchVertex, color));
+
+    glVertexAttribPointer(TEXCOORD1_ATTRIB_IDX, 2, GL_FLOAT, GL_FALSE, stride,
+                          (void*)offsetof(BatchVertex, texcoord));
+}
+
+static void draw_batch()
+{
+    int count = batch.count;
+    // reset first, the shader calls below end up in glc_flush() again
+    batch.count = 0;
+
+    GLSLShader * shader;
+    if (batch.tex_on)
+        shader = (GLSLShader*)texture_shader;
+    else
+        shader = (GLSLShader*)basic_shader;
+    shader->begin(NULL, 0, 0); // we don't actually need these parameters
+
+    // orphan the old storage so we don't stall on the previous draw
+    glBufferData(GL_ARRAY_BUFFER, sizeof(batch.vertices), NULL,
+                 GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, count * 4 * sizeof(BatchVertex),
+                    batch.vertices);
+
+    if (batch.tex_on)
+        glEnableVertexAttribArray(TEXCOORD1_ATTRIB_IDX);
+
+    glDrawElements(GL_TRIANGLES, count * 6, GL_UNSIGNED_SHORT, 0);
+
+    if (batch.tex_on)
+        glDisableVertexAttribArray(TEXCOORD1_ATTRIB_IDX);
+
+    shader->end(NULL);
+
+#ifdef CHOWDREN_IS_3DS
+    glFinish();
+#endif
+
+    frame_stats.draw_calls++;
+}
+
+void glc_flush()
+{
+    if (batch.count == 0)
+        return;
+    frame_stats.flushes++;
+    draw_batch();
+}
 
-    glVertexAttribPointer(TEXCOORD1_ATTRIB_IDX, 2, GL_FLOAT, GL_FALSE, 0,
-                          (void*)&gl_state.texcoords[0]);
+void glc_end_frame()
+{
+    glc_flush();
+    end_capture_frame();
+    gl_stats = frame_stats;
+    frame_stats = GLCStats();
+}
+
+const GLCStats & glc_get_stats()
+{
+    return gl_stats;
+}
 
-    glVertexAttribPointer(TEXCOORD2_ATTRIB_IDX, 2, GL_FLOAT, GL_FALSE, 0,
-                          (void*)&gl_state.texcoords[1]);
+void glc_bind_texture(GLenum target, GLuint texture)
+{
+    if (batch.active_unit == 0 && batch.tex_on && texture != batch.texture)
+        glc_flush();
+    if (batch.active_unit < TEXTURE_UNITS)
+        batch.bound[batch.active_unit] = texture;
+    glBindTexture(target, texture);
+}
+
+void glc_active_texture(GLenum unit)
+{
+    batch.active_unit = unit - GL_TEXTURE0;
+    glActiveTexture(unit);
+}
+
+void glc_blend_func(GLenum src, GLenum dst)
+{
+    batch.src = src;
+    batch.dst = dst;
 }
 
 void glc_enable(GLenum cap)
@@ -168,6 +463,7 @@ void glc_enable(GLenum cap)
         default:
             break;
     }
+    glc_flush();
     glEnable(cap);
 }
 
@@ -180,6 +476,7 @@ void glc_disable(GLenum cap)
         default:
             break;
     }
+    glc_flush();
     glDisable(cap);
 }
 
@@ -219,41 +516,63 @@ void glc_begin(GLenum mode)
     mult_matrix(gl_state.projection, gl_state.modelview, mvp);
 }
 
-void glc_end()
+// returns the next quad of the batch, drawing the pending quads first if the
+// state changed since they were added or the batch is full
+static BatchVertex * add_quad()
 {
-    bool is_platform = false;
-    GLSLShader * shader = GLSLShader::current;
-    // if (shader == NULL) {
-    is_platform = true;
-    if (gl_state.tex_on) {
-        shader = (GLSLShader*)texture_shader;
-    } else {
-        shader = (GLSLShader*)basic_shader;
+    bool tex_on = gl_state.tex_on;
+    GLuint texture = batch.bound[0];
+
+    if (batch.count > 0) {
+        if (batch.count == BATCH_QUADS)
+            draw_batch();
+        else if (tex_on != batch.tex_on ||
+                 (tex_on && texture != batch.texture) ||
+                 batch.src != batch.blend_src ||
+                 batch.dst != batch.blend_dst)
+            glc_flush();
     }
-    shader->begin(NULL, 0, 0); // we don't actually need these parameters
-    // }
-
-    if (shader != basic_shader)
-        glEnableVertexAttribArray(TEXCOORD1_ATTRIB_IDX);
-
-    if (shader->flags & SHADER_HAS_BACK)
-        glEnableVertexAttribArray(TEXCOORD2_ATTRIB_IDX);
 
+    if (batch.src != batch.blend_src || batch.dst != batch.blend_dst) {
+        batch.blend_src = batch.src;
+        batch.blend_dst = batch.dst;
+        glBlendFunc(batch.src, batch.dst);
+    }
 
-    // drawing
-    glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+    batch.tex_on = tex_on;
+    batch.texture = texture;
 
-    if (shader != basic_shader)
-        glDisableVertexAttribArray(TEXCOORD1_ATTRIB_IDX);
-    if (shader->flags & SHADER_HAS_BACK)
-        glDisableVertexAttribArray(TEXCOORD2_ATTRIB_IDX);
+    BatchVertex * v = &batch.vertices[batch.count * 4];
+    batch.count++;
+    frame_stats.quads++;
+    return v;
+}
 
-    if (is_platform)
-        shader->end(NULL);
+void glc_end()
+{
+    BatchVertex * v = add_quad();
+    for (int i = 0; i < 4; i++) {
+        v[i].position = gl_state.vertices[i];
+        v[i].color = gl_state.colors[i];
+        v[i].texcoord = gl_state.texcoords[0][i];
+    }
+}
 
-#ifdef CHOWDREN_IS_3DS
-    glFinish();
-#endif
+void glc_draw_quads(const GLCQuadVertex * vertices, int count)
+{
+    mult_matrix(gl_state.projection, gl_state.modelview, mvp);
+    for (int i = 0; i < count; i++) {
+        BatchVertex * v = add_quad();
+        for (int j = 0; j < 4; j++) {
+            const GLCQuadVertex & src = vertices[j];
+            Vec3 pos = {src.x, src.y, 0.0f};
+            Vec2 tc = {src.u, src.v};
+            mult_matrix(mvp, pos, v[j].position);
+            v[j].color = gl_state.current_color;
+            v[j].texcoord = tc;
+        }
+        vertices += 4;
+    }
 }
 
 void glc_load_identity()
@@ -410,5 +729,6 @@ void glc_scissor_world(int x, int y, int w, int h)
     w_y = int_max(0, int_min(w_y, WINDOW_HEIGHT));
     w_y2 = int_max(0, int_min(w_y2, WINDOW_HEIGHT));
 
+    glc_flush();
     glScissor(w_x, w_y, w_x2 - w_x, w_y2 - w_y);
 }
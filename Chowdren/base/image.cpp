@@ -3,6 +3,7 @@
 #include "string.h"
 #include "color.h"
 #include <iostream>
+#include <algorithm>
 #include <stdio.h>
 #include "datastream.h"
 #include "chowconfig.h"
@@ -15,6 +16,14 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
+#if defined(CHOWDREN_IS_DESKTOP) && !defined(CHOWDREN_IS_EMSCRIPTEN)
+#define CHOWDREN_IMAGE_WORKERS
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/bind.hpp>
+#endif
+
 inline unsigned char * load_image(FSFile & image_file, int size,
                                   int * w, int * h, int * channels)
 {
@@ -25,17 +34,182 @@ inline unsigned char * load_image(FSFile & image_file, int size,
     return out;
 }
 
+#ifdef CHOWDREN_ASSET_MAPPING
+inline unsigned char * load_image(MemoryStream & stream, int size,
+                                  int * w, int * h, int * channels)
+{
+    const stbi_uc * buf = (const stbi_uc*)stream.get_pointer(size);
+    return stbi_load_from_memory(buf, size, w, h, channels, 4);
+}
+#endif
+
 typedef vector<Image*> ImageList;
 
 static AssetFile image_file;
 
 void open_image_file()
 {
+#ifdef CHOWDREN_ASSET_MAPPING
+    open_asset_map();
+#else
     if (image_file.is_open())
         return;
     image_file.open();
+#endif
+}
+
+#ifndef CHOWDREN_IS_WIIU
+
+// AlphaMask
+
+void AlphaMask::create(const unsigned char * image, int width, int height)
+{
+    stride = (width + 63) / 64;
+    data.assign(stride * height, 0);
+    for (int y = 0; y < height; y++) {
+        uint64_t * row = &data[y * stride];
+        const unsigned char * c = image + y * width * 4 + 3;
+        for (int x = 0; x < width; x++) {
+            if (c[x * 4] != 0)
+                row[x >> 6] |= uint64_t(1) << (x & 63);
+        }
+    }
+}
+
+void AlphaMask::create_bits(const unsigned char * bits, int width, int height)
+{
+    stride = (width + 63) / 64;
+    data.assign(stride * height, 0);
+    int i = 0;
+    for (int y = 0; y < height; y++) {
+        uint64_t * row = &data[y * stride];
+        for (int x = 0; x < width; x++) {
+            if (bits[i >> 3] & (1 << (i & 7)))
+                row[x >> 6] |= uint64_t(1) << (x & 63);
+            i++;
+        }
+    }
+}
+
+#endif
+
+#ifdef CHOWDREN_TEXTURE_ATLAS
+
+// AtlasPage
+
+static AtlasPage atlas_pages[ATLAS_ARRAY_SIZE];
+
+unsigned char * AtlasPage::load_pixels(int * w, int * h)
+{
+    open_image_file();
+#ifdef CHOWDREN_ASSET_MAPPING
+    AssetView view = get_asset(index, AssetFile::ATLAS_DATA);
+    MemoryStream stream(view.data, view.size);
+    int size = stream.read_uint32();
+    int channels;
+    unsigned char * pixels = load_image(stream, size, w, h, &channels);
+#else
+    image_file.set_item(index, AssetFile::ATLAS_DATA);
+    FileStream stream(image_file);
+    int size = stream.read_uint32();
+    int channels;
+    unsigned char * pixels = load_image(image_file, size, w, h, &channels);
+#endif
+    if (pixels == NULL) {
+        std::cout << "Could not load atlas " << index << std::endl;
+        std::cout << stbi_failure_reason() << std::endl;
+    }
+    return pixels;
+}
+
+void AtlasPage::acquire()
+{
+    refs++;
+    if (tex != 0)
+        return;
+
+    unsigned char * pixels = load_pixels(&width, &height);
+    if (pixels == NULL)
+        return;
+
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, pixels);
+
+    if (Image::DEFAULT_FLAGS & Image::LINEAR_FILTER) {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    } else {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    stbi_image_free(pixels);
+}
+
+// unpacking an image needs the pixels of its whole page. the last decoded
+// page is kept until another page is unpacked from, its texture is freed or
+// nothing has been unpacked from it for ATLAS_PIXELS_KEEP_FRAMES frames, so
+// unpacking several images from a page decodes it once.
+
+#define ATLAS_PIXELS_KEEP_FRAMES 60
+
+static AtlasPage * pixels_page = NULL;
+static unsigned char * page_pixels = NULL;
+static int page_pixels_age = 0;
+
+static void free_page_pixels()
+{
+    if (page_pixels == NULL)
+        return;
+    stbi_image_free(page_pixels);
+    page_pixels = NULL;
+    pixels_page = NULL;
+}
+
+static unsigned char * get_page_pixels(AtlasPage * page)
+{
+    page_pixels_age = 0;
+    if (pixels_page == page)
+        return page_pixels;
+    free_page_pixels();
+    page_pixels = page->load_pixels(&page->width, &page->height);
+    if (page_pixels != NULL)
+        pixels_page = page;
+    return page_pixels;
+}
+
+void AtlasPage::release()
+{
+    refs--;
+    if (refs > 0 || tex == 0)
+        return;
+    glDeleteTextures(1, &tex);
+    tex = 0;
+    if (pixels_page == this)
+        free_page_pixels();
+}
+
+inline void get_atlas_coords(Image * image, const float * src, float * dst)
+{
+    AtlasPage * atlas = image->atlas;
+    float u = float(image->atlas_x) / float(atlas->width);
+    float v = float(image->atlas_y) / float(atlas->height);
+    float w = float(image->width) / float(atlas->width);
+    float h = float(image->height) / float(atlas->height);
+    for (int i = 0; i < 8; i += 2) {
+        dst[i] = u + src[i] * w;
+        dst[i+1] = v + src[i+1] * h;
+    }
 }
 
+#endif
+
+// Image
+
 // dummy constructor
 Image::Image()
 : handle(0), flags(DEFAULT_FLAGS), tex(0), image(NULL), width(0), height(0),
@@ -80,6 +254,8 @@ Image * Image::copy()
             new_image = new Image(handle);
         }
         new_image->load();
+        // color replacement and friends need the pixels
+        new_image->unpack_atlas();
         return new_image;
     }
     new_image = new Image();
@@ -101,7 +277,7 @@ void Image::load()
 {
     flags |= USED;
 
-    if (tex != 0 || image != NULL)
+    if (tex != 0 || image != NULL || (flags & ATLAS))
         return;
 
     if (flags & FILE) {
@@ -110,18 +286,61 @@ void Image::load()
     }
 
     open_image_file();
-    image_file.set_item(handle, AssetFile::IMAGE_DATA);
-    FileStream stream(image_file);
+    load_data(image_file);
+}
+
+void Image::load_data(AssetFile & fp)
+{
+#ifdef CHOWDREN_ASSET_MAPPING
+    // fp is unused, the data is read straight from the asset map
+    AssetView view = get_asset(handle, AssetFile::IMAGE_DATA);
+    MemoryStream stream(view.data, view.size);
+#else
+    fp.set_item(handle, AssetFile::IMAGE_DATA);
+    FileStream stream(fp);
+#endif
 
     hotspot_x = stream.read_int16();
     hotspot_y = stream.read_int16();
     action_x = stream.read_int16();
     action_y = stream.read_int16();
 
+#ifdef CHOWDREN_TEXTURE_ATLAS
+    int page = stream.read_int16();
+    if (page != -1) {
+        atlas = &atlas_pages[page];
+        atlas->index = page;
+        atlas_x = stream.read_int16();
+        atlas_y = stream.read_int16();
+        width = stream.read_int16();
+        height = stream.read_int16();
+        flags |= ATLAS;
+
+#ifndef CHOWDREN_IS_WIIU
+        int bits_size = (width * height + 7) / 8;
+#ifdef CHOWDREN_ASSET_MAPPING
+        const unsigned char * bits =
+            (const unsigned char*)stream.get_pointer(bits_size);
+        alpha.create_bits(bits, width, height);
+#else
+        unsigned char * bits = new unsigned char[bits_size];
+        fp.read(bits, bits_size);
+        alpha.create_bits(bits, width, height);
+        delete[] bits;
+#endif
+#endif
+        return;
+    }
+#endif
+
     int size = stream.read_uint32();
 
     int w, h, channels;
-    image = load_image(image_file, size, &w, &h, &channels);
+#ifdef CHOWDREN_ASSET_MAPPING
+    image = load_image(stream, size, &w, &h, &channels);
+#else
+    image = load_image(fp, size, &w, &h, &channels);
+#endif
 
     width = w;
     height = h;
@@ -135,6 +354,14 @@ void Image::load()
 
 void Image::unload()
 {
+#ifdef CHOWDREN_TEXTURE_ATLAS
+    if (flags & ATLAS) {
+        if (tex != 0)
+            atlas->release();
+        tex = 0;
+        flags &= ~ATLAS;
+    }
+#endif
     if (image != NULL)
         stbi_image_free(image);
     if (tex != 0)
@@ -143,7 +370,7 @@ void Image::unload()
     tex = 0;
 
 #ifndef CHOWDREN_IS_WIIU
-    boost::dynamic_bitset<>().swap(alpha);
+    alpha.clear();
 #endif
 }
 
@@ -163,18 +390,49 @@ void Image::replace(const Color & from, const Color & to)
     }
 }
 
+void Image::unpack_atlas()
+{
+#ifdef CHOWDREN_TEXTURE_ATLAS
+    if (!(flags & ATLAS))
+        return;
+
+    unsigned int * pixels = (unsigned int*)get_page_pixels(atlas);
+    if (pixels != NULL) {
+        image = (unsigned char*)malloc(width * height * 4);
+        unsigned int * image_arr = (unsigned int*)image;
+        for (int y = 0; y < height; y++)
+            memcpy(&image_arr[y * width],
+                   &pixels[atlas_x + (atlas_y + y) * atlas->width],
+                   width * 4);
+    }
+
+    // releasing the last texture reference also drops the page pixels
+    if (tex != 0)
+        atlas->release();
+    tex = 0;
+    flags &= ~ATLAS;
+#endif
+}
+
 void Image::upload_texture()
 {
+#ifdef CHOWDREN_TEXTURE_ATLAS
+    if (flags & ATLAS) {
+        if (tex != 0)
+            return;
+        atlas->acquire();
+        tex = atlas->tex;
+        return;
+    }
+#endif
+
     if (tex != 0 || image == NULL)
         return;
 
 #ifndef CHOWDREN_IS_WIIU
-    // create alpha mask
-    alpha.resize(width * height);
-    for (int i = 0; i < width * height; i++) {
-        unsigned char c = ((unsigned char*)(((unsigned int*)image) + i))[3];
-        alpha.set(i, c != 0);
-    }
+    // create alpha mask, unless a decode worker already did
+    if (alpha.empty())
+        alpha.create(image, width, height);
 #endif
 
     int gl_width, gl_height;
@@ -245,6 +503,11 @@ void Image::set_filter(bool linear)
         flags |= LINEAR_FILTER;
     else
         flags &= ~LINEAR_FILTER;
+    if (flags & ATLAS) {
+        // pages use the default filter
+        unpack_atlas();
+        upload_texture();
+    }
     if (tex == 0)
         return;
     glBindTexture(GL_TEXTURE_2D, tex);
@@ -328,26 +591,32 @@ void Image::draw(int x, int y, float angle, float scale_x, float scale_y,
 
     glBegin(GL_QUADS);
 
-#ifdef CHOWDREN_NO_NPOT
-    float tex_coords[8];
-    if (flip_x) {
-        memcpy(tex_coords, flipped_texcoords, sizeof(tex_coords));
-    } else {
-        memcpy(tex_coords, normal_texcoords, sizeof(tex_coords));
-    }
-    float u = float(width) / float(pot_w);
-    float v = float(height) / float(pot_h);
-    for (int i = 0; i < 8; i += 2) {
-        tex_coords[i] *= u;
-        tex_coords[i+1] *= v;
-    }
-#else
     const float * tex_coords;
     if (flip_x) {
         tex_coords = flipped_texcoords;
     } else {
         tex_coords = normal_texcoords;
     }
+
+#ifdef CHOWDREN_TEXTURE_ATLAS
+    float atlas_coords[8];
+    if (flags & ATLAS) {
+        get_atlas_coords(this, tex_coords, atlas_coords);
+        tex_coords = atlas_coords;
+    }
+#endif
+
+#ifdef CHOWDREN_NO_NPOT
+    float pot_coords[8];
+    if (!(flags & ATLAS)) {
+        float u = float(width) / float(pot_w);
+        float v = float(height) / float(pot_h);
+        for (int i = 0; i < 8; i += 2) {
+            pot_coords[i] = tex_coords[i] * u;
+            pot_coords[i+1] = tex_coords[i+1] * v;
+        }
+        tex_coords = pot_coords;
+    }
 #endif
 
     glTexCoord2f(tex_coords[0], tex_coords[1]);
@@ -407,6 +676,14 @@ void Image::draw(int x, int y, int src_x, int src_y, int w, int h)
     float t_x2 = t_x1 + float(w) / float(width);
     float t_y1 = float(src_y) / float(height);
     float t_y2 = t_y1 + float(h) / float(height);
+#ifdef CHOWDREN_TEXTURE_ATLAS
+    if (flags & ATLAS) {
+        t_x1 = float(atlas_x + src_x) / float(atlas->width);
+        t_x2 = t_x1 + float(w) / float(atlas->width);
+        t_y1 = float(atlas_y + src_y) / float(atlas->height);
+        t_y2 = t_y1 + float(h) / float(atlas->height);
+    }
+#endif
     glTexCoord2f(t_x1, t_y1);
     glVertex2i(x, y);
     glTexCoord2f(t_x2, t_y1);
@@ -421,7 +698,7 @@ void Image::draw(int x, int y, int src_x, int src_y, int w, int h)
 
 bool Image::is_valid()
 {
-    return image != NULL || tex != 0;
+    return image != NULL || tex != 0 || (flags & ATLAS);
 }
 
 // FileImage
@@ -524,6 +801,9 @@ void reset_image_cache()
 
 void flush_image_cache()
 {
+#ifdef CHOWDREN_TEXTURE_ATLAS
+    free_page_pixels();
+#endif
 #ifdef CHOWDREN_TEXTURE_GC
     for (int i = 0; i < IMAGE_COUNT; i++) {
         Image * image = internal_images[i];
@@ -534,22 +814,207 @@ void flush_image_cache()
 #endif
 }
 
+void end_image_frame()
+{
+#ifdef CHOWDREN_TEXTURE_ATLAS
+    if (page_pixels == NULL)
+        return;
+    page_pixels_age++;
+    if (page_pixels_age > ATLAS_PIXELS_KEEP_FRAMES)
+        free_page_pixels();
+#endif
+}
+
+// image loading in batches. the asset data is read and decoded on worker
+// threads, each with its own handle to the asset file (or reading from the
+// shared asset map), and only the texture uploads happen on the calling
+// thread.
+
+#define LOAD_BATCH_SIZE 64
+#define MAX_IMAGE_WORKERS 8
+
+#ifdef CHOWDREN_IMAGE_WORKERS
+
+// the workers are started on the first batch and then wait for the next one,
+// so loading a frame doesn't create threads for every batch
+struct DecodePool
+{
+    Image ** images;
+    int count;
+    int next;
+    // images taken but not decoded yet
+    int active;
+    int workers;
+    boost::mutex lock;
+    boost::condition_variable work;
+    boost::condition_variable done;
+
+    DecodePool()
+    : images(NULL), count(0), next(0), active(0), workers(0)
+    {
+    }
+};
+
+// never freed, the workers may still be waiting on it at exit
+static DecodePool & decode_pool = *new DecodePool;
+
+static void decode_worker(DecodePool * pool)
+{
+    AssetFile fp;
+#ifndef CHOWDREN_ASSET_MAPPING
+    fp.open();
+#endif
+    boost::mutex::scoped_lock guard(pool->lock);
+    while (true) {
+        while (pool->next >= pool->count)
+            pool->work.wait(guard);
+        Image * image = pool->images[pool->next++];
+        pool->active++;
+        guard.unlock();
+
+        image->load_data(fp);
+#ifndef CHOWDREN_IS_WIIU
+        if (image->image != NULL)
+            image->alpha.create(image->image, image->width, image->height);
+#endif
+
+        guard.lock();
+        pool->active--;
+        if (pool->next >= pool->count && pool->active == 0)
+            pool->done.notify_all();
+    }
+}
+
+static int start_decode_workers()
+{
+    if (decode_pool.workers != 0)
+        return decode_pool.workers;
+    int workers = std::min<int>(MAX_IMAGE_WORKERS,
+                                boost::thread::hardware_concurrency());
+    decode_pool.workers = std::max(1, workers);
+    if (decode_pool.workers == 1)
+        return 1;
+    // the asset offsets (and the asset map) are set up when the shared
+    // file is first opened
+    open_image_file();
+    // the workers live as long as the process
+    for (int i = 0; i < decode_pool.workers; i++) {
+        boost::thread thread(boost::bind(decode_worker, &decode_pool));
+        thread.detach();
+    }
+    return decode_pool.workers;
+}
+
+#endif
+
+static void decode_images(Image ** images, int count)
+{
+#ifdef CHOWDREN_IMAGE_WORKERS
+    if (count > 1 && start_decode_workers() > 1) {
+        boost::mutex::scoped_lock guard(decode_pool.lock);
+        decode_pool.images = images;
+        decode_pool.count = count;
+        decode_pool.next = 0;
+        decode_pool.work.notify_all();
+        while (decode_pool.next < count || decode_pool.active != 0)
+            decode_pool.done.wait(guard);
+        decode_pool.images = NULL;
+        decode_pool.count = 0;
+        decode_pool.next = 0;
+        return;
+    }
+#endif
+    for (int i = 0; i < count; i++)
+        images[i]->load();
+}
+
+// returns the number of handles that were processed before running out of
+// video memory
+
+static int load_batch(const unsigned short * handles, int count,
+                      bool upload, bool check_vram)
+{
+    Image * pending[LOAD_BATCH_SIZE];
+    int pending_count = 0;
+    for (int i = 0; i < count; i++) {
+        unsigned int handle = handles[i];
+        if (internal_images[handle] == NULL) {
+            internal_images[handle] = new Image(handle);
+            internal_images[handle]->flags |= Image::CACHED;
+        }
+        Image * image = internal_images[handle];
+        image->flags |= Image::USED;
+        if (image->tex != 0 || image->image != NULL ||
+            (image->flags & Image::ATLAS))
+            continue;
+        // a handle listed twice must not be decoded by two workers at once
+        if (std::find(pending, pending + pending_count, image) !=
+            pending + pending_count)
+            continue;
+        pending[pending_count++] = image;
+    }
+
+    decode_images(pending, pending_count);
+
+    if (!upload)
+        return count;
+
+    for (int i = 0; i < count; i++) {
+        Image * image = internal_images[handles[i]];
+        image->upload_texture();
+        if (!check_vram)
+            continue;
+        if (!glc_is_vram_full()) {
+            image->set_static();
+            continue;
+        }
+        // drop the pixels nobody is going to upload
+        for (int ii = i + 1; ii < count; ii++) {
+            Image * image = internal_images[handles[ii]];
+            if (image->tex == 0)
+                image->unload();
+        }
+        return i;
+    }
+    return count;
+}
+
+void load_images(const unsigned short * handles, int count, bool upload)
+{
+    for (int i = 0; i < count; i += LOAD_BATCH_SIZE) {
+        int n = std::min(LOAD_BATCH_SIZE, count - i);
+        load_batch(handles + i, n, upload, false);
+    }
+}
+
 void preload_images()
 {
 #ifdef CHOWDREN_PRELOAD_IMAGES
     AssetFile fp;
     fp.open();
     FileStream stream(fp);
-    glc_set_storage(true);
-    for (int i = 0; i < IMAGE_COUNT; i++) {
-        unsigned short handle = stream.read_uint16();
-        Image * image = get_internal_image(handle);
-        image->upload_texture();
-#ifndef CHOWDREN_PRELOAD_ALL
-        if (glc_is_vram_full())
-            break;
+    static unsigned short handles[IMAGE_ARRAY_SIZE];
+    for (int i = 0; i < IMAGE_COUNT; i++)
+        handles[i] = stream.read_uint16();
+    fp.close();
+
+#ifdef CHOWDREN_PRELOAD_ALL
+    bool check_vram = false;
+#else
+    bool check_vram = true;
 #endif
-        image->set_static();
+
+    glc_set_storage(true);
+    for (int i = 0; i < IMAGE_COUNT; i += LOAD_BATCH_SIZE) {
+        int n = std::min(LOAD_BATCH_SIZE, IMAGE_COUNT - i);
+        if (check_vram) {
+            if (load_batch(handles + i, n, true, true) < n)
+                break;
+            continue;
+        }
+        load_batch(handles + i, n, true, false);
+        for (int ii = i; ii < i + n; ii++)
+            internal_images[handles[ii]]->set_static();
     }
     glc_set_storage(false);
 #endif
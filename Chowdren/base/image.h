@@ -8,15 +8,91 @@
 #include "types.h"
 #include "platform.h"
 #include "chowconfig.h"
-#include <boost/dynamic_bitset.hpp>
 
 const std::string & get_image_path();
 void set_image_path(const std::string & path);
 void initialize_images();
 
+class AssetFile;
+
 extern const float normal_texcoords[8];
 extern const float back_texcoords[8];
 
+#ifndef CHOWDREN_IS_WIIU
+
+// alpha mask packed into 64-bit words, with every row starting on a new word.
+// pixel x of a row is bit (x & 63) of word (x >> 6).
+
+class AlphaMask
+{
+public:
+    vector<uint64_t> data;
+    int stride;
+
+    AlphaMask()
+    : stride(0)
+    {
+    }
+
+    void create(const unsigned char * image, int width, int height);
+    void create_bits(const unsigned char * bits, int width, int height);
+
+    void clear()
+    {
+        vector<uint64_t>().swap(data);
+        stride = 0;
+    }
+
+    bool empty() const
+    {
+        return data.empty();
+    }
+
+    bool test(int x, int y) const
+    {
+        return ((data[y * stride + (x >> 6)] >> (x & 63)) & 1) != 0;
+    }
+
+    // returns the 64 pixels starting at x, with pixels past the end of the
+    // row set to 0
+    uint64_t get_bits(int x, int y) const
+    {
+        const uint64_t * row = &data[y * stride];
+        int word = x >> 6;
+        int shift = x & 63;
+        uint64_t bits = row[word] >> shift;
+        if (shift != 0 && word + 1 < stride)
+            bits |= row[word + 1] << (64 - shift);
+        return bits;
+    }
+};
+
+#endif
+
+#ifdef CHOWDREN_TEXTURE_ATLAS
+
+// texture page shared by the images the exporter packed into it
+
+class AtlasPage
+{
+public:
+    int index;
+    int refs;
+    int width, height;
+    GLuint tex;
+
+    AtlasPage()
+    : refs(0), width(0), height(0), tex(0)
+    {
+    }
+
+    unsigned char * load_pixels(int * w, int * h);
+    void acquire();
+    void release();
+};
+
+#endif
+
 class Image
 {
 public:
@@ -28,6 +104,7 @@ public:
         STATIC = 1 << 3,
         KEEP = 1 << 4,
         LINEAR_FILTER = 1 << 5,
+        ATLAS = 1 << 6,
 #ifdef CHOWDREN_QUICK_SCALE
         DEFAULT_FLAGS = 0
 #else
@@ -42,13 +119,18 @@ public:
     GLuint tex;
     unsigned char * image;
 #ifndef CHOWDREN_IS_WIIU
-    boost::dynamic_bitset<> alpha;
+    AlphaMask alpha;
 #endif
 
 #ifdef CHOWDREN_NO_NPOT
     short pot_w, pot_h;
 #endif
 
+#ifdef CHOWDREN_TEXTURE_ATLAS
+    AtlasPage * atlas;
+    short atlas_x, atlas_y;
+#endif
+
     Image();
     Image(int hot_x, int hot_y, int act_x, int act_y);
     Image(int handle);
@@ -57,8 +139,10 @@ public:
     Image * copy();
     void replace(const Color & from, const Color & to);
     void load();
+    void load_data(AssetFile & fp);
     void set_static();
     void upload_texture();
+    void unpack_atlas();
     void draw(int x1, int y1, int x2, int y2, bool flip_x, bool flip_y,
               GLuint back = 0, bool has_tex_param = false);
     void draw(int x, int y, float angle = 0.0f,
@@ -82,7 +166,7 @@ public:
         }
     #else
         if (!alpha.empty())
-            return alpha.test(y * width + x);
+            return alpha.test(x, y);
     #endif
         unsigned int * v = (unsigned int*)image + y * width + x;
         unsigned char c = ((unsigned char*)v)[3];
@@ -106,7 +190,10 @@ Image * get_image_cache(const std::string & filename, int hot_x, int hot_y,
                             int act_x, int act_y, TransparentColor color);
 void reset_image_cache();
 void flush_image_cache();
+void end_image_frame();
 void preload_images();
+void load_images(const unsigned short * handles, int count,
+                 bool upload = true);
 
 extern Image dummy_image;
 
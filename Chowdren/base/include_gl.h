@@ -70,6 +70,39 @@ void glc_rotate_f(GLfloat angle, GLfloat x, GLfloat y, GLfloat z);
 void glc_set_global_depth(GLfloat depth);
 void glc_set_depth(GLfloat depth);
 
+struct GLCStats
+{
+    int quads;
+    int draw_calls;
+    int flushes;
+
+    GLCStats()
+    : quads(0), draw_calls(0), flushes(0)
+    {
+    }
+};
+
+void glc_flush();
+void glc_end_frame();
+const GLCStats & glc_get_stats();
+
+struct GLCQuadVertex
+{
+    GLfloat x, y;
+    GLfloat u, v;
+};
+
+#ifdef CHOWDREN_IS_DESKTOP
+// draws textured quads (4 vertices each) with the current color and texture
+void glc_draw_quads(const GLCQuadVertex * vertices, int count);
+#endif
+
+#ifdef CHOWDREN_USE_GLES2
+void glc_bind_texture(GLenum target, GLuint texture);
+void glc_active_texture(GLenum unit);
+void glc_blend_func(GLenum src, GLenum dst);
+#endif
+
 #ifdef CHOWDREN_USE_GLES2
 #define glPushMatrix glc_push_matrix
 #define glMatrixMode glc_matrix_mode
@@ -83,6 +116,7 @@ void glc_set_depth(GLfloat depth);
 #define glScalef glc_scale_f
 #define glScaled glc_scale_f
 #define glRotated glc_rotate_f
+#define glRotatef glc_rotate_f
 #endif
 
 #if defined(CHOWDREN_USE_GLES1) || defined(CHOWDREN_USE_GLES2)
@@ -132,6 +166,30 @@ void glc_set_depth(GLfloat depth);
 #ifdef CHOWDREN_USE_GLES2
 #define glDisable glc_disable
 #define glEnable glc_enable
+#define glBindTexture glc_bind_texture
+#define glActiveTexture glc_active_texture
+#define glBlendFunc glc_blend_func
+
+// state changes that need the pending quads drawn first
+#define glBlendEquation(mode) (glc_flush(), glBlendEquation(mode))
+#define glBlendEquationSeparate(rgb, alpha) \
+    (glc_flush(), glBlendEquationSeparate(rgb, alpha))
+#define glScissor(x, y, w, h) (glc_flush(), glScissor(x, y, w, h))
+#define glViewport(x, y, w, h) (glc_flush(), glViewport(x, y, w, h))
+#define glClear(mask) (glc_flush(), glClear(mask))
+#define glBindFramebuffer(target, fbo) \
+    (glc_flush(), glBindFramebuffer(target, fbo))
+#define glUseProgram(program) (glc_flush(), glUseProgram(program))
+#define glDeleteTextures(n, textures) \
+    (glc_flush(), glDeleteTextures(n, textures))
+#define glTexParameteri(target, name, param) \
+    (glc_flush(), glTexParameteri(target, name, param))
+#define glTexImage2D(target, level, ifmt, w, h, border, fmt, type, data) \
+    (glc_flush(), glTexImage2D(target, level, ifmt, w, h, border, fmt, \
+                               type, data))
+#define glTexSubImage2D(target, level, x, y, w, h, fmt, type, data) \
+    (glc_flush(), glTexSubImage2D(target, level, x, y, w, h, fmt, type, \
+                                  data))
 #endif
 
 #define glPopAttrib glPopAttribUndef
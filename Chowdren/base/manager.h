@@ -53,6 +53,9 @@ public:
     void on_key(int key, bool state);
     void on_mouse(int key, bool state);
     bool update();
+#ifdef CHOWDREN_IS_HEADLESS
+    bool update_headless();
+#endif
     int update_frame();
     void draw();
     void set_frame(int index);
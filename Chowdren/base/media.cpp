@@ -11,6 +11,15 @@
 #include "media.h"
 #include "datastream.h"
 
+#if defined(CHOWDREN_IS_DESKTOP) && !defined(CHOWDREN_IS_EMSCRIPTEN)
+#define CHOWDREN_SOUND_WORKER
+#include <deque>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/bind.hpp>
+#endif
+
 inline double clamp_sound(double val)
 {
     return std::max(0.0, std::min(val, 100.0));
@@ -59,32 +68,351 @@ public:
     }
 };
 
-class SoundCache : public SoundData
+// sounds from the asset file. short ones are decoded on their first play and
+// kept in a size-bounded LRU list, so playing them again only binds the
+// decoded buffer to a new source. long ones are always streamed.
+//
+// with CHOWDREN_SOUND_WORKER, the decode runs on a worker thread instead, and
+// the sound is streamed until it is done, so a first play never waits on the
+// decoder.
+
+#ifndef CHOWDREN_SOUND_CACHE_SECONDS
+#define CHOWDREN_SOUND_CACHE_SECONDS 5.0
+#endif
+
+#ifndef CHOWDREN_SOUND_CACHE_MB
+#ifdef CHOWDREN_IS_DESKTOP
+#define CHOWDREN_SOUND_CACHE_MB 64
+#elif CHOWDREN_IS_3DS
+#define CHOWDREN_SOUND_CACHE_MB 8
+#else
+#define CHOWDREN_SOUND_CACHE_MB 24
+#endif
+#endif
+
+#define SOUND_CACHE_SIZE (CHOWDREN_SOUND_CACHE_MB * 1024 * 1024)
+
+class AssetSound;
+
+#ifdef CHOWDREN_SOUND_WORKER
+static void queue_sound_decode(AssetSound * sound);
+static bool finish_sound_decode(AssetSound * sound);
+#endif
+
+struct SoundCacheList
+{
+    AssetSound * first;
+    AssetSound * last;
+    size_t size;
+
+    SoundCacheList()
+    : first(NULL), last(NULL), size(0)
+    {
+    }
+
+    void add(AssetSound * sound);
+    void remove(AssetSound * sound);
+    void touch(AssetSound * sound);
+};
+
+static SoundCacheList sound_cache;
+
+class AssetSound : public SoundData
 {
 public:
+    enum State
+    {
+        UNKNOWN,
+        SHORT,
+        LONG,
+        INVALID
+    };
+
     Media::AudioType type;
-    size_t offset;
     size_t size;
+    State state;
+    ChowdrenAudio::Sample * sample;
+    size_t sample_size;
+    AssetSound * prev;
+    AssetSound * next;
+    // queued for the worker. until the worker is done with it, only the
+    // worker touches state and sample.
+    bool pending;
+    // set by the worker under the pool lock
+    bool decoded;
+
+    AssetSound(unsigned int id, Media::AudioType type, size_t size)
+    : SoundData(id), type(type), size(size), state(UNKNOWN), sample(NULL),
+      sample_size(0), prev(NULL), next(NULL), pending(false), decoded(false)
+    {
+    }
+
+    ~AssetSound()
+    {
+        if (sample == NULL)
+            return;
+        // a decode that was never picked up isn't in the cache yet
+        if (!pending)
+            sound_cache.remove(this);
+        delete sample;
+    }
+
+    virtual ChowdrenAudio::SoundStream * create_stream() = 0;
+    virtual void decode() = 0;
+
+    void decode(ChowdrenAudio::SoundInput input)
+    {
+        ChowdrenAudio::SoundDecoder * file;
+        file = ChowdrenAudio::create_decoder(input, type, size);
+        if (file == NULL) {
+            state = INVALID;
+            return;
+        }
+        double duration = double(file->samples) / file->sample_rate
+                          / file->channels;
+        if (duration > CHOWDREN_SOUND_CACHE_SECONDS) {
+            state = LONG;
+            delete file;
+            return;
+        }
+        state = SHORT;
+        sample = new ChowdrenAudio::Sample(*file);
+        sample_size = sample->buffer->sample_count * sizeof(signed short);
+        delete file;
+    }
+
+    void load(ChowdrenAudio::SoundBase ** source)
+    {
+#ifdef CHOWDREN_SOUND_WORKER
+        if (pending && !finish_sound_decode(this)) {
+            *source = create_stream();
+            return;
+        }
+#endif
+        if (sample != NULL) {
+            sound_cache.touch(this);
+            *source = new ChowdrenAudio::Sound(*sample);
+            return;
+        }
+        if (state == UNKNOWN || state == SHORT) {
+#ifdef CHOWDREN_SOUND_WORKER
+            queue_sound_decode(this);
+            *source = create_stream();
+            return;
+#else
+            decode();
+            if (state == SHORT)
+                sound_cache.add(this);
+#endif
+        }
+        switch (state) {
+            case SHORT:
+                *source = new ChowdrenAudio::Sound(*sample);
+                break;
+            case LONG:
+                *source = create_stream();
+                break;
+            default:
+                *source = NULL;
+                break;
+        }
+    }
+
+    void evict()
+    {
+        sound_cache.remove(this);
+        delete sample;
+        sample = NULL;
+    }
+};
+
+void SoundCacheList::add(AssetSound * sound)
+{
+    sound->prev = NULL;
+    sound->next = first;
+    if (first != NULL)
+        first->prev = sound;
+    else
+        last = sound;
+    first = sound;
+    size += sound->sample_size;
+
+    // samples that are bound to a source can't be freed yet, so the cache
+    // may stay over budget until their channels move on
+    AssetSound * item = last;
+    while (size > SOUND_CACHE_SIZE && item != NULL) {
+        AssetSound * prev = item->prev;
+        if (item != sound && item->sample->sounds.empty())
+            item->evict();
+        item = prev;
+    }
+}
+
+void SoundCacheList::remove(AssetSound * sound)
+{
+    if (sound->prev != NULL)
+        sound->prev->next = sound->next;
+    else
+        first = sound->next;
+    if (sound->next != NULL)
+        sound->next->prev = sound->prev;
+    else
+        last = sound->prev;
+    sound->prev = sound->next = NULL;
+    size -= sound->sample_size;
+}
+
+void SoundCacheList::touch(AssetSound * sound)
+{
+    if (first == sound)
+        return;
+    remove(sound);
+    add(sound);
+}
+
+#ifdef CHOWDREN_SOUND_WORKER
+
+// one worker is enough, the game thread never waits on it
+
+struct SoundDecodePool
+{
+    std::deque<AssetSound*> queue;
+    AssetSound * current;
+    bool started;
+    boost::mutex lock;
+    boost::condition_variable work;
+    boost::condition_variable done;
+
+    SoundDecodePool()
+    : current(NULL), started(false)
+    {
+    }
+};
+
+// never freed, the worker may still be waiting on it at exit
+static SoundDecodePool & sound_pool = *new SoundDecodePool;
+
+static void sound_decode_worker(SoundDecodePool * pool)
+{
+    boost::mutex::scoped_lock guard(pool->lock);
+    while (true) {
+        while (pool->queue.empty())
+            pool->work.wait(guard);
+        AssetSound * sound = pool->queue.front();
+        pool->queue.pop_front();
+        pool->current = sound;
+        guard.unlock();
+
+        sound->decode();
+
+        guard.lock();
+        sound->decoded = true;
+        pool->current = NULL;
+        pool->done.notify_all();
+    }
+}
+
+static void queue_sound_decode(AssetSound * sound)
+{
+    sound->pending = true;
+    boost::mutex::scoped_lock guard(sound_pool.lock);
+    if (!sound_pool.started) {
+        sound_pool.started = true;
+        boost::thread thread(boost::bind(sound_decode_worker, &sound_pool));
+        thread.detach();
+    }
+    sound_pool.queue.push_back(sound);
+    sound_pool.work.notify_one();
+}
+
+// returns false if the worker isn't done with the sound yet
+
+static bool finish_sound_decode(AssetSound * sound)
+{
+    {
+        boost::mutex::scoped_lock guard(sound_pool.lock);
+        if (!sound->decoded)
+            return false;
+    }
+    sound->pending = sound->decoded = false;
+    if (sound->state == AssetSound::SHORT)
+        sound_cache.add(sound);
+    return true;
+}
+
+// drops the decodes that haven't started and waits for the current one, so
+// the sounds can be deleted
+
+static void stop_sound_worker()
+{
+    boost::mutex::scoped_lock guard(sound_pool.lock);
+    sound_pool.queue.clear();
+    while (sound_pool.current != NULL)
+        sound_pool.done.wait(guard);
+}
+
+#endif
+
+class SoundCache : public AssetSound
+{
+public:
+    size_t offset;
 
     SoundCache(unsigned int id, size_t offset, Media::AudioType type,
                size_t size)
-    : SoundData(id), type(type), offset(offset), size(size)
+    : AssetSound(id, type, size), offset(offset)
     {
     }
 
-    void load(ChowdrenAudio::SoundBase ** source)
+    ChowdrenAudio::SoundStream * create_stream()
     {
-        *source = new ChowdrenAudio::SoundStream(offset, type, size);
+        return new ChowdrenAudio::SoundStream(offset, type, size);
+    }
+
+    void decode()
+    {
+        AssetFile fp;
+        fp.open();
+        fp.seek(offset);
+        AssetSound::decode(fp);
     }
 };
 
+#ifdef CHOWDREN_ASSET_MAPPING
+
+// long sounds stream straight from the asset map
+
+class SoundView : public AssetSound
+{
+public:
+    const char * data;
+
+    SoundView(unsigned int id, const char * data, Media::AudioType type,
+              size_t size)
+    : AssetSound(id, type, size), data(data)
+    {
+    }
+
+    ChowdrenAudio::SoundStream * create_stream()
+    {
+        return new ChowdrenAudio::SoundStream(data, type, size);
+    }
+
+    void decode()
+    {
+        AssetSound::decode(ChowdrenAudio::SoundInput(data, size));
+    }
+};
+
+#endif
+
 class SoundMemory : public SoundData
 {
 public:
     ChowdrenAudio::Sample * buffer;
 
-    SoundMemory(unsigned int id, FSFile & fp, Media::AudioType type,
-                size_t size)
+    SoundMemory(unsigned int id, ChowdrenAudio::SoundInput fp,
+                Media::AudioType type, size_t size)
     : SoundData(id), buffer(NULL)
     {
         // load immediately
@@ -223,17 +551,25 @@ void Media::init()
 {
     ChowdrenAudio::open_audio();
 
+#ifdef CHOWDREN_ASSET_MAPPING
+    for (int i = 0; i < SOUND_COUNT; i++)
+        add_cache(i, get_asset(i, AssetFile::SOUND_DATA));
+#else
     AssetFile fp;
     fp.open();
     for (int i = 0; i < SOUND_COUNT; i++) {
         fp.set_item(i, AssetFile::SOUND_DATA);
         add_cache(i, fp);
     }
+#endif
 }
 
 void Media::stop()
 {
     stop_samples();
+#ifdef CHOWDREN_SOUND_WORKER
+    stop_sound_worker();
+#endif
 
     for (int i = 0; i < SOUND_COUNT; i++) {
         delete sounds[i];
@@ -521,19 +857,24 @@ void Media::add_cache(unsigned int id, FSFile & fp)
     if (type == NONE)
         return;
     unsigned int size = stream.read_uint32();
+    sounds[id] = new SoundCache(id, fp.tell(), type, size);
+}
 
-    bool is_wav = type == WAV;
-    SoundData * data;
-    if ((is_wav && size <= WAV_STREAM_THRESHOLD) ||
-        (!is_wav && size <= OGG_STREAM_THRESHOLD))
-    {
-        data = new SoundMemory(id, fp, type, size);
-    } else {
-        data = new SoundCache(id, fp.tell(), type, size);
-    }
-    sounds[id] = data;
+#ifdef CHOWDREN_ASSET_MAPPING
+
+void Media::add_cache(unsigned int id, const AssetView & view)
+{
+    MemoryStream stream(view.data, view.size);
+    AudioType type = (AudioType)stream.read_uint32();
+    if (type == NONE)
+        return;
+    unsigned int size = stream.read_uint32();
+    const char * data = stream.get_pointer(size);
+    sounds[id] = new SoundView(id, data, type, size);
 }
 
+#endif
+
 double Media::get_main_volume()
 {
     return ChowdrenAudio::Listener::get_volume() * 100.0;
@@ -83,6 +83,9 @@ public:
     bool is_channel_valid(unsigned int channel);
     void add_file(unsigned int id, const std::string & fn);
     void add_cache(unsigned int id, FSFile & fp);
+#ifdef CHOWDREN_ASSET_MAPPING
+    void add_cache(unsigned int id, const AssetView & view);
+#endif
     void add_data(unsigned int id, FSFile & fp, size_t size, AudioType type);
     double get_main_volume();
     void set_main_volume(double volume);
@@ -9,17 +9,21 @@ PerspectiveObject::PerspectiveObject(int x, int y, int type_id)
 {
     collision = new InstanceBox(this);
 
+#ifndef CHOWDREN_IS_DESKTOP
     glGenTextures(1, &texture);
     glBindTexture(GL_TEXTURE_2D, texture);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+#endif
 
     set_shader(perspective_shader);
 }
 
 PerspectiveObject::~PerspectiveObject()
 {
+#ifndef CHOWDREN_IS_DESKTOP
     glDeleteTextures(1, &texture);
+#endif
     delete collision;
 }
 
@@ -35,8 +39,13 @@ void PerspectiveObject::draw()
 
     int box[4];
     get_screen_aabb(box);
+#ifdef CHOWDREN_IS_DESKTOP
+    GLuint texture = glc_capture_color_buffer_rect(box[0], box[1],
+                                                   box[2], box[3], false);
+#else
     glc_copy_color_buffer_rect(texture, box[0], box[1],
                                box[2], box[3]);
+#endif
     glEnable(GL_TEXTURE_2D);
     glBindTexture(GL_TEXTURE_2D, texture);
     glColor4f(1.0f, 0.0f, 0.0f, 1.0f);
@@ -57,15 +66,15 @@ void PerspectiveObject::draw()
 
 void PerspectiveObject::set_waves(double value)
 {
-    set_shader_parameter("sine_waves", value);
+    set_shader_parameter(CHOWDREN_PERSPECTIVE_SINE_WAVES, value);
 }
 
 void PerspectiveObject::set_zoom(double value)
 {
-    set_shader_parameter("zoom", value);
+    set_shader_parameter(CHOWDREN_PERSPECTIVE_ZOOM, value);
 }
 
 void PerspectiveObject::set_offset(double value)
 {
-    set_shader_parameter("offset", value);
+    set_shader_parameter(CHOWDREN_PERSPECTIVE_OFFSET, value);
 }
@@ -8,7 +8,9 @@ class PerspectiveObject : public FrameObject
 public:
     FRAMEOBJECT_HEAD(PerspectiveObject)
 
+#ifndef CHOWDREN_IS_DESKTOP
 	GLuint texture;
+#endif
 
     PerspectiveObject(int x, int y, int type_id);
     ~PerspectiveObject();
@@ -17,6 +17,83 @@
 
 #include "pythonext.h"
 #include <iostream>
+#include <ctype.h>
+
+// compiled code for the strings passed to eval() and call_global(), keyed by
+// the source string as given. code objects don't depend on the globals, so
+// they stay valid when run_string() redefines them.
+
+typedef hash_map<std::string, PyObject*> CodeCache;
+static CodeCache code_cache;
+
+// global names that are plain identifiers, as interned string objects
+typedef hash_map<std::string, PyObject*> NameCache;
+static NameCache name_cache;
+
+static PyObject * get_code(const std::string & str)
+{
+    CodeCache::const_iterator it = code_cache.find(str);
+    if (it != code_cache.end())
+        return it->second;
+    std::string src(str);
+    src.erase(std::remove(src.begin(), src.end(), '\r'), src.end());
+    PyObject * code = Py_CompileString(src.c_str(), "<string>",
+                                       Py_eval_input);
+    // errors are not cached, so they are reported on every call like before
+    if (code == NULL)
+        return NULL;
+    code_cache[str] = code;
+    return code;
+}
+
+static PyObject * eval_code(const std::string & str, PyObject * globals)
+{
+    PyObject * code = get_code(str);
+    if (code == NULL)
+        return NULL;
+    return PyEval_EvalCode((PyCodeObject*)code, globals, globals);
+}
+
+static bool is_identifier(const std::string & name)
+{
+    if (name.empty() || isdigit((unsigned char)name[0]))
+        return false;
+    std::string::const_iterator it;
+    for (it = name.begin(); it != name.end(); ++it) {
+        unsigned char c = (unsigned char)*it;
+        if (!isalnum(c) && c != '_')
+            return false;
+    }
+    return true;
+}
+
+// returns a new reference. plain names are looked up in the globals on
+// every call, so rebinding them from Python is picked up without having to
+// invalidate anything.
+static PyObject * get_global(const std::string & name, PyObject * globals)
+{
+    PyObject * key;
+    NameCache::const_iterator it = name_cache.find(name);
+    if (it != name_cache.end()) {
+        key = it->second;
+    } else {
+        key = NULL;
+        if (is_identifier(name))
+            key = PyString_InternFromString(name.c_str());
+        name_cache[name] = key;
+    }
+
+    if (key != NULL) {
+        PyObject * value = PyDict_GetItem(globals, key);
+        if (value != NULL) {
+            Py_INCREF(value);
+            return value;
+        }
+    }
+
+    // builtins and anything that is not a plain name
+    return eval_code(name, globals);
+}
 
 void PythonInterpreter::initialize()
 {
@@ -48,7 +125,7 @@ void PythonInterpreter::add_function(const char * name, void * fp)
 }
 
 PythonInterpreter::PythonInterpreter(int x, int y, int type_id)
-: FrameObject(x, y, type_id), parameters(NULL), returns(NULL)
+: FrameObject(x, y, type_id), returns(NULL)
 {
     initialize();
 }
@@ -72,9 +149,9 @@ void PythonInterpreter::run_string(std::string str)
 
 void PythonInterpreter::add_parameter(PyObject * v)
 {
-    if (parameters == NULL)
-        parameters = PyList_New(0);
-    PyList_Append(parameters, v);
+    // the reference is handed over to the argument tuple in call_global()
+    Py_INCREF(v);
+    parameters.push_back(v);
 }
 
 void PythonInterpreter::add_parameter(double v)
@@ -107,12 +184,10 @@ PyObject * PythonInterpreter::create_object(int value)
     return PyInt_FromLong(value);
 }
 
-PyObject * PythonInterpreter::eval(std::string str)
+PyObject * PythonInterpreter::eval(const std::string & str)
 {
-    str.erase(std::remove(str.begin(), str.end(), '\r'), str.end());
     PyObject * globals = PyModule_GetDict(main_module);
-    PyObject * result = PyRun_String(str.c_str(), Py_eval_input,
-        globals, globals);
+    PyObject * result = eval_code(str, globals);
     print_errors();
     return result;
 }
@@ -135,8 +210,7 @@ void PythonInterpreter::call_global(const std::string & name)
     print_errors();
     PyObject * globals = PyModule_GetDict(main_module);
     const char * function_name = name.c_str();
-    PyObject * function = PyRun_String(function_name, Py_eval_input,
-        globals, globals);
+    PyObject * function = get_global(name, globals);
     if (function == NULL) {
         PyErr_Format(PyExc_AttributeError,
             "no global exists with the name '%s'", function_name);
@@ -144,14 +218,11 @@ void PythonInterpreter::call_global(const std::string & name)
         return;
     }
 
-    PyObject * parameters;
-    if (this->parameters == NULL) {
-        parameters = PyTuple_New(0);
-    } else {
-        parameters = PyList_AsTuple(this->parameters);
-        Py_DECREF(this->parameters);
-    }
-    this->parameters = NULL;
+    Py_ssize_t count = Py_ssize_t(this->parameters.size());
+    PyObject * parameters = PyTuple_New(count);
+    for (Py_ssize_t i = 0; i < count; i++)
+        PyTuple_SET_ITEM(parameters, i, this->parameters[i]);
+    this->parameters.clear();
     Py_XDECREF(returns);
     PyObject * result = PyObject_Call(function, parameters, NULL);
 
@@ -169,6 +240,7 @@ void PythonInterpreter::call_global(const std::string & name)
 
 /*        std::cout << "Call for " << name << " returning to application" << std::endl;*/
     Py_DECREF(parameters);
+    Py_DECREF(function);
 }
 
 std::string PythonInterpreter::as_string(PyObject * v)
@@ -3,6 +3,7 @@
 
 #include <string>
 #include "frameobject.h"
+#include "types.h"
 
 typedef struct _object PyObject;
 
@@ -18,7 +19,7 @@ public:
     static PyObject * main_module;
     static PyObject * interface_module;
     static PyObject * functions_module;
-    PyObject * parameters;
+    vector<PyObject*> parameters;
     PyObject * returns;
 
     static void initialize();
@@ -44,7 +45,7 @@ public:
     static double to_double(PyObject * value);
     static PyObject * create_object(const std::string & v);
     static PyObject * create_object(int value);
-    static PyObject * eval(std::string str);
+    static PyObject * eval(const std::string & str);
     static double list_append(double listd, PyObject * value);
     static double create_list();
     void call_global(const std::string & name);
@@ -6,7 +6,8 @@
 
 Text::Text(int x, int y, int type_id)
 : FrameObject(x, y, type_id), initialized(false), current_paragraph(0),
-  draw_text_set(false), layout(NULL), scale(1.0f)
+  draw_text_set(false), layout(NULL), scale(1.0f), mesh_font(NULL),
+  mesh_set(false)
 {
     collision = new InstanceBox(this);
 }
@@ -34,20 +35,17 @@ void Text::draw()
     }
 
     update_draw_text();
+    update_mesh();
     blend_color.apply();
     glPushMatrix();
     if (layout != NULL) {
-        FTBBox bb = layout->BBox(draw_text.c_str(), -1);
         double off_x = x;
         double off_y = y + font->Ascender();
         glTranslated((int)off_x, (int)off_y, 0.0);
         glScalef(1, -1, 1);
-        layout->Render(draw_text.c_str(), -1, FTPoint());
-        glPopMatrix();
     } else {
-        FTBBox box = font->BBox(draw_text.c_str(), -1, FTPoint());
-        double box_w = box.Upper().X() - box.Lower().X();
-        double box_h = box.Upper().Y() - box.Lower().Y();
+        double box_w = mesh_box.Upper().X() - mesh_box.Lower().X();
+        double box_h = mesh_box.Upper().Y() - mesh_box.Lower().Y();
         double off_x = x;
         double off_y = y + font->Ascender();
 
@@ -69,15 +67,38 @@ void Text::draw()
 
         glTranslated((int)off_x, (int)off_y, 0.0);
         glScalef(scale, -scale, scale);
+    }
+    mesh.draw();
+    glPopMatrix();
+}
+
+void Text::update_mesh()
+{
+    if (mesh_set && mesh_font == font)
+        return;
+    mesh_set = true;
+    if (layout != NULL && mesh_font != font)
+        layout->SetFont(font);
+    mesh_font = font;
+
+    mesh.clear();
+    FTGlyph::mesh = &mesh;
+    if (layout != NULL) {
+        layout->Render(draw_text.c_str(), -1, FTPoint());
+    } else {
+        mesh_box = font->BBox(draw_text.c_str(), -1, FTPoint());
         font->Render(draw_text.c_str(), -1, FTPoint(), FTPoint());
-        glPopMatrix();
     }
+    FTGlyph::mesh = NULL;
 }
 
 void Text::set_string(const std::string & value)
 {
+    if (value == text)
+        return;
     text = value;
     draw_text_set = false;
+    mesh_set = false;
 }
 
 void Text::set_paragraph(unsigned int index)
@@ -166,6 +187,7 @@ void Text::set_width(int w)
         layout->SetFont(font);
     }
     layout->SetLineLength(w);
+    mesh_set = false;
 }
 
 void Text::set_scale(float scale)
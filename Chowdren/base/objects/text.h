@@ -25,6 +25,13 @@ public:
     FTSimpleLayout * layout;
     float scale;
 
+    // laid-out glyphs of draw_text, rebuilt when the text, font or width
+    // changes
+    QuadMesh mesh;
+    FTBBox mesh_box;
+    FTTextureFont * mesh_font;
+    bool mesh_set;
+
     Text(int x, int y, int type_id);
     ~Text();
     void add_line(const std::string & text);
@@ -43,6 +50,7 @@ public:
     int get_width();
     int get_height();
     void update_draw_text();
+    void update_mesh();
 };
 
 class FontInfo
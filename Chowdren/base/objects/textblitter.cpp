@@ -3,6 +3,7 @@
 #include "collision.h"
 #include "shader.h"
 #include <iostream>
+#include <string.h>
 #include "font.h"
 
 // TextBlitter
@@ -10,7 +11,8 @@
 TextBlitter::TextBlitter(int x, int y, int type_id)
 : FrameObject(x, y, type_id), flash_interval(0.0f), x_spacing(0), y_spacing(0),
   x_scroll(0), y_scroll(0), anim_type(BLITTER_ANIMATION_NONE),
-  charmap_ref(true), callback_line_count(0), draw_image(NULL)
+  charmap_ref(true), callback_line_count(0), draw_image(NULL),
+  mesh_set(false)
 {
     collision = new InstanceBox(this);
 }
@@ -26,6 +28,7 @@ void TextBlitter::load(const std::string & filename)
     }
 
     image = new_image;
+    image->unpack_atlas();
     image->upload_texture();
 }
 
@@ -49,7 +52,11 @@ void TextBlitter::initialize(const std::string & map_string)
         charmap[c] = i;
     }
 
+    // we compute our own texture coordinates
+    image->unpack_atlas();
     image->upload_texture();
+
+    mesh_set = false;
 }
 
 int TextBlitter::get_x_align()
@@ -158,6 +165,7 @@ void TextBlitter::append_text(const std::string & value)
 void TextBlitter::update_lines()
 {
     lines.clear();
+    mesh_set = false;
 
     if (text.empty()) {
         lines.push_back(LineReference(NULL, 0));
@@ -334,29 +342,70 @@ void TextBlitter::draw()
         draw_image->upload_texture();
     }
 
+    update_mesh(image);
+
     begin_draw();
 
     blend_color.apply();
-    glEnable(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, image->tex);
+
+    // glEnable(GL_SCISSOR_TEST);
+    // glc_scissor_world(x, y, width, height);
+
+    glPushMatrix();
+    glTranslatef(x, y, 0.0f);
+    mesh.draw();
+    glPopMatrix();
+
+    glDisable(GL_TEXTURE_2D);
+    // glDisable(GL_SCISSOR_TEST);
+
+    end_draw();
+}
+
+void TextBlitter::update_mesh(Image * image)
+{
+    BlitterLayout layout;
+    // cleared so the padding compares equal too
+    memset(&layout, 0, sizeof(BlitterLayout));
+    layout.image = image;
+    layout.tex = image->tex;
+    layout.image_width = image_width;
+    layout.char_width = char_width;
+    layout.char_height = char_height;
+    layout.char_offset = char_offset;
+    layout.x_off = x_off;
+    layout.y_off = y_off;
+    layout.x_spacing = x_spacing;
+    layout.y_spacing = y_spacing;
+    layout.x_scroll = x_scroll;
+    layout.y_scroll = y_scroll;
+    layout.alignment = alignment;
+    layout.width = width;
+    layout.height = height;
+
+    // the wave moves every frame, so there is nothing to keep
+    bool animated = anim_type == BLITTER_ANIMATION_SINWAVE;
+    if (mesh_set && !animated &&
+        memcmp(&layout, &mesh_layout, sizeof(BlitterLayout)) == 0)
+        return;
+    mesh_set = true;
+    mesh_layout = layout;
+    mesh.clear();
 
     int x_add = char_width + x_spacing;
     int y_add = char_height + y_spacing;
 
-    int yy = y + y_scroll;
+    int yy = y_scroll;
     if (alignment & ALIGN_VCENTER)
         yy += height / 2 - lines.size() * char_height / 2
               - (lines.size() - 1) * y_spacing;
 
     vector<LineReference>::const_iterator it;
 
-    // glEnable(GL_SCISSOR_TEST);
-    // glc_scissor_world(x, y, width, height);
-
     for (it = lines.begin(); it != lines.end(); ++it) {
         const LineReference & line = *it;
 
-        int xx = x + x_scroll;
+        int xx = x_scroll;
 
         if (alignment & ALIGN_HCENTER) {
             xx += (width - line.size * x_add) / 2;
@@ -364,7 +413,7 @@ void TextBlitter::draw()
             xx += width - line.size * x_add;
         }
 
-        // draw line
+        // lay out line
         for (int i = 0; i < line.size; i++) {
             unsigned char c = (unsigned char)line.start[i];
             c -= char_offset;
@@ -380,33 +429,20 @@ void TextBlitter::draw()
             float t_y2 = float(img_y+char_height) / float(image->height);
 
             int yyy = yy;
-            if (anim_type == BLITTER_ANIMATION_SINWAVE) {
+            if (animated) {
                 double t = double(anim_frame / anim_speed + x_add * i);
                 t /= double(wave_freq);
                 yyy += int(sin(t) * wave_height);
             }
 
-            glBegin(GL_QUADS);
-            glTexCoord2f(t_x1, t_y1);
-            glVertex2i(xx, yyy);
-            glTexCoord2f(t_x2, t_y1);
-            glVertex2i(xx + char_width, yyy);
-            glTexCoord2f(t_x2, t_y2);
-            glVertex2i(xx + char_width, yyy + char_height);
-            glTexCoord2f(t_x1, t_y2);
-            glVertex2i(xx, yyy + char_height);
-            glEnd();
+            mesh.add_quad(image->tex, xx, yyy, xx + char_width,
+                          yyy + char_height, t_x1, t_y1, t_x2, t_y2);
 
             xx += x_add;
         }
 
         yy += y_add;
     }
-
-    glDisable(GL_TEXTURE_2D);
-    // glDisable(GL_SCISSOR_TEST);
-
-    end_draw();
 }
 
 class DefaultBlitter : public TextBlitter
@@ -6,6 +6,7 @@
 #include <string>
 #include "color.h"
 #include "image.h"
+#include "quadmesh.h"
 
 enum BlitterAnimation
 {
@@ -24,6 +25,21 @@ struct LineReference
     }
 };
 
+// everything the character quads depend on besides the text
+struct BlitterLayout
+{
+    Image * image;
+    GLuint tex;
+    int image_width;
+    int char_width, char_height;
+    int char_offset;
+    int x_off, y_off;
+    int x_spacing, y_spacing;
+    int x_scroll, y_scroll;
+    int alignment;
+    int width, height;
+};
+
 class TextBlitter : public FrameObject
 {
 public:
@@ -58,6 +74,11 @@ public:
     Image * draw_image;
     ReplacedImages replacer;
 
+    // character quads relative to the object position
+    QuadMesh mesh;
+    BlitterLayout mesh_layout;
+    bool mesh_set;
+
     TextBlitter(int x, int y, int type_id);
     ~TextBlitter();
     void initialize(const std::string & charmap);
@@ -76,6 +97,7 @@ public:
     void set_width(int width);
     void set_height(int height);
     void draw();
+    void update_mesh(Image * image);
     void update();
     void flash(float value);
     std::string get_line(int index);
@@ -9,19 +9,23 @@ Viewport * Viewport::instance = NULL;
 Viewport::Viewport(int x, int y, int type_id)
 : FrameObject(x, y, type_id)
 {
+#ifndef CHOWDREN_IS_DESKTOP
     glGenTextures(1, &texture);
     glBindTexture(GL_TEXTURE_2D, texture);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+#endif
     collision = new InstanceBox(this);
     instance = this;
 }
 
 Viewport::~Viewport()
 {
+#ifndef CHOWDREN_IS_DESKTOP
     glDeleteTextures(1, &texture);
+#endif
     delete collision;
     instance = NULL;
 }
@@ -56,7 +60,12 @@ void Viewport::draw()
     int src_y1 = center_y - src_height / 2;
     int src_x2 = src_x1 + src_width;
     int src_y2 = src_y1 + src_height;
+#ifdef CHOWDREN_IS_DESKTOP
+    GLuint texture = glc_capture_color_buffer_rect(src_x1, src_y1,
+                                                   src_x2, src_y2, false);
+#else
     glc_copy_color_buffer_rect(texture, src_x1, src_y1, src_x2, src_y2);
+#endif
     int x2 = x + width;
     int y2 = y + height;
     glEnable(GL_TEXTURE_2D);
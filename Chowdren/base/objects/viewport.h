@@ -11,7 +11,9 @@ public:
 
     int center_x, center_y;
     int src_width, src_height;
+#ifndef CHOWDREN_IS_DESKTOP
     GLuint texture;
+#endif
     static Viewport * instance;
 
     Viewport(int x, int y, int type_id);
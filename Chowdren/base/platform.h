@@ -68,6 +68,12 @@ std::string convert_path(const std::string & value);
 void glc_init();
 void glc_copy_color_buffer_rect(unsigned int tex, int x1, int y1, int x2,
                                      int y2);
+#ifdef CHOWDREN_IS_DESKTOP
+// copies the rectangle into a pooled texture of the same size and returns
+// it. the texture is reused by the next capture of that size.
+unsigned int glc_capture_color_buffer_rect(int x1, int y1, int x2, int y2,
+                                           bool linear);
+#endif
 void glc_scissor_world(int x, int y, int w, int h);
 void glc_set_storage(bool vram);
 bool glc_is_vram_full();
@@ -79,6 +85,16 @@ bool platform_show_build_info();
 bool platform_should_reset();
 #endif
 
+// headless
+
+#ifdef CHOWDREN_IS_HEADLESS
+void platform_set_args(int argc, char ** argv);
+double platform_get_real_time();
+void platform_add_timing(double events, double draw);
+const std::string & platform_get_benchmark();
+int run_benchmark(const std::string & name);
+#endif
+
 // wiiu
 
 #define CHOWDREN_TV_TARGET 0
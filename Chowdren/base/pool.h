@@ -9,8 +9,10 @@ NOTE: This intentionally leaks the blocks used, as we intend to use them for
 the duration of the application.
 */
 
-template <class T>
-class ObjectPool
+// items of a size that is only known at runtime. every item taken from one
+// pool must have the same size.
+
+class SizedPool
 {
 public:
     void ** free_items;
@@ -18,12 +20,12 @@ public:
     long total;
     long buffer_size;
 
-    ~ObjectPool()
+    ~SizedPool()
     {
         delete[] free_items;
     }
 
-    void * create()
+    void * create(size_t item_size)
     {
         if (available > 0)
             return free_items[--available];
@@ -32,12 +34,12 @@ public:
             buffer_size = 32;
 
         delete[] free_items;
-        unsigned char * block = new unsigned char[sizeof(T)*buffer_size];
+        unsigned char * block = new unsigned char[item_size*buffer_size];
         total += buffer_size;
         free_items = new void*[total];
         for (int i = 0; i < buffer_size; i++) {
             free_items[available++] = block;
-            block += sizeof(T);
+            block += item_size;
         }
         buffer_size *= 2;
         return free_items[--available];
@@ -51,4 +53,14 @@ public:
     }
 };
 
+template <class T>
+class ObjectPool : public SizedPool
+{
+public:
+    void * create()
+    {
+        return SizedPool::create(sizeof(T));
+    }
+};
+
 #endif // CHOWDREN_POOL_H
@@ -1,4 +1,11 @@
 #include "pool.h"
 #include "alterables.h"
 
-ObjectPool<Alterables> alterable_pool;
+// used for default instances and objects without an exported layout
+AlterableLayout full_alterable_layout = {
+    ALT_VALUES, ALT_STRINGS,
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19,
+     20, 21, 22, 23, 24, 25},
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9},
+    NULL, NULL
+};
@@ -3,8 +3,19 @@
 
 #include "chowconfig.h"
 
+#if defined(CHOWDREN_USE_TRACING) && defined(CHOWDREN_USE_PROFILER)
+#error "CHOWDREN_USE_TRACING and CHOWDREN_USE_PROFILER are exclusive"
+#endif
+
 #ifdef CHOWDREN_USE_PROFILER
 #include "profiler/Shiny.h"
+#elif defined(CHOWDREN_USE_TRACING)
+// the profile zones are recorded on the trace timeline instead
+#include "tracing.h"
+#define PROFILE_BLOCK(x) TraceBlock x##_trace(#x)
+#define PROFILE_FUNC() TraceBlock func_trace(__FUNCTION__)
+#define PROFILE_BEGIN(x) trace_begin(#x)
+#define PROFILE_END() trace_end()
 #else
 #define PROFILE_BLOCK(x)
 #define PROFILE_FUNC()
@@ -0,0 +1,91 @@
+#ifndef CHOWDREN_QUADMESH_H
+#define CHOWDREN_QUADMESH_H
+
+// textured quads that are laid out once and then drawn as a whole. used for
+// text, where the layout is expensive and rarely changes.
+
+#include "include_gl.h"
+#include "types.h"
+
+struct QuadMeshRun
+{
+    GLuint texture;
+    int start;
+    int count;
+};
+
+inline void set_vertex(GLCQuadVertex & vertex, float x, float y,
+                       float u, float v)
+{
+    vertex.x = x;
+    vertex.y = y;
+    vertex.u = u;
+    vertex.v = v;
+}
+
+class QuadMesh
+{
+public:
+    // 4 vertices per quad
+    vector<GLCQuadVertex> vertices;
+    // consecutive quads that use the same texture
+    vector<QuadMeshRun> runs;
+
+    void clear()
+    {
+        vertices.clear();
+        runs.clear();
+    }
+
+    bool empty() const
+    {
+        return runs.empty();
+    }
+
+    void add_quad(GLuint texture, float x1, float y1, float x2, float y2,
+                  float u1, float v1, float u2, float v2)
+    {
+        if (runs.empty() || runs.back().texture != texture) {
+            QuadMeshRun run = {texture, int(vertices.size()) / 4, 0};
+            runs.push_back(run);
+        }
+        runs.back().count++;
+
+        size_t i = vertices.size();
+        vertices.resize(i + 4);
+        GLCQuadVertex * v = &vertices[i];
+        set_vertex(v[0], x1, y1, u1, v1);
+        set_vertex(v[1], x1, y2, u1, v2);
+        set_vertex(v[2], x2, y2, u2, v2);
+        set_vertex(v[3], x2, y1, u2, v1);
+    }
+
+    // draws with the current color, matrix and blend mode
+    void draw() const
+    {
+        if (runs.empty())
+            return;
+        glEnable(GL_TEXTURE_2D);
+        vector<QuadMeshRun>::const_iterator it;
+        for (it = runs.begin(); it != runs.end(); ++it) {
+            const QuadMeshRun & run = *it;
+            glBindTexture(GL_TEXTURE_2D, run.texture);
+#ifdef CHOWDREN_IS_DESKTOP
+            glc_draw_quads(&vertices[run.start * 4], run.count);
+#else
+            const GLCQuadVertex * v = &vertices[run.start * 4];
+            for (int i = 0; i < run.count; i++) {
+                glBegin(GL_QUADS);
+                for (int j = 0; j < 4; j++) {
+                    glTexCoord2f(v[j].u, v[j].v);
+                    glVertex2f(v[j].x, v[j].y);
+                }
+                glEnd();
+                v += 4;
+            }
+#endif
+        }
+    }
+};
+
+#endif // CHOWDREN_QUADMESH_H
@@ -55,6 +55,9 @@ void GameManager::init()
 {
 #ifdef CHOWDREN_USE_PROFILER
     PROFILE_SET_DAMPING(0.0);
+#endif
+#ifdef CHOWDREN_USE_TRACING
+    trace_set_thread_name("main");
 #endif
     frame = &static_frames;
 
@@ -165,9 +168,7 @@ void GameManager::on_mouse(int key, bool state)
 
 int GameManager::update_frame()
 {
-#ifdef CHOWDREN_USE_PROFILER
     PROFILE_FUNC();
-#endif
     double dt = fps_limit.dt;
     if (fade_dir != 0.0f) {
         fade_value += fade_dir * (float)dt;
@@ -440,6 +441,9 @@ bool GameManager::update()
     last_control_flags = new_control;
 
     fps_limit.start();
+#ifdef CHOWDREN_USE_TRACING
+    TraceFrame trace_frame;
+#endif
     platform_poll_events();
 
     // update mouse position
@@ -477,6 +481,7 @@ bool GameManager::update()
     double draw_time = platform_get_time();
 
     draw();
+    end_image_frame();
 
 // #ifndef NDEBUG
     if (show_stats) {
@@ -487,6 +492,12 @@ bool GameManager::update()
     }
 // #endif
 
+#ifdef CHOWDREN_USE_TRACING
+    trace_frame.end();
+    if (keyboard.is_pressed_once(CHOWDREN_TRACE_KEY))
+        trace_dump();
+#endif
+
     fps_limit.finish();
 
 #ifdef CHOWDREN_USE_PROFILER
@@ -502,6 +513,44 @@ bool GameManager::update()
     return true;
 }
 
+#ifdef CHOWDREN_IS_HEADLESS
+// one fixed step without a display. events and drawing still run (against
+// the null GL backend), and the wall time of both is recorded per tick
+
+bool GameManager::update_headless()
+{
+    keyboard.update();
+    mouse.update();
+
+    int new_control = get_player_control_flags(1);
+    control_flags = new_control & ~(last_control_flags);
+    last_control_flags = new_control;
+
+    // advances the fixed clock and feeds the scripted input for this tick
+    platform_poll_events();
+    fps_limit.start();
+    platform_get_mouse_pos(&mouse_x, &mouse_y);
+
+    double event_time = platform_get_real_time();
+    int ret = update_frame();
+    event_time = platform_get_real_time() - event_time;
+
+    double draw_time = 0.0;
+    if (ret == 1) {
+        draw_time = platform_get_real_time();
+        draw();
+        draw_time = platform_get_real_time() - draw_time;
+        end_image_frame();
+    }
+
+    platform_add_timing(event_time, draw_time);
+
+    if (ret == 0)
+        return false;
+    return !platform_display_closed();
+}
+#endif
+
 #ifdef CHOWDREN_IS_EMSCRIPTEN
 static void _emscripten_run()
 {
@@ -517,8 +566,13 @@ void GameManager::run()
     emscripten_set_main_loop(_emscripten_run, 0, 1);
 #else
     while (true) {
+#ifdef CHOWDREN_IS_HEADLESS
+        if (!update_headless())
+            break;
+#else
         if (!update())
             break;
+#endif
     }
     frame->data->on_app_end();
     frame->data->on_end();
@@ -796,6 +850,11 @@ int main(int argc, char *argv[])
     setvbuf(stdin, NULL, _IONBF, 0);
 
     std::ios::sync_with_stdio();
+#endif
+#ifdef CHOWDREN_IS_HEADLESS
+    platform_set_args(argc, argv);
+    if (!platform_get_benchmark().empty())
+        return run_benchmark(platform_get_benchmark());
 #endif
     manager.run();
     return 0;
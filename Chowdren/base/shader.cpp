@@ -12,6 +12,19 @@ void convert_vec4(int val, float & a, float & b, float & c, float & d)
     d = ((val >> 24) & 0xFF) / 255.0f;
 }
 
+// parameter slots, the names are generated by the exporter
+
+#include "shaderparams.cpp"
+
+int get_shader_parameter_slot(const std::string & name)
+{
+    for (int i = 0; i < SHADER_PARAMETER_COUNT; i++) {
+        if (name == shader_parameter_names[i])
+            return i;
+    }
+    return -1;
+}
+
 class AdditiveShader : public Shader
 {
 public:
@@ -28,10 +41,11 @@ public:
 
 #include "glslshader.h"
 
-void GLSLShader::set_image(FrameObject * instance, const std::string & name)
+void GLSLShader::set_image(FrameObject * instance)
 {
+    GLuint tex = (GLuint)instance->get_shader_parameter(texture_slot);
     glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, (GLuint)(*instance->shader_parameters)[name]);
+    glBindTexture(GL_TEXTURE_2D, tex);
     glActiveTexture(GL_TEXTURE0);
 }
 
@@ -77,9 +91,9 @@ public:
 class MixerShader : public GLSLShader
 {
 public:
-    int r;
-    int g;
-    int b;
+    ShaderUniform r;
+    ShaderUniform g;
+    ShaderUniform b;
 
     MixerShader()
     : GLSLShader(SHADER_COLORMIXER)
@@ -89,23 +103,23 @@ public:
 
     void initialize_parameters()
     {
-        r = get_uniform("r");
-        g = get_uniform("g");
-        b = get_uniform("b");
+        init_uniform(r, "r");
+        init_uniform(g, "g");
+        init_uniform(b, "b");
     }
 
     void set_parameters(FrameObject * instance)
     {
-        set_vec4(instance, "r", r);
-        set_vec4(instance, "g", g);
-        set_vec4(instance, "b", b);
+        set_vec4(instance, r);
+        set_vec4(instance, g);
+        set_vec4(instance, b);
     }
 };
 
 class HueShader : public GLSLShader
 {
 public:
-    int hue;
+    ShaderUniform hue;
 
     HueShader()
     : GLSLShader(SHADER_HUE)
@@ -115,20 +129,20 @@ public:
 
     void set_parameters(FrameObject * instance)
     {
-        set_float(instance, "fHue", hue);
+        set_float(instance, hue);
     }
 
     void initialize_parameters()
     {
-        hue = get_uniform("fHue");
+        init_uniform(hue, "fHue");
     }
 };
 
 class OffsetShader : public GLSLShader
 {
 public:
-    int width;
-    int height;
+    ShaderUniform width;
+    ShaderUniform height;
 
     OffsetShader()
     : GLSLShader(SHADER_OFFSET, SHADER_HAS_BACK | SHADER_HAS_TEX_SIZE)
@@ -138,14 +152,14 @@ public:
 
     void initialize_parameters()
     {
-        width = get_uniform("width");
-        height = get_uniform("height");
+        init_uniform(width, "width");
+        init_uniform(height, "height");
     }
 
     void set_parameters(FrameObject * instance)
     {
-        set_float(instance, "width", width);
-        set_float(instance, "height", height);
+        set_float(instance, width);
+        set_float(instance, height);
     }
 };
 
@@ -162,8 +176,8 @@ public:
 class DodgeBlurShader : public GLSLShader
 {
 public:
-    int vertical;
-    int radius;
+    ShaderUniform vertical;
+    ShaderUniform radius;
 
     DodgeBlurShader()
     : GLSLShader(SHADER_DODGEBLUR, SHADER_HAS_BACK | SHADER_HAS_TEX_SIZE)
@@ -173,23 +187,23 @@ public:
 
     void initialize_parameters()
     {
-        vertical = get_uniform("vertical");
-        radius = get_uniform("radius");
+        init_uniform(vertical, "vertical");
+        init_uniform(radius, "radius");
     }
 
     void set_parameters(FrameObject * instance)
     {
-        set_float(instance, "vertical", vertical);
-        set_float(instance, "radius", radius);
+        set_float(instance, vertical);
+        set_float(instance, radius);
     }
 };
 
 class GrainShader : public GLSLShader
 {
 public:
-    int strength, seed;
-    int invert;
-    int r, g, b, a;
+    ShaderUniform strength, seed;
+    ShaderUniform invert;
+    ShaderUniform r, g, b, a;
 
     GrainShader()
     : GLSLShader(SHADER_GRAIN)
@@ -199,24 +213,24 @@ public:
 
     void initialize_parameters()
     {
-        strength = get_uniform("fStrength");
-        seed = get_uniform("fSeed");
-        invert = get_uniform("iInvert");
-        r = get_uniform("iR");
-        g = get_uniform("iG");
-        b = get_uniform("iB");
-        a = get_uniform("iA");
+        init_uniform(strength, "fStrength");
+        init_uniform(seed, "fSeed");
+        init_uniform(invert, "iInvert");
+        init_uniform(r, "iR");
+        init_uniform(g, "iG");
+        init_uniform(b, "iB");
+        init_uniform(a, "iA");
     }
 
     void set_parameters(FrameObject * instance)
     {
-        set_float(instance, "fStrength", strength);
-        set_float(instance, "fSeed", seed);
-        set_int(instance, "iInvert", invert);
-        set_int(instance, "iR", r);
-        set_int(instance, "iG", g);
-        set_int(instance, "iB", b);
-        set_int(instance, "iA", a);
+        set_float(instance, strength);
+        set_float(instance, seed);
+        set_int(instance, invert);
+        set_int(instance, r);
+        set_int(instance, g);
+        set_int(instance, b);
+        set_int(instance, a);
     }
 };
 
@@ -241,9 +255,9 @@ public:
 class TintShader : public GLSLShader
 {
 public:
-    int tint_color;
-    int tint_power;
-    int original_power;
+    ShaderUniform tint_color;
+    ShaderUniform tint_power;
+    ShaderUniform original_power;
 
     TintShader()
     : GLSLShader(SHADER_TINT)
@@ -253,24 +267,24 @@ public:
 
     void initialize_parameters()
     {
-        tint_color = get_uniform("fTintColor");
-        tint_power = get_uniform("fTintPower");
-        original_power = get_uniform("fOriginalPower");
+        init_uniform(tint_color, "fTintColor");
+        init_uniform(tint_power, "fTintPower");
+        init_uniform(original_power, "fOriginalPower");
     }
 
     void set_parameters(FrameObject * instance)
     {
-        set_vec4(instance, "fTintColor", tint_color);
-        set_float(instance, "fTintPower", tint_power);
-        set_float(instance, "fOriginalPower", original_power);
+        set_vec4(instance, tint_color);
+        set_float(instance, tint_power);
+        set_float(instance, original_power);
     }
 };
 
 class ChannelBlurShader : public GLSLShader
 {
 public:
-    int coeff;
-    int r, g, b, a;
+    ShaderUniform coeff;
+    ShaderUniform r, g, b, a;
 
     ChannelBlurShader()
     : GLSLShader(SHADER_CHANNELBLUR)
@@ -279,29 +293,29 @@ public:
 
     void initialize_parameters()
     {
-        coeff = get_uniform("fCoeff");
-        r = get_uniform("iR");
-        g = get_uniform("iG");
-        b = get_uniform("iB");
-        a = get_uniform("iA");
+        init_uniform(coeff, "fCoeff");
+        init_uniform(r, "iR");
+        init_uniform(g, "iG");
+        init_uniform(b, "iB");
+        init_uniform(a, "iA");
     }
 
     void set_parameters(FrameObject * instance)
     {
-        set_float(instance, "fCoeff", coeff);
-        set_int(instance, "iR", r);
-        set_int(instance, "iG", g);
-        set_int(instance, "iB", b);
-        set_int(instance, "iA", a);
+        set_float(instance, coeff);
+        set_int(instance, r);
+        set_int(instance, g);
+        set_int(instance, b);
+        set_int(instance, a);
     }
 };
 
 class BgBloomShader : public GLSLShader
 {
 public:
-    int radius;
-    int exponent;
-    int coeff;
+    ShaderUniform radius;
+    ShaderUniform exponent;
+    ShaderUniform coeff;
 
     BgBloomShader()
     : GLSLShader(SHADER_BGBLOOM, SHADER_HAS_BACK | SHADER_HAS_TEX_SIZE)
@@ -310,29 +324,29 @@ public:
 
     void initialize_parameters()
     {
-        coeff = get_uniform("coeff");
-        radius = get_uniform("radius");
-        exponent = get_uniform("exponent");
+        init_uniform(coeff, "coeff");
+        init_uniform(radius, "radius");
+        init_uniform(exponent, "exponent");
     }
 
     void set_parameters(FrameObject * instance)
     {
-        set_float(instance, "coeff", coeff);
-        set_float(instance, "exponent", exponent);
-        set_float(instance, "radius", radius);
+        set_float(instance, coeff);
+        set_float(instance, exponent);
+        set_float(instance, radius);
     }
 };
 
 class UnderwaterShader : public GLSLShader
 {
 public:
-    int blur;
-    int amplitudeX;
-    int periodsX;
-    int freqX;
-    int amplitudeY;
-    int periodsY;
-    int freqY;
+    ShaderUniform blur;
+    ShaderUniform amplitudeX;
+    ShaderUniform periodsX;
+    ShaderUniform freqX;
+    ShaderUniform amplitudeY;
+    ShaderUniform periodsY;
+    ShaderUniform freqY;
 
     UnderwaterShader()
     : GLSLShader(SHADER_UNDERWATER)
@@ -341,31 +355,31 @@ public:
 
     void initialize_parameters()
     {
-        blur = get_uniform("fBlur");
-        amplitudeX = get_uniform("fAmplitudeX");
-        periodsX = get_uniform("fPeriodsX");
-        freqX = get_uniform("fFreqX");
-        amplitudeY = get_uniform("fAmplitudeY");
-        periodsY = get_uniform("fPeriodsY");
-        freqY = get_uniform("fFreqY");
+        init_uniform(blur, "fBlur");
+        init_uniform(amplitudeX, "fAmplitudeX");
+        init_uniform(periodsX, "fPeriodsX");
+        init_uniform(freqX, "fFreqX");
+        init_uniform(amplitudeY, "fAmplitudeY");
+        init_uniform(periodsY, "fPeriodsY");
+        init_uniform(freqY, "fFreqY");
     }
 
     void set_parameters(FrameObject * instance)
     {
-        set_float(instance, "fBlur", blur);
-        set_float(instance, "fAmplitudeX", amplitudeX);
-        set_float(instance, "fPeriodsX", periodsX);
-        set_float(instance, "fFreqX", freqX);
-        set_float(instance, "fAmplitudeY", amplitudeY);
-        set_float(instance, "fPeriodsY", periodsY);
-        set_float(instance, "fFreqY", freqY);
+        set_float(instance, blur);
+        set_float(instance, amplitudeX);
+        set_float(instance, periodsX);
+        set_float(instance, freqX);
+        set_float(instance, amplitudeY);
+        set_float(instance, periodsY);
+        set_float(instance, freqY);
     }
 };
 
 class RotateSubShader : public GLSLShader
 {
 public:
-    int angle, x, y, shift_x, shift_y;
+    ShaderUniform angle, x, y, shift_x, shift_y;
 
     RotateSubShader()
     : GLSLShader(SHADER_ROTATESUB)
@@ -374,27 +388,27 @@ public:
 
     void initialize_parameters()
     {
-        angle = get_uniform("fA");
-        x = get_uniform("fX");
-        y = get_uniform("fY");
-        shift_x = get_uniform("fSx");
-        shift_y = get_uniform("fSy");
+        init_uniform(angle, "fA");
+        init_uniform(x, "fX");
+        init_uniform(y, "fY");
+        init_uniform(shift_x, "fSx");
+        init_uniform(shift_y, "fSy");
     }
 
     void set_parameters(FrameObject * instance)
     {
-        set_float(instance, "fA", angle);
-        set_float(instance, "fX", x);
-        set_float(instance, "fY", y);
-        set_float(instance, "fSx", shift_x);
-        set_float(instance, "fSy", shift_y);
+        set_float(instance, angle);
+        set_float(instance, x);
+        set_float(instance, y);
+        set_float(instance, shift_x);
+        set_float(instance, shift_y);
     }
 };
 
 class SimpleMaskShader : public GLSLShader
 {
 public:
-    int fade, color;
+    ShaderUniform fade, color;
 
     SimpleMaskShader()
     : GLSLShader(SHADER_SIMPLEMASK)
@@ -403,14 +417,14 @@ public:
 
     void initialize_parameters()
     {
-        color = get_uniform("fC");
-        fade = get_uniform("fFade");
+        init_uniform(color, "fC");
+        init_uniform(fade, "fFade");
     }
 
     void set_parameters(FrameObject * instance)
     {
-        set_float(instance, "fFade", fade);
-        set_vec4(instance, "fC", color);
+        set_float(instance, fade);
+        set_vec4(instance, color);
     }
 };
 
@@ -418,7 +432,7 @@ class OffsetStationaryShader : public GLSLShader
 {
 public:
 
-    int width, height, x_offset, y_offset;
+    ShaderUniform width, height, x_offset, y_offset;
 
     OffsetStationaryShader()
     : GLSLShader(SHADER_OFFSETSTATIONARY)
@@ -427,26 +441,26 @@ public:
 
     void initialize_parameters()
     {
-        width = get_uniform("width");
-        height = get_uniform("height");
-        x_offset = get_uniform("xoff");
-        y_offset = get_uniform("yoff");
+        init_uniform(width, "width");
+        init_uniform(height, "height");
+        init_uniform(x_offset, "xoff");
+        init_uniform(y_offset, "yoff");
     }
 
     void set_parameters(FrameObject * instance)
     {
-        set_float(instance, "width", width);
-        set_float(instance, "height", height);
-        set_float(instance, "xoff", x_offset);
-        set_float(instance, "yoff", y_offset);
+        set_float(instance, width);
+        set_float(instance, height);
+        set_float(instance, x_offset);
+        set_float(instance, y_offset);
     }
 };
 
 class PatternOverlayShader : public GLSLShader
 {
 public:
-    int x, y, width, height;
-    int alpha;
+    ShaderUniform x, y, width, height;
+    ShaderUniform alpha;
 
     PatternOverlayShader()
     : GLSLShader(SHADER_PATTERNOVERLAY, SHADER_HAS_TEX_SIZE, "pattern")
@@ -455,28 +469,28 @@ public:
 
     void initialize_parameters()
     {
-        x = get_uniform("x");
-        y = get_uniform("y");
-        width = get_uniform("width");
-        height = get_uniform("height");
-        alpha = get_uniform("alpha");
+        init_uniform(x, "x");
+        init_uniform(y, "y");
+        init_uniform(width, "width");
+        init_uniform(height, "height");
+        init_uniform(alpha, "alpha");
     }
 
     void set_parameters(FrameObject * instance)
     {
-        set_image(instance, "pattern");
-        set_float(instance, "width", width);
-        set_float(instance, "height", height);
-        set_float(instance, "x", x);
-        set_float(instance, "y", y);
-        set_float(instance, "alpha", alpha);
+        set_image(instance);
+        set_float(instance, width);
+        set_float(instance, height);
+        set_float(instance, x);
+        set_float(instance, y);
+        set_float(instance, alpha);
     }
 };
 
 class SubPxShader : public GLSLShader
 {
 public:
-    int x, y, limit;
+    ShaderUniform x, y, limit;
 
     SubPxShader()
     : GLSLShader(SHADER_SUBPX, SHADER_HAS_TEX_SIZE)
@@ -485,24 +499,24 @@ public:
 
     void initialize_parameters()
     {
-        x = get_uniform("x");
-        y = get_uniform("y");
-        limit = get_uniform("limit");
+        init_uniform(x, "x");
+        init_uniform(y, "y");
+        init_uniform(limit, "limit");
     }
 
     void set_parameters(FrameObject * instance)
     {
-        set_int(instance, "limit", limit);
-        set_float(instance, "x", x);
-        set_float(instance, "y", y);
+        set_int(instance, limit);
+        set_float(instance, x);
+        set_float(instance, y);
     }
 };
 
 class ZoomOffsetShader : public GLSLShader
 {
 public:
-    int x, y, width, height;
-    int zoom_x, zoom_y;
+    ShaderUniform x, y, width, height;
+    ShaderUniform zoom_x, zoom_y;
 
     ZoomOffsetShader()
     : GLSLShader(SHADER_ZOOMOFFSET)
@@ -511,32 +525,32 @@ public:
 
     void initialize_parameters()
     {
-        x = get_uniform("fX");
-        y = get_uniform("fY");
-        width = get_uniform("fWidth");
-        height = get_uniform("fHeight");
-        zoom_x = get_uniform("fZoomX");
-        zoom_y = get_uniform("fZoomY");
+        init_uniform(x, "fX");
+        init_uniform(y, "fY");
+        init_uniform(width, "fWidth");
+        init_uniform(height, "fHeight");
+        init_uniform(zoom_x, "fZoomX");
+        init_uniform(zoom_y, "fZoomY");
     }
 
     void set_parameters(FrameObject * instance)
     {
-        set_float(instance, "fX", x);
-        set_float(instance, "fY", y);
-        set_float(instance, "fZoomX", zoom_x);
-        set_float(instance, "fZoomY", zoom_y);
-        set_float(instance, "fWidth", width);
-        set_float(instance, "fHeight", height);
+        set_float(instance, x);
+        set_float(instance, y);
+        set_float(instance, zoom_x);
+        set_float(instance, zoom_y);
+        set_float(instance, width);
+        set_float(instance, height);
     }
 };
 
 class GradientShader : public GLSLShader
 {
 public:
-    int a_rgb, b_rgb;
-    int a_a, b_a;
-    int coeff, offset, fade;
-    int t, f, r, mask;
+    ShaderUniform a_rgb, b_rgb;
+    ShaderUniform a_a, b_a;
+    ShaderUniform coeff, offset, fade;
+    ShaderUniform t, f, r, mask;
 
     GradientShader()
     : GLSLShader(SHADER_GRADIENT)
@@ -545,39 +559,39 @@ public:
 
     void initialize_parameters()
     {
-        a_rgb = get_uniform("fArgb");
-        a_a = get_uniform("fAa");
-        b_rgb = get_uniform("fBrgb");
-        b_a = get_uniform("fBa");
-        coeff = get_uniform("fCoeff");
-        offset = get_uniform("fOffset");
-        fade = get_uniform("fFade");
-        t = get_uniform("iT");
-        f = get_uniform("iF");
-        r = get_uniform("iR");
-        mask = get_uniform("iMask");
+        init_uniform(a_rgb, "fArgb");
+        init_uniform(a_a, "fAa");
+        init_uniform(b_rgb, "fBrgb");
+        init_uniform(b_a, "fBa");
+        init_uniform(coeff, "fCoeff");
+        init_uniform(offset, "fOffset");
+        init_uniform(fade, "fFade");
+        init_uniform(t, "iT");
+        init_uniform(f, "iF");
+        init_uniform(r, "iR");
+        init_uniform(mask, "iMask");
     }
 
     void set_parameters(FrameObject * instance)
     {
-        set_vec4(instance, "fArgb", a_rgb);
-        set_float(instance, "fAa", a_a);
-        set_vec4(instance, "fBrgb", b_rgb);
-        set_float(instance, "fBa", b_a);
-        set_float(instance, "fCoeff", coeff);
-        set_float(instance, "fOffset", offset);
-        set_float(instance, "fFade", fade);
-        set_int(instance, "iT", t);
-        set_int(instance, "iF", f);
-        set_int(instance, "iR", r);
-        set_int(instance, "iMask", mask);
+        set_vec4(instance, a_rgb);
+        set_float(instance, a_a);
+        set_vec4(instance, b_rgb);
+        set_float(instance, b_a);
+        set_float(instance, coeff);
+        set_float(instance, offset);
+        set_float(instance, fade);
+        set_int(instance, t);
+        set_int(instance, f);
+        set_int(instance, r);
+        set_int(instance, mask);
     }
 };
 
 class OverlayAlphaShader : public GLSLShader
 {
 public:
-    int alpha;
+    ShaderUniform alpha;
 
     OverlayAlphaShader()
     : GLSLShader(SHADER_OVERLAYALPHA, SHADER_HAS_BACK)
@@ -586,19 +600,19 @@ public:
 
     void initialize_parameters()
     {
-        alpha = get_uniform("bgA");
+        init_uniform(alpha, "bgA");
     }
 
     void set_parameters(FrameObject * instance)
     {
-        set_float(instance, "bgA", alpha);
+        set_float(instance, alpha);
     }
 };
 
 class LensShader : public GLSLShader
 {
 public:
-    int coeff, base;
+    ShaderUniform coeff, base;
 
     LensShader()
     : GLSLShader(SHADER_LENS, SHADER_HAS_BACK)
@@ -607,22 +621,22 @@ public:
 
     void initialize_parameters()
     {
-        coeff = get_uniform("fCoeff");
-        base = get_uniform("fBase");
+        init_uniform(coeff, "fCoeff");
+        init_uniform(base, "fBase");
     }
 
     void set_parameters(FrameObject * instance)
     {
-        set_float(instance, "fCoeff", coeff);
-        set_float(instance, "fBase", base);
+        set_float(instance, coeff);
+        set_float(instance, base);
     }
 };
 
 class ColDirBlurShader : public GLSLShader
 {
 public:
-    int rr, rg, rb, gr, gg, gb, br, bg, bb;
-    int angle, coeff;
+    ShaderUniform rr, rg, rb, gr, gg, gb, br, bg, bb;
+    ShaderUniform angle, coeff;
 
     ColDirBlurShader()
     : GLSLShader(SHADER_COLDIRBLUR, SHADER_HAS_BACK)
@@ -631,42 +645,42 @@ public:
 
     void initialize_parameters()
     {
-        rr = get_uniform("rr");
-        rg = get_uniform("rg");
-        rb = get_uniform("rb");
-        gr = get_uniform("gr");
-        gg = get_uniform("gg");
-        gb = get_uniform("gb");
-        br = get_uniform("br");
-        bg = get_uniform("bg");
-        bb = get_uniform("bb");
-        angle = get_uniform("fAngle");
-        coeff = get_uniform("fCoeff");
+        init_uniform(rr, "rr");
+        init_uniform(rg, "rg");
+        init_uniform(rb, "rb");
+        init_uniform(gr, "gr");
+        init_uniform(gg, "gg");
+        init_uniform(gb, "gb");
+        init_uniform(br, "br");
+        init_uniform(bg, "bg");
+        init_uniform(bb, "bb");
+        init_uniform(angle, "fAngle");
+        init_uniform(coeff, "fCoeff");
     }
 
     void set_parameters(FrameObject * instance)
     {
-        set_float(instance, "rr", rr);
-        set_float(instance, "rg", rg);
-        set_float(instance, "rb", rb);
-        set_float(instance, "gr", gr);
-        set_float(instance, "gg", gg);
-        set_float(instance, "gb", gb);
-        set_float(instance, "br", br);
-        set_float(instance, "bg", bg);
-        set_float(instance, "bb", bb);
-        set_float(instance, "fAngle", angle);
-        set_float(instance, "fCoeff", coeff);
+        set_float(instance, rr);
+        set_float(instance, rg);
+        set_float(instance, rb);
+        set_float(instance, gr);
+        set_float(instance, gg);
+        set_float(instance, gb);
+        set_float(instance, br);
+        set_float(instance, bg);
+        set_float(instance, bb);
+        set_float(instance, angle);
+        set_float(instance, coeff);
     }
 };
 
 class PerspectiveShader : public GLSLShader
 {
 public:
-    int effect;
-    int direction, perspective_dir;
-    int zoom, offset;
-    int sine_waves;
+    ShaderUniform effect;
+    ShaderUniform direction, perspective_dir;
+    ShaderUniform zoom, offset;
+    ShaderUniform sine_waves;
 
     PerspectiveShader()
     : GLSLShader(SHADER_PERSPECTIVE, SHADER_HAS_TEX_SIZE)
@@ -675,31 +689,31 @@ public:
 
     void initialize_parameters()
     {
-        effect = get_uniform("effect");
-        direction = get_uniform("direction");
-        perspective_dir = get_uniform("perspective_dir");
-        zoom = get_uniform("zoom");
-        offset = get_uniform("offset");
-        sine_waves = get_uniform("sine_waves");
+        init_uniform(effect, "effect");
+        init_uniform(direction, "direction");
+        init_uniform(perspective_dir, "perspective_dir");
+        init_uniform(zoom, "zoom");
+        init_uniform(offset, "offset");
+        init_uniform(sine_waves, "sine_waves");
     }
 
     void set_parameters(FrameObject * instance)
     {
-        set_int(instance, "effect", effect);
-        set_int(instance, "direction", direction);
-        set_int(instance, "perspective_dir", perspective_dir);
-        set_float(instance, "zoom", zoom);
-        set_float(instance, "offset", offset);
-        set_int(instance, "sine_waves", sine_waves);
+        set_int(instance, effect);
+        set_int(instance, direction);
+        set_int(instance, perspective_dir);
+        set_float(instance, zoom);
+        set_float(instance, offset);
+        set_int(instance, sine_waves);
     }
 };
 
 class NinePatchShader : public GLSLShader
 {
 public:
-    int x_scale, y_scale;
-    int color_1, alpha_1, color_2, alpha_2;
-    int coeff, offset, fade;
+    ShaderUniform x_scale, y_scale;
+    ShaderUniform color_1, alpha_1, color_2, alpha_2;
+    ShaderUniform coeff, offset, fade;
 
     NinePatchShader()
     : GLSLShader(SHADER_9G, SHADER_HAS_TEX_SIZE)
@@ -708,35 +722,35 @@ public:
 
     void initialize_parameters()
     {
-        x_scale = get_uniform("x_scale");
-        y_scale = get_uniform("y_scale");
-        color_1 = get_uniform("color_1");
-        alpha_1 = get_uniform("alpha_1");
-        color_2 = get_uniform("color_2");
-        alpha_2 = get_uniform("alpha_2");
-        coeff = get_uniform("coeff");
-        offset = get_uniform("offset");
-        fade = get_uniform("fade");
+        init_uniform(x_scale, "x_scale", "xScale");
+        init_uniform(y_scale, "y_scale", "yScale");
+        init_uniform(color_1, "color_1", "fArgb");
+        init_uniform(alpha_1, "alpha_1", "fAa");
+        init_uniform(color_2, "color_2", "fBrgb");
+        init_uniform(alpha_2, "alpha_2", "fBa");
+        init_uniform(coeff, "coeff", "fCoeff");
+        init_uniform(offset, "offset", "fOffset");
+        init_uniform(fade, "fade", "fFade");
     }
 
     void set_parameters(FrameObject * instance)
     {
-        set_float(instance, "xScale", x_scale);
-        set_float(instance, "yScale", y_scale);
-        set_vec4(instance, "fArgb", color_1);
-        set_float(instance, "fAa", alpha_1);
-        set_vec4(instance, "fBrgb", color_2);
-        set_float(instance, "fBa", alpha_2);
-        set_float(instance, "fCoeff", coeff);
-        set_float(instance, "fOffset", offset);
-        set_float(instance, "fFade", fade);
+        set_float(instance, x_scale);
+        set_float(instance, y_scale);
+        set_vec4(instance, color_1);
+        set_float(instance, alpha_1);
+        set_vec4(instance, color_2);
+        set_float(instance, alpha_2);
+        set_float(instance, coeff);
+        set_float(instance, offset);
+        set_float(instance, fade);
     }
 };
 
 class PixelOutlineShader : public GLSLShader
 {
 public:
-    int color;
+    ShaderUniform color;
 
     PixelOutlineShader()
     : GLSLShader(SHADER_PIXELOUTLINE, SHADER_HAS_TEX_SIZE)
@@ -745,19 +759,19 @@ public:
 
     void initialize_parameters()
     {
-        color = get_uniform("color");
+        init_uniform(color, "color");
     }
 
     void set_parameters(FrameObject * instance)
     {
-        set_vec4(instance, "color", color);
+        set_vec4(instance, color);
     }
 };
 
 class BrightSatBgShader : public GLSLShader
 {
 public:
-    int brightness, saturation;
+    ShaderUniform brightness, saturation;
 
     BrightSatBgShader()
     : GLSLShader(SHADER_BRIGHTSATBG, SHADER_HAS_BACK)
@@ -766,21 +780,21 @@ public:
 
     void initialize_parameters()
     {
-        brightness = get_uniform("brightness");
-        saturation = get_uniform("saturation");
+        init_uniform(brightness, "brightness", "Brightness");
+        init_uniform(saturation, "saturation", "Saturation");
     }
 
     void set_parameters(FrameObject * instance)
     {
-        set_float(instance, "Brightness", brightness);
-        set_float(instance, "Saturation", saturation);
+        set_float(instance, brightness);
+        set_float(instance, saturation);
     }
 };
 
 class BgBlurShader : public GLSLShader
 {
 public:
-    int x, y, alpha;
+    ShaderUniform x, y, alpha;
 
     BgBlurShader()
     : GLSLShader(SHADER_BGBLUR, SHADER_HAS_BACK | SHADER_HAS_TEX_SIZE)
@@ -789,16 +803,16 @@ public:
 
     void initialize_parameters()
     {
-        x = get_uniform("x");
-        y = get_uniform("y");
-        alpha = get_uniform("alpha");
+        init_uniform(x, "x", "fX");
+        init_uniform(y, "y", "fY");
+        init_uniform(alpha, "alpha", "fA");
     }
 
     void set_parameters(FrameObject * instance)
     {
-        set_float(instance, "fX", x);
-        set_float(instance, "fY", y);
-        set_float(instance, "fA", alpha);
+        set_float(instance, x);
+        set_float(instance, y);
+        set_float(instance, alpha);
     }
 };
 
@@ -3,6 +3,7 @@
 
 #include <string>
 #include "image.h"
+#include "shaderparams.h"
 
 // GLES attrib indexes
 #define MAX_ATTRIB 4
@@ -32,6 +33,10 @@ void set_shader_path(const std::string & path);
 void init_shaders();
 void convert_vec4(int value, float & a, float & b, float & c, float & d);
 
+// instances store their shader parameters in a flat array with a slot for
+// every parameter name the game uses. returns -1 for unknown names.
+int get_shader_parameter_slot(const std::string & name);
+
 class Shader
 {
 public:
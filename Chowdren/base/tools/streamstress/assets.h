@@ -0,0 +1,12 @@
+#ifndef CHOWDREN_ASSETS_H
+#define CHOWDREN_ASSETS_H
+
+// stands in for the generated header, the stress test has no assets
+
+#define IMAGE_COUNT 0
+#define SOUND_COUNT 0
+#define FONT_COUNT 0
+#define SHADER_COUNT 0
+#define ATLAS_COUNT 0
+
+#endif // CHOWDREN_ASSETS_H
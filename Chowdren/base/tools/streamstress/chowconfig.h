@@ -0,0 +1,11 @@
+#ifndef CHOWDREN_CONFIG_H
+#define CHOWDREN_CONFIG_H
+
+// stands in for the generated header
+
+#define NAME "streamstress"
+#define WINDOW_WIDTH 640
+#define WINDOW_HEIGHT 480
+#define FRAMERATE 60
+
+#endif // CHOWDREN_CONFIG_H
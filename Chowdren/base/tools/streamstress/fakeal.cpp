@@ -0,0 +1,317 @@
+// time-based OpenAL stand-in for the stream stress test. sources consume
+// their queued buffers in real time, so the streaming thread has to keep up
+// the same way it does with a device. a source that runs out of queued
+// buffers while playing counts as an underrun.
+//
+// fake_stop_delay makes every state query that reports a stopped source take
+// that many microseconds, like a slow device can. that widens the window
+// between the streaming thread seeing the end of a stream and acting on it.
+
+#include <al.h>
+#include <alc.h>
+#include <map>
+#include <deque>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/chrono.hpp>
+
+int fake_underruns = 0;
+int fake_stop_delay = 0;
+
+struct FakeBuffer
+{
+    int frames;
+    int channels;
+    int rate;
+    int bytes;
+};
+
+struct FakeSource
+{
+    ALint state;
+    std::deque<ALuint> queue;
+    size_t processed;
+    double position;
+    double last_time;
+    float pitch;
+};
+
+static boost::mutex fake_lock;
+static std::map<ALuint, FakeBuffer> buffers;
+static std::map<ALuint, FakeSource> sources;
+static ALuint next_name = 1;
+
+static double get_time()
+{
+    return boost::chrono::duration<double>(
+        boost::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void advance(FakeSource & source)
+{
+    double now = get_time();
+    double elapsed = (now - source.last_time) * source.pitch;
+    source.last_time = now;
+    if (source.state != AL_PLAYING)
+        return;
+    while (source.processed < source.queue.size()) {
+        FakeBuffer & buffer = buffers[source.queue[source.processed]];
+        double left = buffer.frames - source.position;
+        double frames = elapsed * buffer.rate;
+        if (frames < left) {
+            source.position += frames;
+            return;
+        }
+        elapsed -= left / buffer.rate;
+        source.position = 0.0;
+        source.processed++;
+    }
+    if (!source.queue.empty())
+        fake_underruns++;
+    source.state = AL_STOPPED;
+}
+
+extern "C" {
+
+ALenum alGetError()
+{
+    return AL_NO_ERROR;
+}
+
+void alGenSources(ALsizei n, ALuint * names)
+{
+    boost::mutex::scoped_lock guard(fake_lock);
+    for (ALsizei i = 0; i < n; i++) {
+        names[i] = next_name++;
+        FakeSource & source = sources[names[i]];
+        source.state = AL_INITIAL;
+        source.processed = 0;
+        source.position = 0.0;
+        source.last_time = get_time();
+        source.pitch = 1.0f;
+    }
+}
+
+void alDeleteSources(ALsizei n, const ALuint * names)
+{
+    boost::mutex::scoped_lock guard(fake_lock);
+    for (ALsizei i = 0; i < n; i++)
+        sources.erase(names[i]);
+}
+
+void alGenBuffers(ALsizei n, ALuint * names)
+{
+    boost::mutex::scoped_lock guard(fake_lock);
+    for (ALsizei i = 0; i < n; i++) {
+        names[i] = next_name++;
+        FakeBuffer buffer = {0, 1, 1, 0};
+        buffers[names[i]] = buffer;
+    }
+}
+
+void alDeleteBuffers(ALsizei n, const ALuint * names)
+{
+    boost::mutex::scoped_lock guard(fake_lock);
+    for (ALsizei i = 0; i < n; i++)
+        buffers.erase(names[i]);
+}
+
+void alBufferData(ALuint name, ALenum format, const ALvoid * data,
+                  ALsizei size, ALsizei rate)
+{
+    boost::mutex::scoped_lock guard(fake_lock);
+    FakeBuffer & buffer = buffers[name];
+    buffer.channels = format == AL_FORMAT_STEREO16 ? 2 : 1;
+    buffer.rate = rate;
+    buffer.bytes = size;
+    buffer.frames = size / 2 / buffer.channels;
+}
+
+void alGetBufferi(ALuint name, ALenum param, ALint * value)
+{
+    boost::mutex::scoped_lock guard(fake_lock);
+    if (param == AL_SIZE)
+        *value = buffers[name].bytes;
+    else if (param == AL_BITS)
+        *value = 16;
+    else
+        *value = 0;
+}
+
+void alSourceQueueBuffers(ALuint name, ALsizei n, const ALuint * names)
+{
+    boost::mutex::scoped_lock guard(fake_lock);
+    FakeSource & source = sources[name];
+    advance(source);
+    for (ALsizei i = 0; i < n; i++)
+        source.queue.push_back(names[i]);
+}
+
+void alSourceUnqueueBuffers(ALuint name, ALsizei n, ALuint * names)
+{
+    boost::mutex::scoped_lock guard(fake_lock);
+    FakeSource & source = sources[name];
+    advance(source);
+    for (ALsizei i = 0; i < n; i++) {
+        if (source.queue.empty())
+            return;
+        names[i] = source.queue.front();
+        source.queue.pop_front();
+        if (source.processed > 0)
+            source.processed--;
+    }
+}
+
+void alSourcePlay(ALuint name)
+{
+    boost::mutex::scoped_lock guard(fake_lock);
+    FakeSource & source = sources[name];
+    advance(source);
+    if (source.state == AL_STOPPED || source.state == AL_INITIAL) {
+        source.processed = 0;
+        source.position = 0.0;
+    }
+    source.state = AL_PLAYING;
+}
+
+void alSourceStop(ALuint name)
+{
+    boost::mutex::scoped_lock guard(fake_lock);
+    FakeSource & source = sources[name];
+    advance(source);
+    source.state = AL_STOPPED;
+    source.processed = source.queue.size();
+}
+
+void alSourcePause(ALuint name)
+{
+    boost::mutex::scoped_lock guard(fake_lock);
+    FakeSource & source = sources[name];
+    advance(source);
+    if (source.state == AL_PLAYING)
+        source.state = AL_PAUSED;
+}
+
+void alSourcei(ALuint name, ALenum param, ALint value)
+{
+    boost::mutex::scoped_lock guard(fake_lock);
+    FakeSource & source = sources[name];
+    if (param != AL_BUFFER || value != 0)
+        return;
+    source.queue.clear();
+    source.processed = 0;
+    source.position = 0.0;
+}
+
+void alSourcef(ALuint name, ALenum param, ALfloat value)
+{
+    boost::mutex::scoped_lock guard(fake_lock);
+    if (param == AL_PITCH)
+        sources[name].pitch = value;
+}
+
+void alSource3f(ALuint name, ALenum param, ALfloat a, ALfloat b, ALfloat c)
+{
+}
+
+void alGetSourcei(ALuint name, ALenum param, ALint * value)
+{
+    boost::mutex::scoped_lock guard(fake_lock);
+    FakeSource & source = sources[name];
+    advance(source);
+    switch (param) {
+        case AL_SOURCE_STATE:
+            *value = source.state;
+            if (source.state != AL_STOPPED || fake_stop_delay == 0)
+                break;
+            guard.unlock();
+            boost::this_thread::sleep_for(
+                boost::chrono::microseconds(fake_stop_delay));
+            break;
+        case AL_BUFFERS_PROCESSED:
+            *value = source.processed;
+            break;
+        case AL_BUFFERS_QUEUED:
+            *value = source.queue.size();
+            break;
+        case AL_BUFFER:
+            if (source.processed < source.queue.size())
+                *value = source.queue[source.processed];
+            else
+                *value = 0;
+            break;
+        case AL_SAMPLE_OFFSET:
+            *value = ALint(source.position);
+            break;
+        default:
+            *value = 0;
+            break;
+    }
+}
+
+void alGetSourcef(ALuint name, ALenum param, ALfloat * value)
+{
+    boost::mutex::scoped_lock guard(fake_lock);
+    FakeSource & source = sources[name];
+    advance(source);
+    *value = 0.0f;
+    if (param != AL_SEC_OFFSET || source.processed >= source.queue.size())
+        return;
+    FakeBuffer & buffer = buffers[source.queue[source.processed]];
+    *value = source.position / buffer.rate;
+}
+
+void alListenerf(ALenum param, ALfloat value)
+{
+}
+
+void alGetListenerf(ALenum param, ALfloat * value)
+{
+    *value = 1.0f;
+}
+
+ALenum alGetEnumValue(const ALchar * name)
+{
+    return 0;
+}
+
+const ALchar * alGetString(ALenum param)
+{
+    return "fake";
+}
+
+ALboolean alIsExtensionPresent(const ALchar * name)
+{
+    return AL_FALSE;
+}
+
+void * alGetProcAddress(const ALchar * name)
+{
+    return NULL;
+}
+
+ALCdevice * alcOpenDevice(const ALCchar * name)
+{
+    return (ALCdevice*)1;
+}
+
+ALCcontext * alcCreateContext(ALCdevice * device, const ALCint * attributes)
+{
+    return (ALCcontext*)1;
+}
+
+ALCboolean alcMakeContextCurrent(ALCcontext * context)
+{
+    return ALC_TRUE;
+}
+
+void alcDestroyContext(ALCcontext * context)
+{
+}
+
+ALCboolean alcCloseDevice(ALCdevice * device)
+{
+    return ALC_TRUE;
+}
+
+} // extern "C"
@@ -0,0 +1,277 @@
+// stress test for the audio streaming thread. plays a number of WAV
+// streams against the time-based OpenAL stand-in in fakeal.cpp, and keeps
+// seeking, pausing, resuming, replaying and querying random streams from the
+// game thread. reports the slowest game-thread call and the buffer
+// underruns, and checks that the state reported right after a command is the
+// one that was asked for. afterwards, replays short one-shot streams right
+// as they run out and checks that a stop() after that still stops them.
+//
+// usage: streamstress [streams] [seconds]
+//
+// build with "make" in this directory. exits with 1 if a check failed or a
+// stream ran dry.
+
+#include "media.h"
+#include "desktop/audio.h"
+#include <iostream>
+#include <stdlib.h>
+#include <boost/chrono.hpp>
+
+using namespace ChowdrenAudio;
+
+extern int fake_underruns;
+extern int fake_stop_delay;
+
+// the streams are read from memory, so the file layer is never used
+
+BaseFile::BaseFile()
+: handle(NULL), closed(true)
+{
+}
+
+BaseFile::~BaseFile()
+{
+}
+
+void BaseFile::open(const char * filename, const char * mode)
+{
+}
+
+bool BaseFile::seek(size_t v, int origin)
+{
+    return false;
+}
+
+size_t BaseFile::tell()
+{
+    return 0;
+}
+
+size_t BaseFile::read(void * data, size_t size)
+{
+    return 0;
+}
+
+AssetFile::AssetFile()
+{
+}
+
+void AssetFile::open()
+{
+}
+
+// no Vorbis either
+
+extern "C" {
+
+int ov_open_callbacks(void * source, OggVorbis_File * vf,
+                      const char * initial, long ibytes,
+                      ov_callbacks callbacks)
+{
+    return -1;
+}
+
+vorbis_info * ov_info(OggVorbis_File * vf, int link)
+{
+    return NULL;
+}
+
+int ov_clear(OggVorbis_File * vf)
+{
+    return 0;
+}
+
+ogg_int64_t ov_pcm_total(OggVorbis_File * vf, int i)
+{
+    return 0;
+}
+
+long ov_read(OggVorbis_File * vf, char * buffer, int length, int bigendianp,
+             int word, int sgned, int * bitstream)
+{
+    return 0;
+}
+
+int ov_pcm_seek(OggVorbis_File * vf, ogg_int64_t pos)
+{
+    return 0;
+}
+
+int ov_time_seek(OggVorbis_File * vf, double pos)
+{
+    return 0;
+}
+
+} // extern "C"
+
+static void write_u32(std::string & out, unsigned int value)
+{
+    out.append((const char*)&value, 4);
+}
+
+static void write_u16(std::string & out, unsigned short value)
+{
+    out.append((const char*)&value, 2);
+}
+
+static std::string make_wav(double seconds, int rate, int channels)
+{
+    unsigned int size = int(seconds * rate) * channels * 2;
+    std::string out;
+    out += "RIFF";
+    write_u32(out, 36 + size);
+    out += "WAVEfmt ";
+    write_u32(out, 16);
+    write_u16(out, 1);
+    write_u16(out, channels);
+    write_u32(out, rate);
+    write_u32(out, rate * channels * 2);
+    write_u16(out, channels * 2);
+    write_u16(out, 16);
+    out += "data";
+    write_u32(out, size);
+    out.append(size, '\1');
+    return out;
+}
+
+static double get_time()
+{
+    return boost::chrono::duration<double>(
+        boost::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int failures = 0;
+
+static void check(bool value, const char * name)
+{
+    if (value)
+        return;
+    failures++;
+    if (failures <= 10)
+        std::cout << "Check failed: " << name << std::endl;
+}
+
+static void sleep_seconds(double seconds)
+{
+    boost::this_thread::sleep_for(
+        boost::chrono::duration_cast<boost::chrono::nanoseconds>(
+            boost::chrono::duration<double>(seconds)));
+}
+
+// posts play() at a spread of times around the end of a batch of one-shot
+// streams, so it races the streaming thread noticing that a source has
+// stopped
+
+#define END_STREAMS 16
+#define END_ROUNDS 100
+#define END_LENGTH 0.1
+
+static void test_end_of_stream()
+{
+    fake_stop_delay = 2000;
+    std::string wav = make_wav(END_LENGTH, 22050, 2);
+    vector<SoundStream*> streams;
+    for (int i = 0; i < END_STREAMS; i++)
+        streams.push_back(new SoundStream(wav.data(), Media::WAV,
+                                          wav.size()));
+    for (int round = 0; round < END_ROUNDS; round++) {
+        for (int i = 0; i < END_STREAMS; i++)
+            streams[i]->play();
+        sleep_seconds(END_LENGTH - 0.01 + (round % 20) * 0.001);
+        for (int i = 0; i < END_STREAMS; i++) {
+            streams[i]->play();
+            sleep_seconds(0.0002);
+        }
+        for (int i = 0; i < END_STREAMS; i++)
+            streams[i]->stop();
+        sleep_seconds(0.02);
+        for (int i = 0; i < END_STREAMS; i++)
+            check(streams[i]->get_status() == SoundBase::Stopped,
+                  "stopped after replay at end of stream");
+    }
+    for (int i = 0; i < END_STREAMS; i++)
+        streams[i]->destroy();
+    fake_stop_delay = 0;
+}
+
+int main(int argc, char ** argv)
+{
+    int count = argc > 1 ? atoi(argv[1]) : 32;
+    double seconds = argc > 2 ? atof(argv[2]) : 6.0;
+    srand(0);
+
+    open_audio();
+    std::string wav = make_wav(4, 22050, 2);
+    vector<SoundStream*> streams;
+    double worst = 0.0;
+    for (int i = 0; i < count; i++) {
+        double start = get_time();
+        SoundStream * stream = new SoundStream(wav.data(), Media::WAV,
+                                               wav.size());
+        stream->set_loop(i % 2 == 0);
+        stream->play();
+        worst = std::max(worst, get_time() - start);
+        streams.push_back(stream);
+    }
+
+    double start = get_time();
+    int calls = 0;
+    while (get_time() - start < seconds) {
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(5));
+        SoundStream * stream = streams[rand() % count];
+        double call_start = get_time();
+        double offset;
+        switch (rand() % 5) {
+            case 0:
+                stream->set_playing_offset(1.0);
+                check(stream->get_status() == SoundBase::Playing,
+                      "playing after seek");
+                // the streaming thread may already have restarted it
+                offset = stream->get_playing_offset();
+                check(offset >= 1.0 && offset < 1.1, "offset after seek");
+                break;
+            case 1:
+                stream->get_status();
+                break;
+            case 2:
+                stream->get_playing_offset();
+                break;
+            case 3:
+                if (stream->get_status() == SoundBase::Stopped)
+                    stream->play();
+                break;
+            case 4:
+                // a quick pause and resume, as Channel does it
+                if (stream->get_status() != SoundBase::Playing)
+                    break;
+                stream->pause();
+                check(stream->get_status() == SoundBase::Paused,
+                      "paused after pause");
+                stream->play();
+                check(stream->get_status() == SoundBase::Playing,
+                      "playing after resume");
+                break;
+        }
+        calls++;
+        worst = std::max(worst, get_time() - call_start);
+    }
+
+    // nothing may be left paused by a lost resume
+    boost::this_thread::sleep_for(boost::chrono::milliseconds(50));
+    for (int i = 0; i < count; i++) {
+        check(streams[i]->get_status() != SoundBase::Paused,
+              "no stream left paused");
+        streams[i]->destroy();
+    }
+    // the one-shot streams below run out on purpose
+    int underruns = fake_underruns;
+    test_end_of_stream();
+    close_audio();
+
+    std::cout << count << " streams, " << calls << " calls, slowest "
+        << worst * 1000.0 << " ms, " << underruns << " underruns, "
+        << failures << " failed checks" << std::endl;
+    if (failures != 0 || underruns != 0)
+        return 1;
+    return 0;
+}
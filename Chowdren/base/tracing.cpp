@@ -0,0 +1,257 @@
+#include "chowconfig.h"
+
+#ifdef CHOWDREN_USE_TRACING
+
+#include "tracing.h"
+#include "fileio.h"
+#include "platform.h"
+#include "types.h"
+#include <boost/atomic.hpp>
+#include <boost/chrono.hpp>
+#include <boost/cstdint.hpp>
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <stdio.h>
+
+#ifdef _MSC_VER
+#define TRACE_THREAD_LOCAL __declspec(thread)
+#else
+#define TRACE_THREAD_LOCAL __thread
+#endif
+
+#define TRACE_MASK (CHOWDREN_TRACE_EVENTS - 1)
+
+typedef boost::chrono::high_resolution_clock trace_clock;
+
+struct TraceRecord
+{
+    boost::int64_t time;
+    // NULL for the end of a zone
+    const char * name;
+};
+
+// written only by its own thread. the dump reads it from another thread and
+// throws away whatever may have been overwritten while it was copying.
+struct TraceBuffer
+{
+    TraceRecord records[CHOWDREN_TRACE_EVENTS];
+    boost::atomic<unsigned int> pos;
+    int id;
+    const char * name;
+    TraceBuffer * next;
+};
+
+static boost::atomic<TraceBuffer*> trace_buffers(NULL);
+static boost::atomic<int> trace_thread_count(0);
+static TRACE_THREAD_LOCAL TraceBuffer * thread_buffer = NULL;
+static trace_clock::time_point trace_start = trace_clock::now();
+
+static boost::int64_t get_trace_time()
+{
+    return boost::chrono::duration_cast<boost::chrono::nanoseconds>(
+        trace_clock::now() - trace_start).count();
+}
+
+static TraceBuffer * get_trace_buffer()
+{
+    TraceBuffer * buffer = thread_buffer;
+    if (buffer != NULL)
+        return buffer;
+    // buffers are never freed, so the records of finished threads can
+    // still be dumped
+    buffer = new TraceBuffer;
+    buffer->pos.store(0, boost::memory_order_relaxed);
+    buffer->id = ++trace_thread_count;
+    buffer->name = NULL;
+    TraceBuffer * head = trace_buffers.load(boost::memory_order_relaxed);
+    do {
+        buffer->next = head;
+    } while (!trace_buffers.compare_exchange_weak(head, buffer,
+                                                   boost::memory_order_release,
+                                                   boost::memory_order_relaxed));
+    thread_buffer = buffer;
+    return buffer;
+}
+
+static void trace_push(const char * name)
+{
+    TraceBuffer * buffer = get_trace_buffer();
+    unsigned int pos = buffer->pos.load(boost::memory_order_relaxed);
+    TraceRecord & record = buffer->records[pos & TRACE_MASK];
+    record.time = get_trace_time();
+    record.name = name;
+    buffer->pos.store(pos + 1, boost::memory_order_release);
+}
+
+void trace_begin(const char * name)
+{
+    trace_push(name);
+}
+
+void trace_end()
+{
+    trace_push(NULL);
+}
+
+void trace_set_thread_name(const char * name)
+{
+    get_trace_buffer()->name = name;
+}
+
+// dump
+
+static void copy_records(TraceBuffer * buffer, vector<TraceRecord> & out)
+{
+    unsigned int end = buffer->pos.load(boost::memory_order_acquire);
+    unsigned int count = std::min<unsigned int>(end, CHOWDREN_TRACE_EVENTS);
+    unsigned int start = end - count;
+    out.resize(count);
+    for (unsigned int i = 0; i < count; i++)
+        out[i] = buffer->records[(start + i) & TRACE_MASK];
+
+    // drop the records the thread may have overwritten in the meantime. the
+    // slot of the record at new_end may be half-written already, so it
+    // counts as overwritten too.
+    boost::atomic_thread_fence(boost::memory_order_acquire);
+    unsigned int new_end = buffer->pos.load(boost::memory_order_relaxed);
+    unsigned int span = new_end + 1 - start;
+    if (span <= CHOWDREN_TRACE_EVENTS)
+        return;
+    unsigned int lost = span - CHOWDREN_TRACE_EVENTS;
+    if (lost >= count)
+        out.clear();
+    else
+        out.erase(out.begin(), out.begin() + lost);
+}
+
+static void write_escaped(std::string & out, const char * value)
+{
+    for (; *value != '\0'; value++) {
+        char c = *value;
+        if (c == '"' || c == '\\')
+            out += '\\';
+        if ((unsigned char)c < 0x20)
+            continue;
+        out += c;
+    }
+}
+
+static void write_event(std::string & out, const char * name, char phase,
+                        boost::int64_t time, int tid)
+{
+    char buf[96];
+    out += ",\n{\"name\":\"";
+    write_escaped(out, name);
+    sprintf(buf, "\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}",
+            phase, time / 1000.0, tid);
+    out += buf;
+}
+
+static void write_buffer(std::string & out, TraceBuffer * buffer,
+                         vector<TraceRecord> & records,
+                         boost::int64_t dump_time)
+{
+    char buf[64];
+    const char * name = buffer->name;
+    if (name == NULL) {
+        sprintf(buf, "thread %d", buffer->id);
+        name = buf;
+    }
+    out += ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,";
+    sprintf(buf, "\"tid\":%d,\"args\":{\"name\":\"", buffer->id);
+    out += buf;
+    write_escaped(out, name);
+    out += "\"}}";
+
+    // the oldest zones may have lost their begin record to the ring buffer,
+    // so their ends are skipped. zones that are still open are closed at
+    // the time of the dump.
+    vector<const char*> open;
+    vector<TraceRecord>::const_iterator it;
+    for (it = records.begin(); it != records.end(); ++it) {
+        const TraceRecord & record = *it;
+        if (record.name != NULL) {
+            open.push_back(record.name);
+            write_event(out, record.name, 'B', record.time, buffer->id);
+            continue;
+        }
+        if (open.empty())
+            continue;
+        write_event(out, open.back(), 'E', record.time, buffer->id);
+        open.pop_back();
+    }
+    while (!open.empty()) {
+        write_event(out, open.back(), 'E', dump_time, buffer->id);
+        open.pop_back();
+    }
+}
+
+bool trace_dump(const char * filename)
+{
+    boost::int64_t dump_time = get_trace_time();
+    std::string out;
+    out.reserve(1024 * 1024);
+    out += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+           "\"args\":{\"name\":\"";
+    write_escaped(out, NAME);
+    out += "\"}}";
+
+    vector<TraceRecord> records;
+    TraceBuffer * buffer = trace_buffers.load(boost::memory_order_acquire);
+    for (; buffer != NULL; buffer = buffer->next) {
+        copy_records(buffer, records);
+        write_buffer(out, buffer, records, dump_time);
+    }
+    out += "\n]}\n";
+
+    FSFile fp(convert_path(filename).c_str(), "w");
+    if (!fp.is_open()) {
+        std::cout << "Could not write trace: " << filename << std::endl;
+        return false;
+    }
+    fp.write(out.data(), out.size());
+    fp.close();
+    return true;
+}
+
+static int dump_index = 0;
+
+void trace_dump()
+{
+    char filename[256];
+    sprintf(filename, CHOWDREN_TRACE_FILE, ++dump_index);
+    std::cout << "Writing trace to " << filename << std::endl;
+    trace_dump(filename);
+}
+
+// slow frames
+
+static boost::int64_t frame_start = 0;
+static boost::int64_t last_dump = -1;
+
+void trace_frame_start()
+{
+    trace_begin("frame");
+    frame_start = get_trace_time();
+}
+
+void trace_frame_end()
+{
+    trace_end();
+    boost::int64_t now = get_trace_time();
+    boost::int64_t frame_time = now - frame_start;
+    if (frame_time < boost::int64_t(CHOWDREN_TRACE_SLOW_FRAME * 1e9))
+        return;
+    // writing a dump is slow in itself, so don't dump the frames after it
+    if (last_dump >= 0 && now - last_dump < 1000000000)
+        return;
+
+    std::cout << "Slow frame (" << frame_time / 1000000.0 << " ms)"
+        << std::endl;
+    trace_dump();
+    last_dump = get_trace_time();
+}
+
+#endif // CHOWDREN_USE_TRACING
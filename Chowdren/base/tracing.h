@@ -0,0 +1,83 @@
+#ifndef CHOWDREN_TRACING_H
+#define CHOWDREN_TRACING_H
+
+// timeline tracing. each thread writes timestamped begin/end records to its
+// own ring buffer without locking, and the buffers can be written out as
+// Chrome trace event JSON (chrome://tracing or ui.perfetto.dev).
+// zone names must be string literals, only the pointer is stored.
+
+#include "chowconfig.h"
+
+#ifndef CHOWDREN_TRACE_EVENTS
+// records kept per thread, must be a power of two
+#define CHOWDREN_TRACE_EVENTS 65536
+#endif
+
+#ifndef CHOWDREN_TRACE_SLOW_FRAME
+// frames that take longer than this (in seconds) dump the trace
+#define CHOWDREN_TRACE_SLOW_FRAME 0.033
+#endif
+
+#ifndef CHOWDREN_TRACE_FILE
+// printf format, gets the number of the dump
+#define CHOWDREN_TRACE_FILE "trace_%d.json"
+#endif
+
+#ifndef CHOWDREN_TRACE_KEY
+// dumps the trace on demand
+#define CHOWDREN_TRACE_KEY SDLK_F12
+#endif
+
+void trace_begin(const char * name);
+void trace_end();
+void trace_set_thread_name(const char * name);
+bool trace_dump(const char * filename);
+// writes the next numbered CHOWDREN_TRACE_FILE
+void trace_dump();
+
+// called around each game frame, dumps the trace after a slow one
+void trace_frame_start();
+void trace_frame_end();
+
+// the zone of one game frame. end() closes it early, otherwise it is closed
+// when the frame returns
+class TraceFrame
+{
+public:
+    bool open;
+
+    TraceFrame()
+    : open(true)
+    {
+        trace_frame_start();
+    }
+
+    ~TraceFrame()
+    {
+        end();
+    }
+
+    void end()
+    {
+        if (!open)
+            return;
+        open = false;
+        trace_frame_end();
+    }
+};
+
+class TraceBlock
+{
+public:
+    TraceBlock(const char * name)
+    {
+        trace_begin(name);
+    }
+
+    ~TraceBlock()
+    {
+        trace_end();
+    }
+};
+
+#endif // CHOWDREN_TRACING_H
@@ -10,7 +10,10 @@ SHADER_COUNT offsets for each shader
 Images:
     X, Y hotspot (short)
     X, Y action point (short)
-    PNG image
+    atlas page (short, only with CHOWDREN_TEXTURE_ATLAS, -1 if not packed)
+    PNG image, or for packed images:
+        X, Y, width, height in the atlas page (short)
+        alpha bits, one per pixel in row order
 
 Sounds:
     uint32 type
@@ -22,10 +25,16 @@ Fonts:
 
 Shaders:
     data (could be uint32 vert + data, uint32 frag + data)
+
+Atlases:
+    PNG image
 """
 
 NONE_TYPE, WAV_TYPE, OGG_TYPE, NATIVE_TYPE = xrange(4)
 
+ATLAS_SIZE = 1024
+ATLAS_MAX_IMAGE = 256
+
 AUDIO_TYPES = {
     'wav': WAV_TYPE,
     'ogg': OGG_TYPE
@@ -35,6 +44,26 @@ import os
 from chowdren.shader import get_shader_programs
 from chowdren.common import get_method_name
 from mmfparser.bytereader import ByteReader
+from mmfparser import texpack
+from PIL import Image
+
+def get_pow2(value):
+    ret = 1
+    while ret < value:
+        ret *= 2
+    return ret
+
+def get_padded(image):
+    # extrude the edges by a pixel so linear filtering does not pick up
+    # neighbours in the atlas
+    w, h = image.size
+    padded = Image.new('RGBA', (w + 2, h + 2))
+    padded.paste(image, (1, 1))
+    padded.paste(image.crop((0, 0, w, 1)), (1, 0))
+    padded.paste(image.crop((0, h - 1, w, h)), (1, h + 1))
+    padded.paste(padded.crop((1, 0, 2, h + 2)), (0, 0))
+    padded.paste(padded.crop((w, 0, w + 1, h + 2)), (w + 1, 0))
+    return padded
 
 def get_asset_name(typ, name, index=None):
     name = get_method_name(name).upper()
@@ -56,7 +85,9 @@ class Assets(object):
         self.sounds = []
         self.fonts = []
         self.shaders = []
+        self.atlases = []
         self.shader_names = set()
+        self.use_atlas = converter.config.use_texture_atlas()
 
         self.sound_ids = {}
 
@@ -68,7 +99,8 @@ class Assets(object):
         header = ByteReader()
         data = ByteReader()
         header_size = (len(self.images) + len(self.sounds) + len(self.fonts) +
-                       len(self.shaders)) * 4 + len(self.images) * 2
+                       len(self.shaders) + len(self.atlases)) * 4
+        header_size += len(self.images) * 2
 
         # image preload
         self.use_count_offset = header.tell()
@@ -91,6 +123,10 @@ class Assets(object):
             header.writeInt(data.tell() + header_size, True)
             data.write(shader)
 
+        for atlas in self.atlases:
+            header.writeInt(data.tell() + header_size, True)
+            data.write(atlas)
+
         self.fp.write(str(header))
         self.fp.write(str(data))
 
@@ -98,14 +134,18 @@ class Assets(object):
         self.sound_count = len(self.sounds)
         self.font_count = len(self.fonts)
         self.shader_count = len(self.shaders)
+        self.atlas_count = len(self.atlases)
 
         self.sounds = self.images = self.fonts = self.shaders = None
+        self.atlases = None
 
     def write_cache(self, cache):
         cache['sound_ids'] = self.sound_ids
+        cache['atlas'] = self.use_atlas
 
     def load_cache(self, cache):
         self.sound_ids = cache['sound_ids']
+        self.use_atlas = cache.get('atlas', False)
 
     def write_preload(self, images):
         self.fp.seek(self.use_count_offset)
@@ -131,6 +171,7 @@ class Assets(object):
         self.header.putdefine('SOUND_COUNT', self.sound_count)
         self.header.putdefine('FONT_COUNT', self.font_count)
         self.header.putdefine('SHADER_COUNT', self.shader_count)
+        self.header.putdefine('ATLAS_COUNT', self.atlas_count)
         self.header.close_guard('CHOWDREN_ASSETS_H')
         self.header.close()
 
@@ -179,5 +220,70 @@ class Assets(object):
         writer.writeShort(hot_y)
         writer.writeShort(act_x)
         writer.writeShort(act_y)
+        if self.use_atlas:
+            writer.writeShort(-1)
         writer.writeIntString(data)
         self.images.append(str(writer))
+
+    def add_atlas_image(self, hot_x, hot_y, act_x, act_y, page, x, y, image):
+        writer = ByteReader()
+        writer.writeShort(hot_x)
+        writer.writeShort(hot_y)
+        writer.writeShort(act_x)
+        writer.writeShort(act_y)
+        writer.writeShort(page)
+        writer.writeShort(x)
+        writer.writeShort(y)
+        writer.writeShort(image.size[0])
+        writer.writeShort(image.size[1])
+        # collision masks come from the source pixels, not the page
+        writer.write(str(texpack.get_alpha_bits(image)))
+        self.images.append(str(writer))
+
+    def pack_atlas(self, images):
+        """
+        Packs the small images into atlas pages. Returns a dict of
+        image index -> (page, x, y).
+        """
+        if not self.use_atlas:
+            return {}
+        indexes = {}
+        padded = []
+        for index, image in enumerate(images):
+            w, h = image.size
+            if w <= 0 or h <= 0:
+                continue
+            if w > ATLAS_MAX_IMAGE or h > ATLAS_MAX_IMAGE:
+                continue
+            image = get_padded(image)
+            indexes[id(image)] = index
+            padded.append(image)
+
+        ret = {}
+        single_size = 0
+        atlas_size = 0
+        for rects in texpack.pack_images(padded, ATLAS_SIZE, ATLAS_SIZE):
+            page = len(self.atlases)
+            width = height = 0
+            for sprite in rects.results:
+                width = max(width, sprite.x + sprite.w)
+                height = max(height, sprite.y + sprite.h)
+            width = get_pow2(width)
+            height = get_pow2(height)
+            page_image = Image.new('RGBA', (width, height), (0, 0, 0, 0))
+            for sprite in rects.results:
+                page_image.paste(sprite.image, (sprite.x, sprite.y))
+                w, h = sprite.image.size
+                single_size += get_pow2(w - 2) * get_pow2(h - 2) * 4
+                ret[indexes[id(sprite.image)]] = (page, sprite.x + 1,
+                                                  sprite.y + 1)
+            atlas_size += width * height * 4
+            writer = ByteReader()
+            writer.writeIntString(self.converter.platform.get_image(
+                page_image))
+            self.atlases.append(str(writer))
+
+        print 'Packed %s images into %s atlas pages (%s KB, %s KB as POT '\
+              'textures)' % (len(ret), len(self.atlases), atlas_size / 1024,
+                             single_size / 1024)
+        return ret
@@ -51,10 +51,13 @@ import cPickle
 
 WRITE_SOUNDS = True
 PROFILE = False
-PROFILE_GROUPS = PROFILE and True
-PROFILE_DRAW = PROFILE and False
-PROFILE_EVENTS = PROFILE and False
-PROFILE_OBJECTS = PROFILE and False
+# timeline tracing (base/tracing.h), records the same zones as PROFILE
+TRACE = False
+PROFILE_ZONES = PROFILE or TRACE
+PROFILE_GROUPS = PROFILE_ZONES and True
+PROFILE_DRAW = PROFILE_ZONES and False
+PROFILE_EVENTS = PROFILE_ZONES and False
+PROFILE_OBJECTS = PROFILE_ZONES and False
 
 # enabled for porting
 NATIVE_EXTENSIONS = True
@@ -584,6 +587,7 @@ class Converter(object):
         self.iterated_index = self.iterated_object = self.iterated_name = None
         self.in_actions = False
         self.strings = {}
+        self.shader_parameters = {}
         self.event_functions = {}
         self.event_wrappers = {}
         self.objs_to_qualifier = {}
@@ -611,6 +615,16 @@ class Converter(object):
 
         self.game = self.games[0]
 
+        # every parameter of the game's effects gets a slot up front, so
+        # shaders can find all their uniforms, even the ones that are only
+        # ever set with a name built at runtime
+        for game in self.games:
+            if game.shaders is None:
+                continue
+            for shader_data in game.shaders.items:
+                for parameter in shader_data.parameters or ():
+                    self.get_shader_parameter(parameter.name)
+
         if args.ico is not None:
             shutil.copy(args.ico, self.get_filename('icon.ico'))
         if args.icns is not None:
@@ -701,6 +715,8 @@ class Converter(object):
             with open(self.get_filename('cache.dat'), 'wb') as fp:
                 cPickle.dump(cache, fp, protocol=2)
             del cache
+        if self.assets.use_atlas:
+            self.add_define('CHOWDREN_TEXTURE_ATLAS')
 
         objects_header = self.open_code('objects.h')
         objects_header.start_guard('CHOWDREN_OBJECTS_H')
@@ -869,12 +885,16 @@ class Converter(object):
                                          reverse=True):
                 handles.append(handle)
 
+            upload = not self.config.use_deferred_image_upload()
             for frame_index, images in enumerate(self.frame_images):
                 event_file.putmeth('void load_frame_%s_images'
                                    % (frame_index + 1))
-                for image in images:
-                    event_file.putlnc('get_internal_image(%s)->'
-                                      'upload_texture();', image)
+                if images:
+                    frame_handles = ', '.join(str(image) for image in images)
+                    event_file.putln('static const unsigned short '
+                                     'handles[] = {%s};' % frame_handles)
+                    event_file.putlnc('load_images(handles, %s, %s);',
+                                      len(images), upload)
                 event_file.end_brace()
 
             self.assets.write_preload(handles)
@@ -925,6 +945,37 @@ class Converter(object):
 
         frames_file.close()
 
+        layout_file = self.open_code('altlayout.cpp')
+        layout_header = self.open_code('altlayout.h')
+        layout_header.start_guard('CHOWDREN_ALTLAYOUT_H')
+        layout_writers = [writer for writer in self.object_cache.itervalues()
+                          if writer.use_alterables]
+        layout_writers.sort(key=lambda writer: writer.new_class_name)
+        for writer in layout_writers:
+            writer.write_alterable_layout(layout_file, layout_header)
+        layout_header.close_guard('CHOWDREN_ALTLAYOUT_H')
+        layout_file.close()
+        layout_header.close()
+
+        params_file = self.open_code('shaderparams.cpp')
+        params_header = self.open_code('shaderparams.h')
+        params_header.start_guard('CHOWDREN_SHADERPARAMS_H')
+        params_header.putdefine('SHADER_PARAMETER_COUNT',
+                                len(self.shader_parameters))
+        params_header.putln('extern const char * shader_parameter_names[];')
+        params_header.close_guard('CHOWDREN_SHADERPARAMS_H')
+        params_file.putln('const char * shader_parameter_names[] = {')
+        params_file.indent()
+        names = sorted(self.shader_parameters,
+                       key=self.shader_parameters.get)
+        for name in names:
+            params_file.putlnc('%r,', name, cpp=False)
+        params_file.putln('NULL')
+        params_file.dedent()
+        params_file.putln('};')
+        params_file.close()
+        params_header.close()
+
         strings_file = self.open_code('intern.cpp')
         strings_header = self.open_code('intern.h')
         strings_header.start_guard('CHOWDREN_STRINGS_H')
@@ -964,7 +1015,9 @@ class Converter(object):
             config_file.putln('#define CHOWDREN_SAMPLES_OVER_FRAMES')
         if header.newFlags['VSync']:
             config_file.putdefine('CHOWDREN_VSYNC')
-        if PROFILE:
+        if TRACE:
+            config_file.putdefine('CHOWDREN_USE_TRACING')
+        elif PROFILE:
             config_file.putdefine('CHOWDREN_USE_PROFILER')
 
         # write all options/extension defines
@@ -1073,16 +1126,20 @@ class Converter(object):
                 image_index += 1
 
         # use maxrects to create texture maps
-        # makedirs('./testmaxrects')
-        # maxrects = texpack.pack_images(maxrects_images, 1024, 1024)
-        # for file_index, rects in enumerate(maxrects):
-        #     rects.get().save('./testmaxrects/atlas%s.png' % file_index)
+        atlas = self.assets.pack_atlas(maxrects_images)
 
         for i, image in enumerate(new_entries):
-            temp = self.platform.get_image(maxrects_images[i])
+            pil_image = maxrects_images[i]
             arg = (image.xHotspot, image.yHotspot,
-                   image.actionX, image.actionY, temp)
-            self.assets.add_image(*arg)
+                   image.actionX, image.actionY)
+            try:
+                page, x, y = atlas[i]
+                self.assets.add_atlas_image(*(arg + (page, x, y, pil_image)))
+                continue
+            except KeyError:
+                pass
+            temp = self.platform.get_image(pil_image)
+            self.assets.add_image(*(arg + (temp,)))
 
         self.image_count = image_index
 
@@ -1906,8 +1963,8 @@ class Converter(object):
                         value = 0
                     parameters[parameter.name].value = value
             for name, value in parameters.iteritems():
-                objects_file.putln(to_c('set_shader_parameter(%r, %s);',
-                    name, value.value))
+                objects_file.putln(to_c('set_shader_parameter(%s, %s);',
+                    self.get_shader_parameter(name), value.value))
 
         if hasattr(common, 'movements') and common.movements:
             movements = common.movements.items
@@ -1942,7 +1999,7 @@ class Converter(object):
         depth = self.config.get_object_depth(object_writer)
         if depth is not None or PROFILE_DRAW:
             objects_file.putmeth('void draw')
-            if PROFILE:
+            if PROFILE_ZONES:
                 objects_file.putlnc('PROFILE_BLOCK(%s_draw);', class_name)
             if depth is not None:
                 objects_file.putlnc('glc_set_depth(%s);', depth)
@@ -2735,6 +2792,46 @@ class Converter(object):
 
         return out
 
+    def add_alterable_write(self, obj, kind, parameter):
+        # record the alterable slot an action writes to, so the object
+        # layouts only store what events can change
+        loader = parameter.loader
+        index = None
+        if not loader.isExpression:
+            index = getattr(loader, 'value', None)
+        else:
+            items = loader.items[:-1]
+            if len(items) == 1 and items[0].getName() == 'Long':
+                index = items[0].loader.value
+        for handle in self.resolve_qualifier(obj):
+            try:
+                writer = self.get_object_writer(handle)
+            except KeyError:
+                continue
+            writer.add_alterable_write(kind, index)
+
+    def get_shader_parameter(self, name):
+        # slot of a shader parameter in the instance parameter arrays. the
+        # names are written to shaderparams.cpp for lookups at runtime.
+        try:
+            return self.shader_parameters[name]
+        except KeyError:
+            pass
+        slot = len(self.shader_parameters)
+        self.shader_parameters[name] = slot
+        return slot
+
+    def get_shader_parameter_slot(self, parameter):
+        # returns None if the name is only known at runtime
+        loader = parameter.loader
+        if loader.isExpression:
+            name = self.convert_static_expression(loader.items)
+        else:
+            name = getattr(loader, 'value', None)
+        if name is None:
+            return None
+        return self.get_shader_parameter(name)
+
     def intern_string(self, value):
         if value == '':
             return 'empty_string'
@@ -1368,9 +1368,43 @@ class SetEffect(ActionWriter):
                 shader_name = shader.get_name(name)
             writer.putlnc('%s->set_shader(%s);', obj, shader_name)
 
+class SetEffectParameter(ActionMethodWriter):
+    method = 'set_shader_parameter'
+
+    def write(self, writer):
+        slot = self.converter.get_shader_parameter_slot(self.parameters[0])
+        if slot is None:
+            ActionMethodWriter.write(self, writer)
+            return
+        value = self.convert_index(1)
+        writer.put('%s(%s, %s);' % (self.method, slot, value))
+
+class AlterableWrite(ActionMethodWriter):
+    kind = 'values'
+
+    def write(self, writer):
+        self.converter.add_alterable_write(self.get_object(), self.kind,
+                                           self.parameters[0])
+        ActionMethodWriter.write(self, writer)
+
+class SetAlterableValue(AlterableWrite):
+    method = 'alterables->values.set'
+
+class AddToAlterable(AlterableWrite):
+    method = 'alterables->values.add'
+
+class SubtractFromAlterable(AlterableWrite):
+    method = 'alterables->values.sub'
+
+class SetAlterableString(AlterableWrite):
+    method = 'alterables->strings.set'
+    kind = 'strings'
+
 class SpreadValue(ActionWriter):
     custom = True
     def write(self, writer):
+        self.converter.add_alterable_write(self.get_object(), 'values',
+                                           self.parameters[0])
         alt = self.convert_index(0)
         start = self.convert_index(1)
         obj = self.get_object()
@@ -1547,11 +1581,11 @@ actions = make_table(ActionMethodWriter, {
     'SwapPosition' : SwapPosition,
     'SetX' : 'set_x',
     'SetY' : 'set_y',
-    'SetAlterableValue' : 'alterables->values.set',
-    'AddToAlterable' : 'alterables->values.add',
+    'SetAlterableValue' : SetAlterableValue,
+    'AddToAlterable' : AddToAlterable,
     'SpreadValue' : SpreadValue,
-    'SubtractFromAlterable' : 'alterables->values.sub',
-    'SetAlterableString' : 'alterables->strings.set',
+    'SubtractFromAlterable' : SubtractFromAlterable,
+    'SetAlterableString' : SetAlterableString,
     'AddCounterValue' : 'add',
     'SubtractCounterValue' : 'subtract',
     'SetCounterValue' : 'set',
@@ -1621,8 +1655,8 @@ actions = make_table(ActionMethodWriter, {
     'BringToFront' : 'move_front',
     'DeleteAllCreatedBackdrops' : 'layers[%s-1].destroy_backgrounds()',
     'DeleteCreatedBackdrops' : 'layers[%s-1].destroy_backgrounds(%s, %s, %s)',
-    'SetEffectParameter' : 'set_shader_parameter',
-    'SetEffectImage' : 'set_shader_parameter',
+    'SetEffectParameter' : SetEffectParameter,
+    'SetEffectImage' : SetEffectParameter,
     'SetFrameBackgroundColor' : 'set_background_color',
     'AddBackdrop' : 'paste',
     'PasteActive' : 'paste',
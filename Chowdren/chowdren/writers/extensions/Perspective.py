@@ -14,13 +14,23 @@ class Perspective(ObjectWriter):
         data.skipBytes(4) # sx, sy - unused
         writer.putlnc('width = %s;', data.readShort())
         writer.putlnc('height = %s;', data.readShort())
-        writer.putlnc('set_shader_parameter("effect", %s);', data.readByte())
-        writer.putlnc('set_shader_parameter("direction", %s);', data.readByte() != 0)
+        self.set_parameter(writer, 'effect', data.readByte())
+        self.set_parameter(writer, 'direction', data.readByte() != 0)
         data.skipBytes(2) # padding
-        writer.putlnc('set_shader_parameter("zoom", %s);', data.readInt())
-        writer.putlnc('set_shader_parameter("offset", %s);', data.readInt())
-        writer.putlnc('set_shader_parameter("sine_waves", %s);', data.readInt())
-        writer.putlnc('set_shader_parameter("perspective_dir", %s);', data.readByte() != 0)
+        self.set_parameter(writer, 'zoom', data.readInt())
+        self.set_parameter(writer, 'offset', data.readInt())
+        self.set_parameter(writer, 'sine_waves', data.readInt())
+        self.set_parameter(writer, 'perspective_dir', data.readByte() != 0)
+
+        # slots for the parameters the actions change at runtime
+        for name in ('zoom', 'offset', 'sine_waves'):
+            slot = self.converter.get_shader_parameter(name)
+            self.converter.add_define('CHOWDREN_PERSPECTIVE_%s' % name.upper(),
+                                      str(slot))
+
+    def set_parameter(self, writer, name, value):
+        slot = self.converter.get_shader_parameter(name)
+        writer.putlnc('set_shader_parameter(%s, %s);', slot, value)
 
 actions = make_table(ActionMethodWriter, {
     0 : 'set_zoom',
@@ -33,8 +43,8 @@ conditions = make_table(ConditionMethodWriter, {
 })
 
 expressions = make_table(ExpressionMethodWriter, {
-    0 : '.get_shader_parameter("zoom")',
-    1 : '.get_shader_parameter("offset")'
+    0 : '.get_shader_parameter(CHOWDREN_PERSPECTIVE_ZOOM)',
+    1 : '.get_shader_parameter(CHOWDREN_PERSPECTIVE_OFFSET)'
 })
 def get_object():
     return Perspective
@@ -3,6 +3,9 @@ from mmfparser.bytereader import ByteReader
 from chowdren.idpool import get_id
 from chowdren.common import get_method_name
 
+ALT_VALUES = 26
+ALT_STRINGS = 10
+
 class ObjectWriter(BaseWriter):
     common = None
     class_name = 'Undefined'
@@ -18,6 +21,7 @@ class ObjectWriter(BaseWriter):
 
     def __init__(self, *arg, **kw):
         self.event_callbacks = {}
+        self.alterable_writes = {'values': set(), 'strings': set()}
         BaseWriter.__init__(self, *arg, **kw)
         self.common = self.data.properties.loader
         self.initialize()
@@ -159,15 +163,15 @@ class ObjectWriter(BaseWriter):
     def write_internal_class(self, writer):
         if not self.is_global():
             return
-        writer.putln('static bool has_saved_alterables;')
-        writer.putln('static Alterables global_alterables;')
+        writer.putln('static Alterables * global_alterables;')
 
     def write_internal_post(self, writer):
+        if not self.use_alterables:
+            return
+        self.write_alterable_defaults(writer)
         if not self.is_global():
             return
-        writer.putlnc('bool %s::has_saved_alterables = false;',
-                      self.new_class_name)
-        writer.putlnc('Alterables %s::global_alterables;',
+        writer.putlnc('Alterables * %s::global_alterables = NULL;',
                       self.new_class_name)
 
     def has_dtor(self):
@@ -182,49 +186,124 @@ class ObjectWriter(BaseWriter):
             return
         if self.has_single_global():
             return
-        writer.putln('has_saved_alterables = true;')
-        writer.putln('global_alterables.set(*alterables);')
+        writer.putln('if (global_alterables == NULL)')
+        writer.indent()
+        writer.putlnc('global_alterables = Alterables::create(%s);',
+                      self.get_alterable_layout())
+        writer.dedent()
+        writer.putln('global_alterables->set(*alterables);')
 
     def load_alterables(self, writer):
         if not self.use_alterables:
             return
 
-        is_global = self.is_global()
-        single = self.has_single_global()
+        layout = self.get_alterable_layout()
 
-        if not single:
-            writer.putln('create_alterables();')
+        if self.has_single_global():
+            writer.putlnc('flags |= GLOBAL;')
+            writer.putln('if (global_alterables == NULL)')
+            writer.indent()
+            writer.putlnc('global_alterables = Alterables::create(%s);',
+                          layout)
+            writer.dedent()
+            writer.putln('alterables = global_alterables;')
+            return
 
-        if is_global:
-            if single:
-                writer.putlnc('flags |= GLOBAL;')
-                writer.putln('alterables = &global_alterables;')
-                writer.putln('has_saved_alterables = true;')
-                writer.putln('if (!has_saved_alterables) {')
-            else:
-                writer.putln('if (has_saved_alterables) {')
-                writer.indent()
-                writer.putln('alterables->set(global_alterables);')
-                writer.dedent()
-                writer.putln('} else {')
+        writer.putlnc('create_alterables(%s);', layout)
 
+        if self.is_global():
+            writer.putln('if (global_alterables != NULL)')
             writer.indent()
-
+            writer.putln('alterables->set(*global_alterables);')
+            writer.dedent()
+
+    # alterable layouts
+
+    def add_alterable_write(self, kind, index):
+        # index is None if the event picks the slot at runtime
+        if kind == 'values':
+            count = ALT_VALUES
+        else:
+            count = ALT_STRINGS
+        writes = self.alterable_writes[kind]
+        if index is None:
+            writes.update(xrange(count))
+        elif 0 <= index < count:
+            writes.add(index)
+
+    def get_alterable_layout(self):
+        return '%s_alterables' % self.new_class_name
+
+    def get_alterable_defaults(self):
         common = self.common
+        values = [0] * ALT_VALUES
         if common.values:
-            for index, value in enumerate(common.values.items):
-                if value == 0:
-                    continue
-                writer.putlnc('alterables->values.set(%s, %s);', index, value)
+            for index, value in enumerate(common.values.items[:ALT_VALUES]):
+                values[index] = value
+        strings = ['NULL'] * ALT_STRINGS
         if common.strings:
-            for index, value in enumerate(common.strings.items):
+            items = common.strings.items[:ALT_STRINGS]
+            for index, value in enumerate(items):
                 if value == '':
                     continue
-                value = self.converter.intern_string(value)
-                writer.putlnc('alterables->strings.set(%s, %s);', index, value)
-
-        if is_global:
-            writer.end_brace()
+                strings[index] = '&' + self.converter.intern_string(value)
+        if not any(values):
+            values = None
+        if strings.count('NULL') == ALT_STRINGS:
+            strings = None
+        return values, strings
+
+    def write_alterable_defaults(self, writer):
+        # the initial values go with the object code, so objects that only
+        # differ in them do not share a class
+        values, strings = self.get_alterable_defaults()
+        name = self.get_alterable_layout()
+        if values is not None:
+            writer.putlnc('extern const int %s_values[] = {%s};', name,
+                          ', '.join([str(value) for value in values]))
+        if strings is not None:
+            writer.putlnc('extern const std::string * const %s_strings[] = '
+                          '{%s};', name, ', '.join(strings))
+
+    def get_alterable_slots(self, kind, count):
+        if not self.converter.config.use_compact_alterables(self):
+            return range(count)
+        return sorted(self.alterable_writes[kind])
+
+    def write_alterable_layout(self, writer, header):
+        name = self.get_alterable_layout()
+        header.putlnc('extern AlterableLayout %s;', name)
+
+        values, strings = self.get_alterable_defaults()
+        if values is None:
+            values = 'NULL'
+        else:
+            values = '%s_values' % name
+            writer.putlnc('extern const int %s[];', values)
+        if strings is None:
+            strings = 'NULL'
+        else:
+            strings = '%s_strings' % name
+            writer.putlnc('extern const std::string * const %s[];',
+                          strings)
+
+        value_slots = self.get_alterable_slots('values', ALT_VALUES)
+        string_slots = self.get_alterable_slots('strings', ALT_STRINGS)
+        value_map = [-1] * ALT_VALUES
+        for slot, index in enumerate(value_slots):
+            value_map[index] = slot
+        string_map = [-1] * ALT_STRINGS
+        for slot, index in enumerate(string_slots):
+            string_map[index] = slot
+
+        writer.putlnc('AlterableLayout %s = {', name)
+        writer.indent()
+        writer.putlnc('%s, %s,', len(value_slots), len(string_slots))
+        writer.putlnc('{%s},', ', '.join([str(v) for v in value_map]))
+        writer.putlnc('{%s},', ', '.join([str(v) for v in string_map]))
+        writer.putlnc('%s, %s', values, strings)
+        writer.dedent()
+        writer.putln('};')
 
     def get_base_filename(self):
         if '/' in self.filename:
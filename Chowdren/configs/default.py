@@ -22,6 +22,9 @@ def use_global_alterables(converter, obj):
 def use_single_global_alterables(converter, obj):
     return True
 
+def use_compact_alterables(converter, obj):
+    return True
+
 def use_global_int(converter, expression):
     return False
 
@@ -49,6 +52,12 @@ def use_image_flush(converter, frame):
 def use_image_preload(converter):
     return False
 
+def use_deferred_image_upload(converter):
+    return False
+
+def use_texture_atlas(converter):
+    return converter.platform_name == 'generic'
+
 def add_defines(converter):
     pass
 